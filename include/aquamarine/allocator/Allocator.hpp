@@ -3,6 +3,7 @@
 #include <hyprutils/memory/SharedPtr.hpp>
 #include "../buffer/Buffer.hpp"
 #include <drm_fourcc.h>
+#include <vector>
 
 namespace Aquamarine {
     class CBackend;
@@ -17,15 +18,75 @@ namespace Aquamarine {
     enum eAllocatorType {
         AQ_ALLOCATOR_TYPE_GBM = 0,
         AQ_ALLOCATOR_TYPE_DRM_DUMB,
+        AQ_ALLOCATOR_TYPE_SHM,
+        AQ_ALLOCATOR_TYPE_UDMABUF,
+    };
+
+    // what an allocator, or a swapchain, holds on to. Bytes are what's allocated, see IBuffer::allocatedBytes
+    struct SAllocatorStats {
+        struct SFormatStats {
+            uint32_t format   = DRM_FORMAT_INVALID;
+            uint64_t modifier = DRM_FORMAT_MOD_INVALID; // linear for shm
+            size_t   buffers  = 0, bytes = 0;
+        };
+
+        size_t                    buffers       = 0, bytes = 0;
+        size_t                    pooledBuffers = 0, pooledBytes = 0; // out of the above, kept around for reuse and not in any swapchain
+        size_t                    readbackBytes = 0;                  // on top, cpu copies of buffers another gpu couldn't import. Counts against the budget.
+        std::vector<SFormatStats> formats;
+
+        void                      add(Hyprutils::Memory::CSharedPointer<IBuffer> buffer);
+    };
+
+    /*
+        One buffer allocation split up for CSwapchain::reconfigureAsync. The allocator prepares it on the main thread,
+        run() does the expensive part on the allocation thread, and finish() hands out the buffer back on the main one.
+    */
+    class IAllocationJob {
+      public:
+        virtual ~IAllocationJob() = default;
+        // may run on any thread, and must not touch anything besides the job itself
+        virtual void                                       run()    = 0;
+        // on the main thread after run(), nullptr if the allocation failed
+        virtual Hyprutils::Memory::CSharedPointer<IBuffer> finish() = 0;
     };
 
     class IAllocator {
       public:
-        virtual ~IAllocator()                                                                                                                                      = default;
-        virtual Hyprutils::Memory::CSharedPointer<IBuffer>  acquire(const SAllocatorBufferParams& params, Hyprutils::Memory::CSharedPointer<CSwapchain> swapchain) = 0;
-        virtual Hyprutils::Memory::CSharedPointer<CBackend> getBackend()                                                                                           = 0;
-        virtual int                                         drmFD()                                                                                                = 0;
-        virtual eAllocatorType                              type()                                                                                                 = 0;
-        virtual void                                        destroyBuffers();
+        virtual ~IAllocator()                                                                                                                                            = default;
+        virtual Hyprutils::Memory::CSharedPointer<IBuffer>        acquire(const SAllocatorBufferParams& params, Hyprutils::Memory::CSharedPointer<CSwapchain> swapchain) = 0;
+        virtual Hyprutils::Memory::CSharedPointer<CBackend>       getBackend()                                                                                           = 0;
+        virtual int                                               drmFD()                                                                                                = 0;
+        virtual eAllocatorType                                    type()                                                                                                 = 0;
+        virtual void                                              destroyBuffers();
+        // a swapchain is done with buffer. Allocators may keep it for a later acquire, by default it's just dropped.
+        virtual void                                              recycle(Hyprutils::Memory::CSharedPointer<IBuffer> buffer);
+
+        // an acquire that can run off the main thread, see IAllocationJob. nullptr if this allocator can't, which is the default.
+        virtual Hyprutils::Memory::CSharedPointer<IAllocationJob> prepareAcquire(const SAllocatorBufferParams& params, Hyprutils::Memory::CSharedPointer<CSwapchain> swapchain);
+
+        // what the allocator's buffers add up to right now. Empty for allocators that don't keep track, which is the default.
+        virtual SAllocatorStats                                   stats();
+        // whether bytes more, with freed going away in exchange, stay within the budget. Only checks, see makeRoom.
+        virtual bool                                              fitsBudget(size_t bytes, size_t freed = 0);
+
+        // drops whatever the allocator keeps around for reuse and nobody asked for in a while. The backend calls this
+        // from its idle timer, which wakes up often enough for it while hasPooled().
+        virtual void                                              trim();
+
+        // about to allocate bytes more that fitsBudget said fit: drops what's kept around for reuse until they do, pooled
+        // buffers don't count against the budget for the check. Nothing to drop by default.
+        virtual void                                              makeRoom(size_t bytes, size_t freed = 0);
+
+        // whether anything is kept around for reuse, without adding up all of stats(). False by default.
+        virtual bool                                              hasPooled();
+
+        // caps what stats() adds up to, 0 for no cap. Swapchains refuse to grow or reconfigure past it, and give back
+        // the buffers they grew into past their length while it's exceeded. Without one of its own, the backend's applies.
+        void                                                      setBudget(size_t bytes);
+        size_t                                                    getBudget();
+
+      protected:
+        size_t budget = 0;
     };
 };
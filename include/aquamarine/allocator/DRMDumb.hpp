@@ -19,6 +19,8 @@ namespace Aquamarine {
         virtual SDMABUFAttrs                           dmabuf();
         virtual std::tuple<uint8_t*, uint32_t, size_t> beginDataPtr(uint32_t flags);
         virtual void                                   endDataPtr();
+        virtual SBufferDataRange                       beginDataRange(const Hyprutils::Math::CRegion& region, uint32_t access);
+        virtual size_t                                 allocatedBytes();
 
       private:
         CDRMDumbBuffer(const SAllocatorBufferParams& params, Hyprutils::Memory::CWeakPointer<CDRMDumbAllocator> allocator_,
@@ -48,6 +50,7 @@ namespace Aquamarine {
         virtual Hyprutils::Memory::CSharedPointer<CBackend>         getBackend();
         virtual int                                                 drmFD();
         virtual eAllocatorType                                      type();
+        virtual SAllocatorStats                                     stats();
 
         //
         Hyprutils::Memory::CWeakPointer<CDRMDumbAllocator> self;
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "Allocator.hpp"
+#include <chrono>
+#include <optional>
+#include <vector>
 
 struct gbm_device;
 struct gbm_bo;
@@ -9,6 +12,22 @@ namespace Aquamarine {
     class CGBMAllocator;
     class CBackend;
     class CSwapchain;
+    class CDRMBackend;
+    class CGBMAllocationJob;
+    struct SGBMAllocation;
+
+    // what a gbm buffer gets allocated with, worked out from the params and the swapchain it's for.
+    // Buffers with equal plans are interchangeable, which is what the allocator's pool goes by.
+    struct SGBMBufferPlan {
+        Hyprutils::Math::Vector2D size;
+        uint32_t                  format = DRM_FORMAT_INVALID;
+        std::vector<uint64_t>     modifiers;         // empty for a modifier-less allocation
+        std::vector<uint64_t>     fallbackModifiers; // everything possible before multigpu narrowed it down
+        uint32_t                  flags   = 0;       // GBM_BO_USE_*
+        bool                      scanout = false, cursor = false, multigpu = false, multigpuFallback = false;
+
+        bool                      operator==(const SGBMBufferPlan& other) const = default;
+    };
 
     class CGBMBuffer : public IBuffer {
       public:
@@ -22,31 +41,56 @@ namespace Aquamarine {
         virtual SDMABUFAttrs                           dmabuf();
         virtual std::tuple<uint8_t*, uint32_t, size_t> beginDataPtr(uint32_t flags);
         virtual void                                   endDataPtr();
+        virtual SBufferDataRange                       beginDataRange(const Hyprutils::Math::CRegion& region, uint32_t access);
+        virtual void                                   endDataRange();
+        virtual size_t                                 allocatedBytes();
 
       private:
-        CGBMBuffer(const SAllocatorBufferParams& params, Hyprutils::Memory::CWeakPointer<CGBMAllocator> allocator_, Hyprutils::Memory::CSharedPointer<CSwapchain> swapchain);
+        // takes the bo and fds out of allocation
+        CGBMBuffer(const SGBMBufferPlan& plan_, SGBMAllocation& allocation, Hyprutils::Memory::CWeakPointer<CGBMAllocator> allocator_,
+                   Hyprutils::Memory::CSharedPointer<CSwapchain> swapchain);
 
         Hyprutils::Memory::CWeakPointer<CGBMAllocator> allocator;
+        SGBMBufferPlan                                 plan;
 
         // gbm stuff
         gbm_bo*      bo         = nullptr;
         void*        boBuffer   = nullptr;
         void*        gboMapping = nullptr;
         SDMABUFAttrs attrs{.success = false};
+        size_t       bytes = 0; // allocatedBytes(), the exporter won't resize it
+
+        // beginDataRange. Linear buffers get the dmabuf mapped once and kept, synced with DMA_BUF_IOCTL_SYNC.
+        // Anything else goes through gbm_bo_map for just the box, so the driver only detiles that.
+        struct {
+            uint8_t* dmabufData   = nullptr;
+            size_t   dmabufLen    = 0;
+            bool     dmabufFailed = false; // the exporter can't mmap, don't try again
+            void*    boMapping    = nullptr;
+            uint32_t access       = 0;
+        } range;
 
         friend class CGBMAllocator;
+        friend class CGBMAllocationJob;
     };
 
     class CGBMAllocator : public IAllocator {
       public:
         ~CGBMAllocator();
-        static Hyprutils::Memory::CSharedPointer<CGBMAllocator> create(int drmfd_, Hyprutils::Memory::CWeakPointer<CBackend> backend_);
-
-        virtual Hyprutils::Memory::CSharedPointer<IBuffer>      acquire(const SAllocatorBufferParams& params, Hyprutils::Memory::CSharedPointer<CSwapchain> swapchain_);
-        virtual Hyprutils::Memory::CSharedPointer<CBackend>     getBackend();
-        virtual int                                             drmFD();
-        virtual eAllocatorType                                  type();
-        virtual void                                            destroyBuffers();
+        static Hyprutils::Memory::CSharedPointer<CGBMAllocator>   create(int drmfd_, Hyprutils::Memory::CWeakPointer<CBackend> backend_);
+
+        virtual Hyprutils::Memory::CSharedPointer<IBuffer>        acquire(const SAllocatorBufferParams& params, Hyprutils::Memory::CSharedPointer<CSwapchain> swapchain_);
+        virtual Hyprutils::Memory::CSharedPointer<CBackend>       getBackend();
+        virtual int                                               drmFD();
+        virtual eAllocatorType                                    type();
+        virtual void                                              destroyBuffers();
+        virtual void                                              recycle(Hyprutils::Memory::CSharedPointer<IBuffer> buffer);
+        virtual Hyprutils::Memory::CSharedPointer<IAllocationJob> prepareAcquire(const SAllocatorBufferParams& params, Hyprutils::Memory::CSharedPointer<CSwapchain> swapchain_);
+        virtual SAllocatorStats                                   stats();
+        virtual bool                                              fitsBudget(size_t bytes, size_t freed = 0);
+        virtual void                                              trim();
+        virtual void                                              makeRoom(size_t bytes, size_t freed = 0);
+        virtual bool                                              hasPooled();
 
         //
         Hyprutils::Memory::CWeakPointer<CGBMAllocator> self;
@@ -54,7 +98,30 @@ namespace Aquamarine {
       private:
         CGBMAllocator(int fd_, Hyprutils::Memory::CWeakPointer<CBackend> backend_);
 
-        // a vector purely for tracking (debugging) the buffers and nothing more
+        // finds a modifier out of candidates we can render to and secondary can sample from, trying an actual import.
+        // Once per format for every secondary, nullopt if there's nothing better than linear.
+        std::optional<uint64_t> negotiateMgpuModifier(CDRMBackend* secondary, uint32_t format, const std::vector<uint64_t>& candidates);
+
+        // works out format, modifiers and flags for params, false if there's nothing to allocate with
+        bool planBuffer(const SAllocatorBufferParams& params, Hyprutils::Memory::CSharedPointer<CSwapchain> swapchain, SGBMBufferPlan& plan);
+
+        Hyprutils::Memory::CSharedPointer<CGBMBuffer> takeFromPool(const SGBMBufferPlan& plan);
+        void                                          trimPool(size_t limit);
+        // what the pool may hold, less when the allocator's budget is nearly used up
+        size_t                                        poolLimit();
+
+        // buffers swapchains let go of, oldest first. Handed out again to an acquire with the same plan, so
+        // swapchain churn (resizes, modes back and forth) doesn't go through the kernel allocator and renderer clears.
+        // Ones that sat there for too long go on the next recycle, acquire or trim(), whichever comes first.
+        struct SPooledBuffer {
+            Hyprutils::Memory::CSharedPointer<CGBMBuffer> buffer;
+            size_t                                        bytes = 0;
+            std::chrono::steady_clock::time_point         since;
+        };
+        std::vector<SPooledBuffer> pool;
+        size_t                     poolBytes = 0;
+
+        // a vector for tracking (debugging) the buffers, and telling ours apart in recycle()
         std::vector<Hyprutils::Memory::CWeakPointer<CGBMBuffer>> buffers;
 
         int                                                      fd = -1;
@@ -66,6 +133,7 @@ namespace Aquamarine {
         std::string drmName              = "";
 
         friend class CGBMBuffer;
+        friend class CGBMAllocationJob;
         friend class CDRMRenderer;
     };
 };
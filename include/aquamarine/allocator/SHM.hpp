@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Allocator.hpp"
+
+namespace Aquamarine {
+    class CSHMAllocator;
+    class CBackend;
+    class CSwapchain;
+
+    class CSHMBuffer : public IBuffer {
+      public:
+        virtual ~CSHMBuffer();
+
+        virtual eBufferCapability                      caps();
+        virtual eBufferType                            type();
+        virtual void                                   update(const Hyprutils::Math::CRegion& damage);
+        virtual bool                                   isSynchronous();
+        virtual bool                                   good();
+        virtual SSHMAttrs                              shm();
+        virtual std::tuple<uint8_t*, uint32_t, size_t> beginDataPtr(uint32_t flags);
+        virtual void                                   endDataPtr();
+        virtual size_t                                 allocatedBytes();
+
+      private:
+        CSHMBuffer(const SAllocatorBufferParams& params, Hyprutils::Memory::CWeakPointer<CSHMAllocator> allocator_, Hyprutils::Memory::CSharedPointer<CSwapchain> swapchain);
+
+        Hyprutils::Memory::CWeakPointer<CSHMAllocator> allocator;
+
+        //
+        size_t   bufferLen = 0; // the whole mapping, can be rounded up past stride * height for huge pages
+        uint8_t* data      = nullptr;
+        bool     hugetlb   = false;
+
+        //
+        SSHMAttrs attrs{.success = false, .fd = -1};
+
+        friend class CSHMAllocator;
+    };
+
+    /*
+        Plain memory buffers out of sealed memfds, for when there's no gpu to allocate from: headless on machines
+        without one, or software rendering. Big buffers get huge pages (THP, or hugetlb with AQ_SHM_HUGETLB) to
+        cut down on TLB misses when a cpu walks over a whole 4K frame.
+    */
+    class CSHMAllocator : public IAllocator {
+      public:
+        ~CSHMAllocator();
+        static Hyprutils::Memory::CSharedPointer<CSHMAllocator> create(Hyprutils::Memory::CWeakPointer<CBackend> backend_);
+
+        virtual Hyprutils::Memory::CSharedPointer<IBuffer>      acquire(const SAllocatorBufferParams& params, Hyprutils::Memory::CSharedPointer<CSwapchain> swapchain_);
+        virtual Hyprutils::Memory::CSharedPointer<CBackend>     getBackend();
+        virtual int                                             drmFD();
+        virtual eAllocatorType                                  type();
+        virtual SAllocatorStats                                 stats();
+
+        // the formats buffers can be allocated in, all of them 32bpp
+        static bool supportsFormat(uint32_t format);
+
+        //
+        Hyprutils::Memory::CWeakPointer<CSHMAllocator> self;
+
+      private:
+        CSHMAllocator(Hyprutils::Memory::CWeakPointer<CBackend> backend_);
+
+        // a vector purely for tracking (debugging) the buffers and nothing more
+        std::vector<Hyprutils::Memory::CWeakPointer<CSHMBuffer>> buffers;
+
+        Hyprutils::Memory::CWeakPointer<CBackend>                backend;
+
+        friend class CSHMBuffer;
+    };
+};
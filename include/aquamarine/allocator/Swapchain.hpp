@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Allocator.hpp"
+#include <functional>
 
 namespace Aquamarine {
 
@@ -19,24 +20,49 @@ namespace Aquamarine {
       public:
         static Hyprutils::Memory::CSharedPointer<CSwapchain> create(Hyprutils::Memory::CSharedPointer<IAllocator>             allocator_,
                                                                     Hyprutils::Memory::CSharedPointer<IBackendImplementation> backendImpl_);
+        ~CSwapchain();
 
         bool                                                 reconfigure(const SSwapchainOptions& options_);
+        // like reconfigure, but a new generation of buffers is allocated off the main thread while next() keeps handing
+        // out the current one. The swapchain switches over from the backend's poll fds, and done gets whether it did.
+        // Changes that need no new generation, or allocators that can't allocate off the main thread, are done before this
+        // returns. Another reconfigure wins, the pending one's done gets false then, unless it asks for the same generation
+        // again, which keeps the pending one going. If the swapchain goes away first, done isn't called at all.
+        void                                                 reconfigureAsync(const SSwapchainOptions& options_, std::function<void(bool)> done = nullptr);
+        bool                                                 reconfigurePending();
 
         bool                                                 contains(Hyprutils::Memory::CSharedPointer<IBuffer> buffer);
+        // age is how many frames ago the buffer was last presented, 1 being the previous one. 0 means its contents
+        // are unknown (never presented, or written and rolled back), and it has to be redrawn fully.
+        // Buffers still locked by the consumer or held by the backend are skipped. If all of them are, the swapchain
+        // grows by one, up to a couple past options.length and within the allocator's budget, and shrinks back once that
+        // has calmed down, or right away when the allocator is over its budget.
         Hyprutils::Memory::CSharedPointer<IBuffer>           next(int* age);
         const SSwapchainOptions&                             currentOptions();
         Hyprutils::Memory::CSharedPointer<IAllocator>        getAllocator();
+        // what this swapchain's buffers hold, a part of what getAllocator()->stats() counts
+        SAllocatorStats                                      stats();
 
         // rolls the buffers back, marking the last consumed as the next valid.
         // useful if e.g. a commit fails and we don't wanna write to the previous buffer that is
         // in use.
         void rollback();
 
+        // marks buffer as presented, which is what buffer ages count. Called by the backends when a buffer
+        // actually hits the screen, buffers not from this swapchain are ignored.
+        void presented(Hyprutils::Memory::CSharedPointer<IBuffer> buffer);
+
       private:
         CSwapchain(Hyprutils::Memory::CSharedPointer<IAllocator> allocator_, Hyprutils::Memory::CSharedPointer<IBackendImplementation> backendImpl_);
 
         bool fullReconfigure(const SSwapchainOptions& options_);
+        void replaceBuffers(std::vector<Hyprutils::Memory::CSharedPointer<IBuffer>>&& bfs);
+        void finishReconfigure(const std::vector<Hyprutils::Memory::CSharedPointer<IAllocationJob>>& jobs, const SSwapchainOptions& options_, uint64_t generation);
+        // a pending reconfigureAsync won't finish anymore
+        void cancelPendingReconfigure();
         bool resize(size_t newSize);
+        // drops one of the buffers next() added on top of options.length
+        void shrink();
 
         //
         Hyprutils::Memory::CWeakPointer<CSwapchain>             self;
@@ -44,8 +70,21 @@ namespace Aquamarine {
         Hyprutils::Memory::CSharedPointer<IAllocator>           allocator;
         Hyprutils::Memory::CWeakPointer<IBackendImplementation> backendImpl;
         std::vector<Hyprutils::Memory::CSharedPointer<IBuffer>> buffers;
-        int                                                     lastAcquired = 0;
+        int                                                     lastAcquired = 0, previousAcquired = 0;
+        size_t                                                  quietAcquisitions = 0;
+
+        // for each of buffers, the presentation it was last shown on, 0 if never
+        std::vector<uint64_t> presentedOn;
+        uint64_t              presentations = 0;
+
+        struct {
+            uint64_t                  generation = 0; // of the pending reconfigureAsync, its result is dropped if this moved on
+            std::function<void(bool)> done;
+            SSwapchainOptions         options; // what's being allocated
+            bool                      pending = false;
+        } async;
 
         friend class CGBMBuffer;
+        friend class CGBMAllocator;
     };
 };
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Allocator.hpp"
+
+namespace Aquamarine {
+    class CUdmabufAllocator;
+    class CBackend;
+    class CSwapchain;
+
+    class CUdmabufBuffer : public IBuffer {
+      public:
+        virtual ~CUdmabufBuffer();
+
+        virtual eBufferCapability                      caps();
+        virtual eBufferType                            type();
+        virtual void                                   update(const Hyprutils::Math::CRegion& damage);
+        virtual bool                                   isSynchronous();
+        virtual bool                                   good();
+        virtual SDMABUFAttrs                           dmabuf();
+        virtual std::tuple<uint8_t*, uint32_t, size_t> beginDataPtr(uint32_t flags);
+        virtual void                                   endDataPtr();
+        virtual size_t                                 allocatedBytes();
+
+      private:
+        CUdmabufBuffer(const SAllocatorBufferParams& params, Hyprutils::Memory::CWeakPointer<CUdmabufAllocator> allocator_,
+                       Hyprutils::Memory::CSharedPointer<CSwapchain> swapchain);
+
+        Hyprutils::Memory::CWeakPointer<CUdmabufAllocator> allocator;
+
+        //
+        size_t   bufferLen = 0; // the memfd, rounded up to whole pages
+        uint8_t* data      = nullptr;
+        int      memfd     = -1;
+
+        //
+        SDMABUFAttrs attrs{.success = false};
+
+        friend class CUdmabufAllocator;
+    };
+
+    /*
+        Linear dmabufs out of memfd pages through /dev/udmabuf, for machines without a gpu that still have to hand
+        out dmabufs: a wayland host's linux-dmabuf, or vkms. The cpu writes straight into what gets imported.
+    */
+    class CUdmabufAllocator : public IAllocator {
+      public:
+        ~CUdmabufAllocator();
+        // nullptr if /dev/udmabuf can't be opened
+        static Hyprutils::Memory::CSharedPointer<CUdmabufAllocator> create(Hyprutils::Memory::CWeakPointer<CBackend> backend_);
+
+        virtual Hyprutils::Memory::CSharedPointer<IBuffer>          acquire(const SAllocatorBufferParams& params, Hyprutils::Memory::CSharedPointer<CSwapchain> swapchain_);
+        virtual Hyprutils::Memory::CSharedPointer<CBackend>         getBackend();
+        virtual int                                                 drmFD();
+        virtual eAllocatorType                                      type();
+        virtual SAllocatorStats                                     stats();
+
+        //
+        Hyprutils::Memory::CWeakPointer<CUdmabufAllocator> self;
+
+      private:
+        CUdmabufAllocator(int fd_, Hyprutils::Memory::CWeakPointer<CBackend> backend_);
+
+        // a vector purely for tracking (debugging) the buffers and nothing more
+        std::vector<Hyprutils::Memory::CWeakPointer<CUdmabufBuffer>> buffers;
+
+        Hyprutils::Memory::CWeakPointer<CBackend>                    backend;
+
+        int                                                          udmabufFD = -1;
+
+        friend class CUdmabufBuffer;
+    };
+};
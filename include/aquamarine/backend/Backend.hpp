@@ -14,6 +14,7 @@
 
 namespace Aquamarine {
     class CLogger;
+    class CAllocationThread;
     class IOutput;
     class IPointer;
     class IKeyboard;
@@ -140,6 +141,17 @@ namespace Aquamarine {
         /* remove an idle event from the queue */
         void removeIdleEvent(Hyprutils::Memory::CSharedPointer<std::function<void(void)>> pfn);
 
+        /* commit the pending states of several outputs at once. Where the backend supports it (atomic DRM),
+           the page-flips of outputs on the same GPU go out in a single request and land on the same vblank.
+           Returns true if every output committed successfully. */
+        bool commitOutputs(const std::vector<Hyprutils::Memory::CSharedPointer<IOutput>>& outputs);
+
+        /* caps the memory each allocator of this backend holds, for those without a budget of their own (see IAllocator::setBudget).
+           0 for no cap, the default. The allocators, secondary GPUs' included, are in each implementation's getAllocators().
+           It's a cap per allocator, not one for all of them together: with several, they can hold up to that many times this. */
+        void   setAllocatorBudget(size_t bytes);
+        size_t getAllocatorBudget();
+
         // utils
         int reopenDRMNode(int drmFD, bool allowRenderNode = true);
 
@@ -186,6 +198,13 @@ namespace Aquamarine {
         void dispatchIdle();
         void updateIdleTimer();
 
+        // see setAllocatorBudget
+        size_t allocatorBudget = 0;
+
+        // for CSwapchain::reconfigureAsync, started the first time it's needed
+        Hyprutils::Memory::CSharedPointer<CAllocationThread> allocationThread;
+        Hyprutils::Memory::CSharedPointer<CAllocationThread> getAllocationThread();
+
         //
         struct {
             std::condition_variable loopSignal;
@@ -196,5 +215,6 @@ namespace Aquamarine {
         } m_sEventLoopInternals;
 
         friend class CDRMBackend;
+        friend class CSwapchain;
     };
 };
@@ -6,9 +6,11 @@
 #include "../input/Input.hpp"
 #include "FrameScheduler.hpp"
 #include <hyprutils/memory/WeakPtr.hpp>
+#include <hyprutils/os/FileDescriptor.hpp>
 #include <wayland-client.h>
 #include <xf86drmMode.h>
 #include <optional>
+#include <unordered_map>
 
 namespace Aquamarine {
     class CDRMBackend;
@@ -16,6 +18,9 @@ namespace Aquamarine {
     class CDRMOutput;
     struct SDRMConnector;
     class CDRMRenderer;
+    class CDRMBlobCache;
+    class CDRMCommitThread;
+    class CCPUBlitter;
     class CDRMDumbAllocator;
 
     typedef std::function<void(void)> FIdleCallback;
@@ -141,11 +146,21 @@ namespace Aquamarine {
                 uint32_t hotspot_y;
                 uint32_t in_fence_fd;
                 uint32_t color_range;
+                uint32_t zpos; // Not guaranteed to exist
             } values;
-            uint32_t props[18] = {0};
+            uint32_t props[19] = {0};
         };
         UDRMPlaneProps props;
 
+        // stacking position as reported by the kernel, only meaningful between planes of the same crtc.
+        uint64_t zpos = 0;
+
+        // overlays are listed on every crtc they can go on. This is the id of the crtc scanning out of it
+        // (or about to), 0 when it's free. Other crtcs must leave the plane alone until it's released.
+        uint32_t owner = 0;
+
+        bool     usableBy(uint32_t crtcID);
+
         // only valid when color_range != 0
         union UDRMPlaneColorRange {
             struct {
@@ -168,7 +183,10 @@ namespace Aquamarine {
             bool                                           async = false; // PAGE_FLIP_ASYNC
         } pendingFlip;
 
-        uintptr_t armPageFlip(Hyprutils::Memory::CWeakPointer<SDRMConnector> connector, bool async);
+        // connector waiting on a DRM_EVENT_CRTC_SEQUENCE to emit its idle frame, see CDRMOutput::queueSequenceFrame
+        Hyprutils::Memory::CWeakPointer<SDRMConnector> pendingSequence;
+
+        uintptr_t armPageFlip(Hyprutils::Memory::CWeakPointer<SDRMConnector> connector, bool async, uintptr_t id_ = 0 /* 0 picks a new one */);
         void      disarmPageFlip();
 
         struct {
@@ -176,19 +194,21 @@ namespace Aquamarine {
         } legacy;
 
         struct {
-            bool     ownModeID = false;
-            uint32_t modeID    = 0;
-            uint32_t gammaLut  = 0;
-            uint32_t ctm       = 0;
-            uint32_t hdr       = 0;
+            bool     ownModeID  = false;
+            uint32_t modeID     = 0;
+            uint32_t gammaLut   = 0;
+            uint32_t degammaLut = 0;
+            uint32_t ctm        = 0;
+            uint32_t hdr        = 0;
             // true once a real commit has made the kernel CTM match our state.
             bool ctmStateKnown = false;
         } atomic;
 
-        Hyprutils::Memory::CSharedPointer<SDRMPlane> primary;
-        Hyprutils::Memory::CSharedPointer<SDRMPlane> cursor;
-        Hyprutils::Memory::CWeakPointer<CDRMBackend> backend;
-        Hyprutils::Memory::CSharedPointer<CDRMFB>    pendingCursor;
+        Hyprutils::Memory::CSharedPointer<SDRMPlane>              primary;
+        Hyprutils::Memory::CSharedPointer<SDRMPlane>              cursor;
+        std::vector<Hyprutils::Memory::CSharedPointer<SDRMPlane>> overlays; // sorted by zpos, bottom first
+        Hyprutils::Memory::CWeakPointer<CDRMBackend>              backend;
+        Hyprutils::Memory::CSharedPointer<CDRMFB>                 pendingCursor;
 
         union UDRMCRTCProps {
             struct {
@@ -227,6 +247,9 @@ namespace Aquamarine {
         virtual std::vector<SDRMFormat>                                   getRenderFormats();
         virtual bool                                                      pendingPageFlip();
         virtual bool                                                      pendingIdleFrame();
+        virtual size_t                                                    maxLayers();
+        virtual void                                                      setRenderDeadline(std::chrono::nanoseconds deadline);
+        virtual std::optional<std::chrono::steady_clock::time_point>      predictedVblank();
         void                                                              releaseMgpuResources();
 
         int                                                               getConnectorID();
@@ -239,11 +262,25 @@ namespace Aquamarine {
 
         bool enabledState = true; // actual enabled state. Should be synced with state->state().enabled after a new frame
 
+        // holds the frame event back for the render deadline, if there's one. Returns false if it should go out now.
+        bool                                                 deferFrame();
+        // holds an idle frame event back until the next vblank, with AQ_DRM_VBLANK_IDLE_FRAMES. Returns false if it can't.
+        bool                                                 queueSequenceFrame();
+        // emits a frame event that was held back by either of the above
+        void                                                 emitHeldFrame();
+        std::optional<std::chrono::steady_clock::time_point> frameDeadline; // see CFrameScheduler::frameEventTime
+
       private:
         CDRMOutput(const std::string& name_, Hyprutils::Memory::CWeakPointer<CDRMBackend> backend_, Hyprutils::Memory::CSharedPointer<SDRMConnector> connector_);
 
         bool                                                         commitState(bool onlyTest = false);
 
+        // the steps of commitState, split so that CDRMBackend::commitOutputs can put several heads into one request
+        bool                                                         checkState(bool onlyTest, uint32_t& flags);
+        bool                                                         prepareCommit(SDRMConnectorCommitData& data, uint32_t flags, bool onlyTest);
+        bool                                                         commitData(SDRMConnectorCommitData& data, bool onlyTest);
+        bool                                                         finishCommit(SDRMConnectorCommitData& data, bool ok, bool onlyTest);
+
         Hyprutils::Memory::CWeakPointer<CDRMBackend>                 backend;
         Hyprutils::Memory::CSharedPointer<SDRMConnector>             connector;
         Hyprutils::Memory::CSharedPointer<std::function<void(void)>> frameIdle;
@@ -253,12 +290,28 @@ namespace Aquamarine {
         struct {
             Hyprutils::Memory::CSharedPointer<CSwapchain> swapchain;
             Hyprutils::Memory::CSharedPointer<CSwapchain> cursorSwapchain;
+
+            // the last blits into swapchain, newest first: which buffer got written and what changed in it.
+            // Lets a blit into an older buffer copy only what changed since that buffer was written.
+            struct SBlitDamage {
+                Hyprutils::Memory::CWeakPointer<IBuffer> buffer;
+                Hyprutils::Math::CRegion                 damage;
+            };
+            std::vector<SBlitDamage>       blitDamage;
+
+            // our own dup of the last blit's fence, the renderer closes its copy on the next blit, which
+            // can be for another head of the same commit
+            Hyprutils::OS::CFileDescriptor blitFence;
         } mgpu;
 
         bool lastCommitNoBuffer = true;
 
+        // the consumer's buffer of the commit waiting for its flip. With a blit, it's not the one on the plane.
+        Hyprutils::Memory::CWeakPointer<IBuffer> pendingPresent;
+
         friend struct SDRMConnector;
         friend class CDRMLease;
+        friend class CDRMBackend;
     };
 
     struct SDRMConnectorCommitData {
@@ -273,6 +326,19 @@ namespace Aquamarine {
         drmModeModeInfo                           modeInfo;
         std::optional<Hyprutils::Math::Mat3x3>    ctm;
         std::optional<hdr_output_metadata>        hdrMetadata;
+        bool                                      acquiredModesetBuffer = false; // mainFB was taken from the swapchain just for this modeset
+        bool                                      forcedModeset         = false; // retrying a failed commit as a modeset, trust none of our kms caches
+
+        // candidate layers for the overlay planes. The atomic impl fills in plane for the ones
+        // it managed to place, everything with a null plane has to be composited by the consumer.
+        struct SOverlay {
+            Hyprutils::Memory::CSharedPointer<SDRMPlane> plane;
+            Hyprutils::Memory::CSharedPointer<CDRMFB>    fb;
+            Hyprutils::Math::CBox                        src, dst;
+            int32_t                                      inFence = -1;
+            size_t                                       layer   = 0; // index into COutputState layers
+        };
+        std::vector<SOverlay> overlays;
 
         struct {
             uint32_t gammaLut   = 0;
@@ -304,7 +370,14 @@ namespace Aquamarine {
             bool maxBpcEmitted = false;
         } atomic;
 
-        void calculateMode(Hyprutils::Memory::CSharedPointer<SDRMConnector> connector);
+        // A blit still running on the render thread. It's only waited for right before the commit that scans it out,
+        // so it overlaps everything up to there, test commits included. awaitBlit resolves it once and hands out
+        // the same verdict after that, finishCommit takes care of the ones that never got that far.
+        std::function<bool()> pendingBlit;
+        std::optional<bool>   blitResult;
+        bool                  awaitBlit();
+
+        void                  calculateMode(Hyprutils::Memory::CSharedPointer<SDRMConnector> connector);
     };
 
     struct SDRMConnector {
@@ -327,6 +400,8 @@ namespace Aquamarine {
         bool                                           commitState(SDRMConnectorCommitData& data);
         void                                           applyCommit(const SDRMConnectorCommitData& data);
         void                                           onPresent();
+        // the flip landed on a vblank, for the scheduler and the output's stats
+        void                                           onVblank(std::chrono::steady_clock::time_point when, uint32_t seq, std::chrono::nanoseconds interval);
         void                                           recheckCRTCProps();
         void                                           parseTileInfo();
         void                                           releaseFBBuffer(const Hyprutils::Memory::CSharedPointer<CDRMFB> fb);
@@ -418,6 +493,9 @@ namespace Aquamarine {
         virtual bool commit(Hyprutils::Memory::CSharedPointer<SDRMConnector> connector, SDRMConnectorCommitData& data) = 0;
         virtual bool reset()                                                                                           = 0;
 
+        // commits several heads in one request with a single flip, returns false if not possible.
+        virtual bool commitGroup(std::vector<std::pair<Hyprutils::Memory::CSharedPointer<SDRMConnector>, SDRMConnectorCommitData*>>& heads) = 0;
+
         // moving a cursor IIRC is almost instant on most hardware so we don't have to wait for a commit.
         virtual bool moveCursor(Hyprutils::Memory::CSharedPointer<SDRMConnector> connector, bool skipSchedule = false) = 0;
     };
@@ -453,6 +531,11 @@ namespace Aquamarine {
         virtual eBackendGPUDriver                                          gpuDriver();
         Hyprutils::Memory::CSharedPointer<SDRMCRTC>                        crtcByID(uint32_t id);
 
+        // commits the pending states of the given outputs. Vsync'd flips without a modeset go out
+        // in a single atomic request, so they land on the same vblank. Everything else is committed
+        // one by one. Returns true if all commits succeeded.
+        bool commitOutputs(const std::vector<Hyprutils::Memory::CSharedPointer<CDRMOutput>>& outputs);
+
       private:
         CDRMBackend(Hyprutils::Memory::CSharedPointer<CBackend> backend);
 
@@ -467,21 +550,31 @@ namespace Aquamarine {
         bool updateSecondaryRendererState();
         bool grabFormats();
         bool shouldBlit();
-        void scanConnectors();
+        void scanConnectors(uint32_t probeID = 0 /* 0 probes every connector */);
         void scanLeases();
         void restoreAfterVT();
-        void recheckOutputs();
+        void recheckOutputs(uint32_t probeID = 0);
         void recheckCRTCs();
         void markRedundantTiles();
         void buildGlFormats(const std::vector<SGLFormat>& fmts);
 
+        // the renderer's formats from an earlier run on this gpu + driver + kernel, lets onReady skip bringing up egl
+        std::optional<std::vector<SGLFormat>> loadGlFormatCache();
+        void                                  saveGlFormatCache(const std::vector<SGLFormat>& fmts);
+        void rememberTestResult(uint64_t key, bool result);
+        void dispatchFrameTimer();
+        void updateFrameTimer();
+
         Hyprutils::Memory::CSharedPointer<CSessionDevice>     gpu;
         Hyprutils::Memory::CSharedPointer<IDRMImplementation> impl;
         Hyprutils::Memory::CWeakPointer<CDRMBackend>          primary;
+        Hyprutils::Memory::CSharedPointer<CDRMBlobCache>      blobs;        // atomic only
+        Hyprutils::Memory::CSharedPointer<CDRMCommitThread>   commitThread; // atomic with AQ_DRM_COMMIT_THREAD only
 
         struct {
             Hyprutils::Memory::CSharedPointer<IAllocator>   allocator;
-            Hyprutils::Memory::CSharedPointer<CDRMRenderer> renderer; // may be null if creation fails
+            Hyprutils::Memory::CSharedPointer<CDRMRenderer> renderer;   // may be null if creation fails
+            Hyprutils::Memory::CSharedPointer<CCPUBlitter>  cpuBlitter; // instead of renderer on secondaries without egl, allocator is then dumbAllocator
         } rendererState;
 
         bool                                                          rendererRequired = true;
@@ -494,18 +587,39 @@ namespace Aquamarine {
         std::vector<Hyprutils::Memory::CSharedPointer<SDRMConnector>> connectors;
         std::vector<SDRMFormat>                                       formats;
         std::vector<SDRMFormat>                                       glFormats;
+
+        // format -> modifier for buffers the primary renders and we blit from, negotiated by the primary's allocator.
+        // DRM_FORMAT_MOD_LINEAR if nothing else imported.
+        std::unordered_map<uint32_t, uint64_t> mgpuModifiers;
         uintptr_t                                                     m_lastPageFlipID = 0;
         uintptr_t                                                     nextPageFlipID();
 
         Hyprutils::Memory::CSharedPointer<CDRMDumbAllocator>          dumbAllocator;
 
+        // wakes outputs that hold back their frame event for a render deadline
+        Hyprutils::OS::CFileDescriptor                                frameTimerFD;
+
         bool                                                          atomic = false;
 
+        // outcomes of TEST_ONLY commits, keyed by a hash of the request and kmsGeneration. Cleared whenever the device
+        // changes in a way the request itself can't describe: hotplug, VT switch, leases and modesets.
+        std::unordered_map<uint64_t, bool>                            testResults;
+
+        // bumped by every applied commit that moves a plane or connector to another crtc (or off one). A test
+        // only holds for the assignments of the other heads it ran against, so this goes into its cache key.
+        uint64_t                                                      kmsGeneration = 0;
+
+        // last applied value of every KMS object property we've committed, keyed by object << 32 | prop.
+        // CDRMAtomicRequest leaves out anything that wouldn't change. Cleared whenever someone else may have touched KMS.
+        std::unordered_map<uint64_t, uint64_t>                        shadowProps;
+        void                                                          forgetShadowFB(uint32_t fbID);
+
         struct {
             Hyprutils::Math::Vector2D cursorSize;
             bool                      supportsAsyncCommit     = false;
             bool                      supportsAddFb2Modifiers = false;
             bool                      supportsTimelines       = false;
+            bool                      vblankIdleFrames        = false;
         } drmProps;
 
         struct {
@@ -526,5 +640,6 @@ namespace Aquamarine {
         friend class CDRMAtomicRequest;
         friend class CDRMLease;
         friend class CGBMBuffer;
+        friend class CGBMAllocator;
     };
 };
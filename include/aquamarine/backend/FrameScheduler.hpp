@@ -1,6 +1,10 @@
 #pragma once
 
 #include <hyprutils/signal/Signal.hpp>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
 
 namespace Aquamarine {
     // Per-output frame scheduling state, shared by the DRM and Wayland backends.
@@ -13,7 +17,7 @@ namespace Aquamarine {
         // a frame was submitted to the host with a completion event requested.
         // DRM: page-flip submitted with PAGE_FLIP_EVENT. Wayland: sendCommit followed
         // by a wl_surface.frame whose done is wired to onFrameComplete.
-        void onFrameSubmitted();
+        void onFrameSubmitted(std::chrono::steady_clock::time_point when = std::chrono::steady_clock::now());
 
         // the host delivered the frame completion event.
         // DRM: kernel page-flip handler. Wayland: wl_callback.done.
@@ -42,6 +46,30 @@ namespace Aquamarine {
         // a scheduleFrame arrived while a frame was running, so reschedule it when the frame is done.
         void requestReschedule();
 
+        // Vblank prediction, for backends that know when scanout happens (DRM).
+        // when is the hw timestamp of a completed flip, seq its vblank counter (0 if the driver has none),
+        // interval the nominal refresh interval of the mode. Consecutive seqs refine the interval.
+        void onVblank(std::chrono::steady_clock::time_point when, uint32_t seq, std::chrono::nanoseconds interval);
+
+        // the first vblank after now, if we've seen one to extrapolate from.
+        std::optional<std::chrono::steady_clock::time_point> predictNextVblank(std::chrono::steady_clock::time_point now) const;
+
+        // How long before the vblank a frame has to be committed. 0 (default) disables holding frames back.
+        void                     setRenderDeadline(std::chrono::nanoseconds deadline);
+        std::chrono::nanoseconds renderDeadline() const;
+
+        // Render time, measured from onRenderStart to the next onFrameSubmitted. The estimate is the worst of
+        // the last few frames, so one fast frame can't make the next one miss its vblank. A frame the consumer
+        // didn't commit leaves its start behind, so a submit that comes after the vblank following the one the
+        // frame was started for doesn't count.
+        void                     onRenderStart(std::chrono::steady_clock::time_point when = std::chrono::steady_clock::now());
+        void                     addRenderTime(std::chrono::nanoseconds time);
+        std::chrono::nanoseconds renderTimeEstimate() const;
+
+        // When the frame event should go out so rendering finishes right at the deadline of the next vblank.
+        // Empty means now: no deadline, nothing to predict from, or that point has already passed.
+        std::optional<std::chrono::steady_clock::time_point> frameEventTime(std::chrono::steady_clock::time_point now) const;
+
         // Fires from onFrameComplete. The output wires this to events.frame.emit.
         Hyprutils::Signal::CSignalT<> frameReady;
 
@@ -54,6 +82,20 @@ namespace Aquamarine {
         bool m_frameRunning        = false;
         bool m_rescheduleRequested = false;
 
+        struct {
+            std::optional<std::chrono::steady_clock::time_point> last;
+            uint32_t                                             lastSeq  = 0;
+            std::chrono::nanoseconds                             interval = {};
+        } m_vblank;
+
+        struct {
+            std::chrono::nanoseconds                             deadline = {};
+            std::optional<std::chrono::steady_clock::time_point> start;
+            std::optional<std::chrono::steady_clock::time_point> target; // vblank the started frame is for
+            std::array<std::chrono::nanoseconds, 8>              samples = {};
+            size_t                                               next    = 0;
+        } m_render;
+
         friend class CFrameRunningGuard;
     };
 
@@ -8,10 +8,13 @@ namespace Aquamarine {
         CDRMAtomicImpl(Hyprutils::Memory::CSharedPointer<CDRMBackend> backend_);
         virtual bool commit(Hyprutils::Memory::CSharedPointer<SDRMConnector> connector, SDRMConnectorCommitData& data);
         virtual bool reset();
+        virtual bool commitGroup(std::vector<std::pair<Hyprutils::Memory::CSharedPointer<SDRMConnector>, SDRMConnectorCommitData*>>& heads);
         virtual bool moveCursor(Hyprutils::Memory::CSharedPointer<SDRMConnector> connector, bool skipSchedule = false);
 
       private:
         bool                                         prepareConnector(Hyprutils::Memory::CSharedPointer<SDRMConnector> connector, SDRMConnectorCommitData& data);
+        void                                         placeLayers(Hyprutils::Memory::CSharedPointer<SDRMConnector> connector, SDRMConnectorCommitData& data,
+                                                                 const std::vector<uint32_t>& taken = {});
 
         Hyprutils::Memory::CWeakPointer<CDRMBackend> backend;
 
@@ -28,9 +31,15 @@ namespace Aquamarine {
         bool restateConnectors(Hyprutils::Memory::CSharedPointer<SDRMConnector> self);
         void addConnectorModeset(Hyprutils::Memory::CSharedPointer<SDRMConnector> connector, SDRMConnectorCommitData& data);
         void addConnectorCursor(Hyprutils::Memory::CSharedPointer<SDRMConnector> connector, SDRMConnectorCommitData& data);
+        void addConnectorOverlays(Hyprutils::Memory::CSharedPointer<SDRMConnector> connector, SDRMConnectorCommitData& data);
         bool commit(uint32_t flagssss);
+        // commits a flip of a single head on the backend's commit thread. The kernel's verdict comes later,
+        // request is kept alive until then.
+        static bool commitAsync(Hyprutils::Memory::CSharedPointer<CDRMAtomicRequest> request, uint32_t flags);
         void add(uint32_t id, uint32_t prop, uint64_t val);
         void planeProps(Hyprutils::Memory::CSharedPointer<SDRMPlane> plane, Hyprutils::Memory::CSharedPointer<CDRMFB> fb, uint32_t crtc, Hyprutils::Math::Vector2D pos);
+        void planeProps(Hyprutils::Memory::CSharedPointer<SDRMPlane> plane, Hyprutils::Memory::CSharedPointer<CDRMFB> fb, uint32_t crtc, const Hyprutils::Math::CBox& src,
+                        const Hyprutils::Math::CBox& dst);
         void planePropsPos(Hyprutils::Memory::CSharedPointer<SDRMPlane> plane, Hyprutils::Math::Vector2D pos);
 
         void rollback(SDRMConnectorCommitData& data);
@@ -39,6 +48,8 @@ namespace Aquamarine {
         bool failed = false;
 
       private:
+        void                                             addKeyed(uint32_t id, uint32_t prop, uint64_t val, uint64_t keyVal, bool always = false);
+        void                                             addAssignment(uint32_t id, uint32_t prop, uint64_t val);
         void                                             destroyBlob(uint32_t id);
         void                                             commitBlob(uint32_t* current, uint32_t next);
         void                                             rollbackBlob(uint32_t* current, uint32_t next);
@@ -49,5 +60,23 @@ namespace Aquamarine {
 
         // mode blobs minted by restateConnectors, owned by this request
         std::vector<uint32_t> borrowedModeBlobs;
+
+        // hash of every property in the request, see CDRMAtomicRequest::commit
+        uint64_t testKey = 0;
+
+        // some crtc_id in the request differs from what the kernel has, see addAssignment
+        bool reassigns = false;
+
+        // put every property into the request, even ones shadowProps says the kernel already has
+        bool noDelta = false;
+
+        // (object << 32 | prop, value) actually put into the request, written to the backend's shadowProps once applied
+        std::vector<std::pair<uint64_t, uint64_t>> staged;
+
+        // every enabled head added through addConnector, more than one means this is a grouped commit
+        std::vector<Hyprutils::Memory::CSharedPointer<SDRMConnector>> heads;
+
+        // every kms object with a property in the request, which is what commits wait on each other for on the commit thread
+        std::vector<uint32_t> objects;
     };
 };
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <hyprutils/math/Region.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Aquamarine {
+
+    // a mapped, linear, single plane 32bpp image
+    struct SCPUBlitImage {
+        uint8_t*                  data   = nullptr;
+        size_t                    stride = 0;
+        uint32_t                  format = 0; // fourcc
+        Hyprutils::Math::Vector2D size;
+        bool                      writeCombined = false; // as a destination, stores go around the cache
+    };
+
+    /*
+        Copies between mapped buffers on the cpu, for secondary gpus that have no usable renderer
+        (simpledrm, some arm display controllers). Converts the 8888 formats into each other and 2101010
+        down to 8888 on the way, with avx2 / neon where there is some. Rects are split into bands that
+        a small pool of workers and the caller go through together.
+    */
+    class CCPUBlitter {
+      public:
+        // 0 picks based on the cpu
+        CCPUBlitter(size_t threads = 0);
+        ~CCPUBlitter();
+
+        static bool supported(uint32_t from, uint32_t to);
+
+        // copies the damaged part of from into to, which have to be the same size. Empty damage copies it all.
+        // Blocks until done.
+        bool blit(const SCPUBlitImage& from, const SCPUBlitImage& to, const Hyprutils::Math::CRegion& damage = {});
+
+      private:
+        struct STask {
+            const uint8_t* src       = nullptr;
+            uint8_t*       dst       = nullptr;
+            size_t         srcStride = 0, dstStride = 0;
+            size_t         width = 0, rows = 0;
+            uint32_t       srcFormat = 0, dstFormat = 0;
+            bool           streaming = false;
+        };
+
+        static void              runTask(const STask& task);
+        void                     work();
+        bool                     runOne();
+
+        std::vector<std::thread> workers;
+        std::mutex               mutex, blitMutex;
+        std::condition_variable  cv, doneCV;
+        std::vector<STask>       tasks;
+        size_t                   nextTask = 0, unfinished = 0;
+        bool                     exit = false;
+    };
+};
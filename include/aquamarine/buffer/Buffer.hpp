@@ -12,6 +12,11 @@ namespace Aquamarine {
         BUFFER_CAPABILITY_DATAPTR = (1 << 0),
     };
 
+    enum eBufferDataAccess : uint32_t {
+        BUFFER_DATA_READ  = (1 << 0),
+        BUFFER_DATA_WRITE = (1 << 1),
+    };
+
     enum eBufferType : uint32_t {
         BUFFER_TYPE_DMABUF = 0,
         BUFFER_TYPE_SHM,
@@ -39,6 +44,15 @@ namespace Aquamarine {
         int64_t                   offset = 0;
     };
 
+    // a part of a buffer mapped for the cpu, see IBuffer::beginDataRange
+    struct SBufferDataRange {
+        uint8_t*              data   = nullptr; // the top left pixel of box
+        uint32_t              format = 0;       // fourcc
+        size_t                stride = 0;
+        Hyprutils::Math::CBox box;                   // in buffer pixels. Only what's inside of it is valid
+        bool                  writeCombined = false; // uncached memory: don't read from it, write with streaming stores
+    };
+
     class IBuffer {
       public:
         virtual ~IBuffer() {
@@ -58,6 +72,13 @@ namespace Aquamarine {
         virtual void                                   lock();
         virtual void                                   unlock();
         virtual bool                                   locked();
+        // maps (at least) the extents of region for access (eBufferDataAccess), empty maps the whole buffer.
+        // Unlike beginDataPtr this can keep a mapping around between calls and only sync what's asked for.
+        // Has to be paired with endDataRange. Falls back to beginDataPtr.
+        virtual SBufferDataRange                       beginDataRange(const Hyprutils::Math::CRegion& region, uint32_t access);
+        virtual void                                   endDataRange();
+        // the memory behind the buffer, padding and tiling included as far as that can be told. 0 if unknown
+        virtual size_t                                 allocatedBytes();
 
         Hyprutils::Math::Vector2D                      size;
         bool                                           opaque          = false;
@@ -70,6 +91,10 @@ namespace Aquamarine {
             Hyprutils::Signal::CSignalT<> backendRelease;
         } events;
 
+      protected:
+        // the extents of region clamped to the buffer, all of it for an empty one
+        Hyprutils::Math::CBox dataRangeBox(const Hyprutils::Math::CRegion& region);
+
       private:
         int locks = 0;
     };
@@ -2,9 +2,12 @@
 
 #include <vector>
 #include <optional>
+#include <chrono>
+#include <array>
 #include <hyprutils/signal/Signal.hpp>
 #include <hyprutils/memory/SharedPtr.hpp>
 #include <hyprutils/math/Region.hpp>
+#include <hyprutils/math/Box.hpp>
 #include <hyprutils/math/Mat3x3.hpp>
 #include <drm_fourcc.h>
 #include <xf86drmMode.h>
@@ -15,6 +18,8 @@
 namespace Aquamarine {
 
     class IBackendImplementation;
+    class CDRMOutput;
+    struct SDRMConnector;
 
     struct SOutputMode {
         Hyprutils::Math::Vector2D      pixelSize;
@@ -45,6 +50,83 @@ namespace Aquamarine {
 
     class IOutput;
 
+    /*
+        A layer the consumer would like scanned out directly by a hardware plane instead of
+        being composited into the main buffer. After a test(), accepted tells whether the backend
+        found a plane for it. Rejected layers have to be composited. Layers only apply to the
+        next commit, they're cleared once it goes through and have to be set again every frame.
+    */
+    struct SOutputLayer {
+        Hyprutils::Memory::CSharedPointer<IBuffer> buffer;
+        Hyprutils::Math::CBox                      src; // in buffer pixels, empty means the whole buffer
+        Hyprutils::Math::CBox                      dst; // in output pixels
+        int32_t                                    z        = 0;  // higher is on top, all layers are above the main buffer
+        int32_t                                    inFence  = -1; // explicit sync acquire fence for buffer, -1 for implicit sync
+        bool                                       accepted = false;
+    };
+
+    /*
+        Presentation statistics of an output, filled in by the backend, see IOutput::getStats. Fixed size, nothing
+        here allocates, so it's cheap enough to keep on all the time. Only backends with real flip events (DRM) fill
+        in latencies and missed vblanks.
+    */
+    class COutputStats {
+      public:
+        static constexpr size_t HISTORY_SIZE    = 128;
+        static constexpr size_t LATENCY_BUCKETS = 34; // 1ms each, the last one is everything longer
+
+        struct SFrame {
+            std::chrono::steady_clock::time_point committed, presented;
+            std::chrono::nanoseconds              blit   = {}; // 0 if it wasn't blitted
+            uint32_t                              seq    = 0;
+            uint32_t                              missed = 0; // vblanks between the one we aimed for and the one we got
+        };
+
+        // counters since creation / the last reset()
+        uint64_t                                  commits       = 0;
+        uint64_t                                  presents      = 0;
+        uint64_t                                  testCommits   = 0;
+        uint64_t                                  modesets      = 0;
+        uint64_t                                  asyncCommits  = 0; // tearing
+        uint64_t                                  missedVblanks = 0;
+        uint64_t                                  blits         = 0;
+        std::chrono::nanoseconds                  blitTime      = {}, maxBlitTime = {};
+        std::array<uint64_t, LATENCY_BUCKETS>     latency       = {}; // commit -> flip
+
+        // the last presented frames, 0 is the oldest. i < historySize()
+        size_t        historySize() const;
+        const SFrame& historyAt(size_t i) const;
+
+        void          reset();
+
+      protected:
+        // for backends. A blit belongs to the next onCommit, test, async and failed commits drop it.
+        void onCommit(std::chrono::steady_clock::time_point when);
+        void onFailedCommit();
+        void onTestCommit();
+        void onModeset();
+        void onAsyncCommit();
+        void onBlit(std::chrono::nanoseconds duration);
+        void onPresent(std::chrono::steady_clock::time_point when, uint32_t seq, std::chrono::nanoseconds refreshInterval);
+
+      private:
+        std::array<SFrame, HISTORY_SIZE> history = {};
+        size_t                           head = 0, count = 0;
+
+        // the commit waiting on its flip
+        std::optional<std::chrono::steady_clock::time_point> pendingCommit;
+        std::chrono::nanoseconds                             pendingBlit = {};
+
+        // blitted for a commit that hasn't gone through yet
+        std::chrono::nanoseconds stagedBlit = {};
+
+        std::optional<std::chrono::steady_clock::time_point> lastPresent;
+        uint32_t                                             lastSeq = 0;
+
+        friend class CDRMOutput;
+        friend struct SDRMConnector;
+    };
+
     class COutputState {
       public:
         enum eOutputStateProperties : uint32_t {
@@ -64,6 +146,7 @@ namespace Aquamarine {
             AQ_OUTPUT_STATE_WCG                = (1 << 13),
             AQ_OUTPUT_STATE_CURSOR_SHAPE       = (1 << 14),
             AQ_OUTPUT_STATE_CURSOR_POS         = (1 << 15),
+            AQ_OUTPUT_STATE_LAYERS             = (1 << 16),
         };
 
         struct SInternalState {
@@ -86,6 +169,7 @@ namespace Aquamarine {
             hdr_output_metadata                            hdrMetadata;
             uint16_t                                       contentType = DRM_MODE_CONTENT_TYPE_GRAPHICS;
             eOutputColorRange                              colorRange  = AQ_OUTPUT_COLOR_RANGE_AUTO;
+            std::vector<SOutputLayer>                      layers;
         };
 
         const SInternalState& state();
@@ -110,6 +194,7 @@ namespace Aquamarine {
         void                  setHDRMetadata(const hdr_output_metadata& metadata);
         void                  setContentType(const uint16_t drmContentType);
         void                  setColorRange(eOutputColorRange range);
+        void                  setLayers(const std::vector<SOutputLayer>& layers); // empty removes all
 
       private:
         SInternalState internalState;
@@ -182,6 +267,10 @@ namespace Aquamarine {
         virtual bool                                                      destroy(); // not all backends allow this!!!
         virtual bool                                                      pendingPageFlip()  = 0;
         virtual bool                                                      pendingIdleFrame() = 0;
+        virtual size_t                                                    maxLayers(); // how many layers can at most be offloaded, 0 if unsupported
+        // frame events wait so that rendering ends deadline before the predicted vblank, 0 disables it
+        virtual void                                                      setRenderDeadline(std::chrono::nanoseconds deadline);
+        virtual std::optional<std::chrono::steady_clock::time_point>      predictedVblank(); // empty if unknown
 
         std::string                                                       name, description, make, model, serial;
         SParsedEDID                                                       parsedEDID;
@@ -199,6 +288,9 @@ namespace Aquamarine {
 
         Hyprutils::Memory::CSharedPointer<CSwapchain>               swapchain;
 
+        const COutputStats&                                         getStats();
+        void                                                        resetStats();
+
         //
 
         enum eOutputPresentFlags : uint32_t {
@@ -227,5 +319,8 @@ namespace Aquamarine {
             Hyprutils::Signal::CSignalT<>              commit;
             Hyprutils::Signal::CSignalT<SStateEvent>   state;
         } events;
+
+      protected:
+        COutputStats stats;
     };
 }
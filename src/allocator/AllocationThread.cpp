@@ -0,0 +1,93 @@
+#include "AllocationThread.hpp"
+#include <cerrno>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+using namespace Aquamarine;
+
+Aquamarine::CAllocationThread::CAllocationThread() {
+    event = Hyprutils::OS::CFileDescriptor{eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)};
+    if (!event.isValid())
+        return;
+
+    thread = std::thread([this] { run(); });
+}
+
+Aquamarine::CAllocationThread::~CAllocationThread() {
+    {
+        std::lock_guard<std::mutex> lg(mutex);
+        exit = true;
+    }
+    cv.notify_all();
+
+    // a job that's running has to finish first, its owner goes away with the queues below
+    if (thread.joinable())
+        thread.join();
+}
+
+bool Aquamarine::CAllocationThread::good() const {
+    return event.isValid() && thread.joinable();
+}
+
+int Aquamarine::CAllocationThread::eventFD() const {
+    return event.get();
+}
+
+void Aquamarine::CAllocationThread::submit(std::vector<IAllocationJob*> jobs, FJobsDone done) {
+    {
+        std::lock_guard<std::mutex> lg(mutex);
+        queued.emplace_back(SBatch{.jobs = std::move(jobs), .done = std::move(done)});
+    }
+    cv.notify_one();
+}
+
+void Aquamarine::CAllocationThread::dispatch() {
+    // EAGAIN is fine, the finished batches are what's in finished, not the count
+    uint64_t count = 0;
+    ssize_t  ret   = 0;
+    do {
+        ret = read(event.get(), &count, sizeof(count));
+    } while (ret < 0 && errno == EINTR);
+
+    std::deque<SBatch> batches;
+    {
+        std::lock_guard<std::mutex> lg(mutex);
+        batches.swap(finished);
+    }
+
+    for (auto& batch : batches) {
+        if (batch.done)
+            batch.done();
+    }
+}
+
+void Aquamarine::CAllocationThread::run() {
+    while (true) {
+        std::unique_lock<std::mutex> lk(mutex);
+        cv.wait(lk, [this] { return exit || !queued.empty(); });
+
+        if (exit) {
+            queued.clear();
+            return;
+        }
+
+        SBatch batch = std::move(queued.front());
+        queued.pop_front();
+        lk.unlock();
+
+        for (auto const& job : batch.jobs) {
+            job->run();
+        }
+
+        lk.lock();
+        finished.emplace_back(std::move(batch));
+        lk.unlock();
+
+        // EAGAIN only comes with the counter about to overflow, it's readable either way
+        const uint64_t ONE = 1;
+        ssize_t        ret = 0;
+        do {
+            ret = write(event.get(), &ONE, sizeof(ONE));
+        } while (ret < 0 && errno == EINTR);
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <aquamarine/allocator/Allocator.hpp>
+#include <hyprutils/os/FileDescriptor.hpp>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Aquamarine {
+
+    /*
+        Runs the expensive part of buffer allocations (IAllocationJob::run) off the main loop, for
+        CSwapchain::reconfigureAsync. A new generation of 8K scanout buffers is a lot of memory for the kernel to
+        clear and map, and frames shouldn't stall for that. Like the drm commit thread, completions are queued and
+        signalled on an eventfd, which the backend polls and hands to dispatch().
+    */
+    class CAllocationThread {
+      public:
+        CAllocationThread();
+        ~CAllocationThread();
+
+        // called from dispatch(), on the main thread
+        using FJobsDone = std::function<void()>;
+
+        bool good() const;
+        int  eventFD() const;
+
+        // the jobs have to stay alive until done has run, keep their owners in done.
+        void submit(std::vector<IAllocationJob*> jobs, FJobsDone done);
+
+        // runs the callbacks of finished submissions
+        void dispatch();
+
+      private:
+        struct SBatch {
+            std::vector<IAllocationJob*> jobs;
+            FJobsDone                    done;
+        };
+
+        void                           run();
+
+        Hyprutils::OS::CFileDescriptor event;
+        std::thread                    thread;
+
+        std::mutex                     mutex;
+        std::condition_variable        cv;
+        std::deque<SBatch>             queued, finished;
+        bool                           exit = false;
+    };
+};
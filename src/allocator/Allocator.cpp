@@ -1,3 +1,74 @@
 #include <aquamarine/allocator/Allocator.hpp>
+#include <aquamarine/backend/Backend.hpp>
+#include <algorithm>
+
+using namespace Aquamarine;
+
+void Aquamarine::SAllocatorStats::add(Hyprutils::Memory::CSharedPointer<IBuffer> buffer) {
+    if (!buffer)
+        return;
+
+    uint32_t format   = DRM_FORMAT_INVALID;
+    uint64_t modifier = DRM_FORMAT_MOD_INVALID;
+    if (buffer->type() == BUFFER_TYPE_SHM) {
+        format   = buffer->shm().format;
+        modifier = DRM_FORMAT_MOD_LINEAR;
+    } else if (buffer->type() == BUFFER_TYPE_DMABUF) {
+        const auto ATTRS = buffer->dmabuf();
+        format           = ATTRS.format;
+        modifier         = ATTRS.modifier;
+    }
+
+    const size_t BYTES = buffer->allocatedBytes();
+
+    buffers++;
+    bytes += BYTES;
+
+    auto it = std::ranges::find_if(formats, [format, modifier](const auto& f) { return f.format == format && f.modifier == modifier; });
+    if (it == formats.end())
+        it = formats.insert(formats.end(), SFormatStats{.format = format, .modifier = modifier});
+
+    it->buffers++;
+    it->bytes += BYTES;
+}
 
 void Aquamarine::IAllocator::destroyBuffers() {}
+
+void Aquamarine::IAllocator::recycle(Hyprutils::Memory::CSharedPointer<IBuffer> buffer) {}
+
+Hyprutils::Memory::CSharedPointer<Aquamarine::IAllocationJob> Aquamarine::IAllocator::prepareAcquire(const SAllocatorBufferParams& params, Hyprutils::Memory::CSharedPointer<CSwapchain> swapchain) {
+    return nullptr;
+}
+
+SAllocatorStats Aquamarine::IAllocator::stats() {
+    return {};
+}
+
+bool Aquamarine::IAllocator::fitsBudget(size_t bytes, size_t freed) {
+    const auto BUDGET = getBudget();
+    if (!BUDGET)
+        return true;
+
+    const auto STATS = stats();
+    return STATS.bytes + STATS.readbackBytes + bytes <= BUDGET + freed;
+}
+
+void Aquamarine::IAllocator::trim() {}
+
+void Aquamarine::IAllocator::makeRoom(size_t bytes, size_t freed) {}
+
+bool Aquamarine::IAllocator::hasPooled() {
+    return false;
+}
+
+void Aquamarine::IAllocator::setBudget(size_t bytes) {
+    budget = bytes;
+}
+
+size_t Aquamarine::IAllocator::getBudget() {
+    if (budget)
+        return budget;
+
+    auto backend = getBackend();
+    return backend ? backend->getAllocatorBudget() : 0;
+}
@@ -99,13 +99,25 @@ SDMABUFAttrs Aquamarine::CDRMDumbBuffer::dmabuf() {
 }
 
 std::tuple<uint8_t*, uint32_t, size_t> Aquamarine::CDRMDumbBuffer::beginDataPtr(uint32_t flags) {
-    return {data, attrs.format, bufferLen};
+    // what's actually the image, bufferLen can be rounded up past it
+    return {data, attrs.format, (size_t)stride * (size_t)pixelSize.y};
 }
 
 void Aquamarine::CDRMDumbBuffer::endDataPtr() {
     ; // nothing to do
 }
 
+SBufferDataRange Aquamarine::CDRMDumbBuffer::beginDataRange(const Hyprutils::Math::CRegion& region, uint32_t access) {
+    auto range = IBuffer::beginDataRange(region, access);
+    // dumb buffers are mapped write-combined or uncached by most drivers
+    range.writeCombined = true;
+    return range;
+}
+
+size_t Aquamarine::CDRMDumbBuffer::allocatedBytes() {
+    return good() ? bufferLen : 0;
+}
+
 Aquamarine::CDRMDumbAllocator::~CDRMDumbAllocator() {
     ; // nothing to do
 }
@@ -136,9 +148,12 @@ SP<CDRMDumbAllocator> Aquamarine::CDRMDumbAllocator::create(int drmfd_, Hyprutil
 }
 
 SP<IBuffer> Aquamarine::CDRMDumbAllocator::acquire(const SAllocatorBufferParams& params, SP<CSwapchain> swapchain_) {
-    auto buf = SP<IBuffer>(new CDRMDumbBuffer(params, self, swapchain_));
+    auto buf = SP<CDRMDumbBuffer>(new CDRMDumbBuffer(params, self, swapchain_));
     if (!buf->good())
         return nullptr;
+
+    buffers.emplace_back(buf);
+    std::erase_if(buffers, [](const auto& b) { return b.expired(); });
     return buf;
 }
 
@@ -154,6 +169,14 @@ eAllocatorType Aquamarine::CDRMDumbAllocator::type() {
     return eAllocatorType::AQ_ALLOCATOR_TYPE_DRM_DUMB;
 }
 
+SAllocatorStats Aquamarine::CDRMDumbAllocator::stats() {
+    SAllocatorStats stats;
+    for (auto const& b : buffers) {
+        stats.add(b.lock());
+    }
+    return stats;
+}
+
 Aquamarine::CDRMDumbAllocator::CDRMDumbAllocator(int fd_, Hyprutils::Memory::CWeakPointer<CBackend> backend_) : backend(backend_), drmfd(fd_) {
     ; // nothing to do
 }
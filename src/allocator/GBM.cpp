@@ -7,12 +7,23 @@
 #include "Shared.hpp"
 #include <xf86drm.h>
 #include <gbm.h>
+#include <linux/dma-buf.h>
+#include <sys/mman.h>
 #include <unistd.h>
 #include "../backend/drm/Renderer.hpp"
 
 using namespace Aquamarine;
 using namespace Hyprutils::Memory;
 #define SP CSharedPointer
+#define WP CWeakPointer
+
+// what the pool may keep around in released buffers, and for how long
+constexpr size_t                    POOL_BUDGET  = 128 * 1024 * 1024;
+constexpr std::chrono::milliseconds POOL_MAX_AGE = std::chrono::seconds(30);
+
+static uint64_t dmabufSyncAccess(uint32_t access) {
+    return ((access & BUFFER_DATA_READ) ? DMA_BUF_SYNC_READ : 0) | ((access & BUFFER_DATA_WRITE) ? DMA_BUF_SYNC_WRITE : 0);
+}
 
 static SDRMFormat guessFormatFrom(std::vector<SDRMFormat> formats, bool cursor, bool scanout) {
     if (formats.empty())
@@ -61,51 +72,51 @@ static SDRMFormat guessFormatFrom(std::vector<SDRMFormat> formats, bool cursor,
     return formats.at(0);
 }
 
-Aquamarine::CGBMBuffer::CGBMBuffer(const SAllocatorBufferParams& params, Hyprutils::Memory::CWeakPointer<CGBMAllocator> allocator_,
-                                   Hyprutils::Memory::CSharedPointer<CSwapchain> swapchain) : allocator(allocator_) {
-    if (!allocator)
-        return;
-
-    attrs.size   = params.size;
-    attrs.format = params.format;
-    size         = attrs.size;
+bool Aquamarine::CGBMAllocator::planBuffer(const SAllocatorBufferParams& params, SP<CSwapchain> swapchain, SGBMBufferPlan& plan) {
+    plan         = {};
+    plan.size    = params.size;
+    plan.format  = params.format;
+    plan.scanout = params.scanout;
 
     const bool CURSOR           = params.cursor && params.scanout;
     const bool MULTIGPU         = params.multigpu && params.scanout;
     const bool EXPLICIT_SCANOUT = params.scanout && swapchain->currentOptions().scanoutOutput && !params.multigpu;
 
-    TRACE(allocator->backend->log(AQ_LOG_TRACE,
-                                  std::format("GBM: Allocating a buffer: size {}, format {}, cursor: {}, multigpu: {}, scanout: {}", attrs.size, fourccToName(attrs.format), CURSOR,
-                                              MULTIGPU, params.scanout)));
+    plan.cursor   = CURSOR;
+    plan.multigpu = MULTIGPU;
+
+    TRACE(backend->log(AQ_LOG_TRACE,
+                       std::format("GBM: Allocating a buffer: size {}, format {}, cursor: {}, multigpu: {}, scanout: {}", plan.size, fourccToName(plan.format), CURSOR, MULTIGPU,
+                                   params.scanout)));
 
     if (EXPLICIT_SCANOUT)
-        TRACE(allocator->backend->log(
-            AQ_LOG_TRACE, std::format("GBM: Explicit scanout output, output has {} explicit formats", swapchain->currentOptions().scanoutOutput->getRenderFormats().size())));
+        TRACE(backend->log(AQ_LOG_TRACE,
+                           std::format("GBM: Explicit scanout output, output has {} explicit formats", swapchain->currentOptions().scanoutOutput->getRenderFormats().size())));
 
     const auto FORMATS    = CURSOR ? swapchain->backendImpl->getCursorFormats() :
                                      (EXPLICIT_SCANOUT ? swapchain->currentOptions().scanoutOutput->getRenderFormats() : swapchain->backendImpl->getRenderFormats());
     const auto RENDERABLE = swapchain->backendImpl->getRenderableFormats();
 
-    TRACE(allocator->backend->log(AQ_LOG_TRACE, std::format("GBM: Available formats: {}", FORMATS.size())));
+    TRACE(backend->log(AQ_LOG_TRACE, std::format("GBM: Available formats: {}", FORMATS.size())));
 
     std::vector<uint64_t> explicitModifiers;
 
-    if (attrs.format == DRM_FORMAT_INVALID) {
-        attrs.format = guessFormatFrom(FORMATS, CURSOR, params.scanout).drmFormat;
-        if (attrs.format != DRM_FORMAT_INVALID)
-            allocator->backend->log(AQ_LOG_DEBUG, std::format("GBM: Automatically selected format {} for new GBM buffer", fourccToName(attrs.format)));
+    if (plan.format == DRM_FORMAT_INVALID) {
+        plan.format = guessFormatFrom(FORMATS, CURSOR, params.scanout).drmFormat;
+        if (plan.format != DRM_FORMAT_INVALID)
+            backend->log(AQ_LOG_DEBUG, std::format("GBM: Automatically selected format {} for new GBM buffer", fourccToName(plan.format)));
     }
 
-    if (attrs.format == DRM_FORMAT_INVALID) {
-        allocator->backend->log(AQ_LOG_ERROR, "GBM: Failed to allocate a GBM buffer: no format found");
-        return;
+    if (plan.format == DRM_FORMAT_INVALID) {
+        backend->log(AQ_LOG_ERROR, "GBM: Failed to allocate a GBM buffer: no format found");
+        return false;
     }
 
     bool foundFormat = false;
     // check if we can use modifiers. If the requested support has any explicit modifier
     // supported by the primary backend, we can.
     for (auto const& f : FORMATS) {
-        if (f.drmFormat != attrs.format)
+        if (f.drmFormat != plan.format)
             continue;
 
         foundFormat = true;
@@ -114,18 +125,18 @@ Aquamarine::CGBMBuffer::CGBMBuffer(const SAllocatorBufferParams& params, Hypruti
                 continue;
 
             if (!RENDERABLE.empty()) {
-                TRACE(allocator->backend->log(AQ_LOG_TRACE, std::format("GBM: Renderable has {} formats, clipping", RENDERABLE.size())));
+                TRACE(backend->log(AQ_LOG_TRACE, std::format("GBM: Renderable has {} formats, clipping", RENDERABLE.size())));
                 if (params.scanout && !CURSOR && !MULTIGPU) {
                     // regular scanout plane, check if the format is renderable
                     auto rformat = std::ranges::find_if(RENDERABLE, [f](const auto& e) { return e.drmFormat == f.drmFormat; });
 
                     if (rformat == RENDERABLE.end()) {
-                        TRACE(allocator->backend->log(AQ_LOG_TRACE, std::format("GBM: Dropping format {} as it's not renderable", fourccToName(f.drmFormat))));
+                        TRACE(backend->log(AQ_LOG_TRACE, std::format("GBM: Dropping format {} as it's not renderable", fourccToName(f.drmFormat))));
                         break;
                     }
 
                     if (std::find(rformat->modifiers.begin(), rformat->modifiers.end(), m) == rformat->modifiers.end()) {
-                        TRACE(allocator->backend->log(AQ_LOG_TRACE, std::format("GBM: Dropping modifier 0x{:x} : {} as it's not renderable", m, drmModifierToName(m))));
+                        TRACE(backend->log(AQ_LOG_TRACE, std::format("GBM: Dropping modifier 0x{:x} : {} as it's not renderable", m, drmModifierToName(m))));
                         continue;
                     }
                 }
@@ -135,19 +146,44 @@ Aquamarine::CGBMBuffer::CGBMBuffer(const SAllocatorBufferParams& params, Hypruti
     }
 
     if (!foundFormat) {
-        allocator->backend->log(AQ_LOG_ERROR, std::format("GBM: Failed to allocate a GBM buffer: format {} isn't supported by primary backend", fourccToName(attrs.format)));
-        bo = nullptr;
-        return;
+        backend->log(AQ_LOG_ERROR, std::format("GBM: Failed to allocate a GBM buffer: format {} isn't supported by primary backend", fourccToName(plan.format)));
+        return false;
     }
 
     static const auto forceLinearBlit = !envExplicitlyDisabled("AQ_FORCE_LINEAR_BLIT");
-    auto const        oldMods         = explicitModifiers; // used in FORCE_LINEAR_BLIT case.
-    if (MULTIGPU && !forceLinearBlit) {
+    static const auto alwaysLinear    = envEnabled("AQ_FORCE_LINEAR_BLIT");
+    plan.fallbackModifiers            = explicitModifiers; // used in FORCE_LINEAR_BLIT case.
+
+    // linear works everywhere but is slow to sample and scan out. Unless told otherwise, ask the gpu that will blit
+    // from this buffer what else it can take.
+    std::optional<uint64_t> negotiated;
+    if (MULTIGPU && forceLinearBlit && !alwaysLinear) {
+        SP<IBackendImplementation> impl;
+        if (const auto OUTPUT = swapchain->currentOptions().scanoutOutput.lock())
+            impl = OUTPUT->getBackend();
+
+        if (impl && impl->type() == AQ_BACKEND_DRM && ((CDRMBackend*)impl.get())->primary) {
+            std::vector<uint64_t> candidates;
+            auto                  rformat = std::ranges::find_if(RENDERABLE, [&plan](const auto& e) { return e.drmFormat == plan.format; });
+            for (auto const& m : explicitModifiers) {
+                // we have to render to it too
+                if (rformat != RENDERABLE.end() && std::ranges::find(rformat->modifiers, m) != rformat->modifiers.end())
+                    candidates.emplace_back(m);
+            }
+
+            negotiated = negotiateMgpuModifier((CDRMBackend*)impl.get(), plan.format, candidates);
+        }
+    }
+
+    if (negotiated) {
+        backend->log(AQ_LOG_DEBUG, std::format("GBM: Buffer is marked as multigpu, using negotiated modifier 0x{:x} : {}", *negotiated, drmModifierToName(*negotiated)));
+        explicitModifiers = {*negotiated};
+    } else if (MULTIGPU && !forceLinearBlit) {
         // Try to use the linear format if available for cross-GPU compatibility.
         // However, Nvidia doesn't support linear, so this is a best-effort basis.
         for (auto const& f : FORMATS) {
             if (f.drmFormat == DRM_FORMAT_MOD_LINEAR) {
-                allocator->backend->log(AQ_LOG_DEBUG, "GBM: Buffer is marked as multigpu, using linear format");
+                backend->log(AQ_LOG_DEBUG, "GBM: Buffer is marked as multigpu, using linear format");
                 explicitModifiers = {DRM_FORMAT_MOD_LINEAR};
                 break;
             }
@@ -158,30 +194,107 @@ Aquamarine::CGBMBuffer::CGBMBuffer(const SAllocatorBufferParams& params, Hypruti
         // without this blitting on laptops intel/amd <-> nvidia makes eglCreateImageKHR error and
         // fallback to slow cpu copying.
 
-        allocator->backend->log(AQ_LOG_DEBUG, "GBM: Buffer is marked as multigpu, forcing linear");
+        backend->log(AQ_LOG_DEBUG, "GBM: Buffer is marked as multigpu, forcing linear");
         explicitModifiers = {DRM_FORMAT_MOD_LINEAR};
     }
 
-    uint32_t flags = GBM_BO_USE_RENDERING;
+    plan.modifiers        = std::move(explicitModifiers);
+    plan.multigpuFallback = MULTIGPU && (forceLinearBlit || negotiated);
+
+    plan.flags = GBM_BO_USE_RENDERING;
     if (params.scanout && !MULTIGPU)
-        flags |= GBM_BO_USE_SCANOUT;
+        plan.flags |= GBM_BO_USE_SCANOUT;
+
+    return true;
+}
+
+static void allocateBo(gbm_device* device, const SGBMBufferPlan& plan, SGBMAllocation& out);
+
+namespace Aquamarine {
+    // a bo allocated for a plan, not yet owned by a CGBMBuffer. Log lines are kept rather than sent, allocateBo may run off the main thread.
+    struct SGBMAllocation {
+        gbm_bo*                                               bo = nullptr;
+        SDMABUFAttrs                                          attrs{.success = false};
+        std::vector<std::pair<eBackendLogLevel, std::string>> logs;
+
+        ~SGBMAllocation() {
+            // never adopted by a buffer
+            for (size_t i = 0; attrs.success && i < (size_t)attrs.planes; ++i) {
+                close(attrs.fds.at(i));
+            }
+
+            if (bo)
+                gbm_bo_destroy(bo);
+        }
+    };
+
+    /*
+        Allocates a buffer off the main thread for CSwapchain::reconfigureAsync. The plan (and with it any multigpu negotiation)
+        is worked out on the main thread, only allocateBo() runs on the allocation thread, and the CGBMBuffer is made back on the main one.
+    */
+    class CGBMAllocationJob : public IAllocationJob {
+      public:
+        virtual void run() {
+            if (!pooled)
+                allocateBo(device, plan, allocation);
+        }
+
+        virtual SP<IBuffer> finish() {
+            if (pooled || !allocator)
+                return pooled;
+
+            auto sc = swapchain.lock();
+            if (!sc)
+                return nullptr;
+
+            auto buf = SP<CGBMBuffer>(new CGBMBuffer(plan, allocation, allocator, sc));
+            if (!buf->good()) {
+                allocator->backend->log(AQ_LOG_ERROR, std::format("Couldn't allocate a gbm buffer with size {} and format {}", plan.size, fourccToName(plan.format)));
+                return nullptr;
+            }
+
+            allocator->buffers.emplace_back(buf);
+            std::erase_if(allocator->buffers, [](const auto& b) { return b.expired(); });
+            return buf;
+        }
+
+        SGBMBufferPlan    plan;
+        gbm_device*       device = nullptr;
+        SP<CGBMAllocator> allocator; // keeps the device alive for run()
+        WP<CSwapchain>    swapchain;
+        SP<CGBMBuffer>    pooled; // nothing to allocate, the pool had one
+        SGBMAllocation    allocation;
+    };
+};
+
+static void allocateBo(gbm_device* device, const SGBMBufferPlan& plan, SGBMAllocation& out) {
+    auto& attrs = out.attrs;
+    auto  log   = [&out](eBackendLogLevel level, std::string msg) { out.logs.emplace_back(level, std::move(msg)); };
+
+    attrs.size   = plan.size;
+    attrs.format = plan.format;
+
+    const bool  CURSOR            = plan.cursor;
+    const auto& explicitModifiers = plan.modifiers;
+    uint32_t    flags             = plan.flags;
 
     uint64_t modifier = DRM_FORMAT_MOD_INVALID;
+    auto&    bo       = out.bo;
 
     if (explicitModifiers.empty()) {
-        allocator->backend->log(AQ_LOG_WARNING, "GBM: Using modifier-less allocation");
-        bo = gbm_bo_create(allocator->gbmDevice, attrs.size.x, attrs.size.y, attrs.format, flags);
+        log(AQ_LOG_WARNING, "GBM: Using modifier-less allocation");
+        bo = gbm_bo_create(device, attrs.size.x, attrs.size.y, attrs.format, flags);
     } else {
-        TRACE(allocator->backend->log(AQ_LOG_TRACE, std::format("GBM: Using modifier-based allocation, modifiers: {}", explicitModifiers.size())));
+        TRACE(log(AQ_LOG_TRACE, std::format("GBM: Using modifier-based allocation, modifiers: {}", explicitModifiers.size())));
         for (auto const& mod : explicitModifiers) {
-            TRACE(allocator->backend->log(AQ_LOG_TRACE, std::format("GBM: | mod 0x{:x} : {}", mod, drmModifierToName(mod))));
+            TRACE(log(AQ_LOG_TRACE, std::format("GBM: | mod 0x{:x} : {}", mod, drmModifierToName(mod))));
         }
-        bo = gbm_bo_create_with_modifiers2(allocator->gbmDevice, attrs.size.x, attrs.size.y, attrs.format, explicitModifiers.data(), explicitModifiers.size(), flags);
+        bo = gbm_bo_create_with_modifiers2(device, attrs.size.x, attrs.size.y, attrs.format, explicitModifiers.data(), explicitModifiers.size(), flags);
 
         if (!bo && CURSOR) {
             // allow non-renderable cursor buffer for nvidia
-            allocator->backend->log(AQ_LOG_ERROR, "GBM: Allocating with modifiers and flags failed, falling back to modifiers without flags");
-            bo = gbm_bo_create_with_modifiers(allocator->gbmDevice, attrs.size.x, attrs.size.y, attrs.format, explicitModifiers.data(), explicitModifiers.size());
+            log(AQ_LOG_ERROR, "GBM: Allocating with modifiers and flags failed, falling back to modifiers without flags");
+            bo = gbm_bo_create_with_modifiers(device, attrs.size.x, attrs.size.y, attrs.format, explicitModifiers.data(), explicitModifiers.size());
         }
 
         bool useLinear = explicitModifiers.size() == 1 && explicitModifiers[0] == DRM_FORMAT_MOD_LINEAR;
@@ -193,23 +306,24 @@ Aquamarine::CGBMBuffer::CGBMBuffer(const SAllocatorBufferParams& params, Hypruti
             if (useLinear) {
                 flags |= GBM_BO_USE_LINEAR;
                 modifier = DRM_FORMAT_MOD_LINEAR;
-                allocator->backend->log(AQ_LOG_ERROR, "GBM: Allocating with modifiers failed, falling back to modifier-less allocation");
+                log(AQ_LOG_ERROR, "GBM: Allocating with modifiers failed, falling back to modifier-less allocation");
             } else
-                allocator->backend->log(AQ_LOG_ERROR, "GBM: Allocating with modifiers failed, falling back to implicit");
-            bo = gbm_bo_create(allocator->gbmDevice, attrs.size.x, attrs.size.y, attrs.format, flags);
+                log(AQ_LOG_ERROR, "GBM: Allocating with modifiers failed, falling back to implicit");
+            bo = gbm_bo_create(device, attrs.size.x, attrs.size.y, attrs.format, flags);
         }
     }
 
-    if (MULTIGPU && forceLinearBlit) {
+    if (plan.multigpuFallback) {
         // FIXME: most likely nvidia main gpu on multigpu
         if (!bo) {
+            const auto& oldMods = plan.fallbackModifiers;
             if (oldMods.empty())
-                bo = gbm_bo_create(allocator->gbmDevice, attrs.size.x, attrs.size.y, attrs.format, GBM_BO_USE_RENDERING);
+                bo = gbm_bo_create(device, attrs.size.x, attrs.size.y, attrs.format, GBM_BO_USE_RENDERING);
             else
-                bo = gbm_bo_create_with_modifiers(allocator->gbmDevice, attrs.size.x, attrs.size.y, attrs.format, oldMods.data(), oldMods.size());
+                bo = gbm_bo_create_with_modifiers(device, attrs.size.x, attrs.size.y, attrs.format, oldMods.data(), oldMods.size());
 
             if (!bo) {
-                allocator->backend->log(AQ_LOG_ERROR, "GBM: Failed to allocate a GBM buffer: bo null");
+                log(AQ_LOG_ERROR, "GBM: Failed to allocate a GBM buffer: bo null");
                 return;
             }
 
@@ -218,7 +332,7 @@ Aquamarine::CGBMBuffer::CGBMBuffer(const SAllocatorBufferParams& params, Hypruti
     }
 
     if (!bo) {
-        allocator->backend->log(AQ_LOG_ERROR, "GBM: Failed to allocate a GBM buffer: bo null");
+        log(AQ_LOG_ERROR, "GBM: Failed to allocate a GBM buffer: bo null");
         return;
     }
 
@@ -231,7 +345,7 @@ Aquamarine::CGBMBuffer::CGBMBuffer(const SAllocatorBufferParams& params, Hypruti
         attrs.fds.at(i)     = gbm_bo_get_fd_for_plane(bo, i);
 
         if (attrs.fds.at(i) < 0) {
-            allocator->backend->log(AQ_LOG_ERROR, std::format("GBM: Failed to query fd for plane {}", i));
+            log(AQ_LOG_ERROR, std::format("GBM: Failed to query fd for plane {}", i));
             for (size_t j = 0; j < i; ++j) {
                 close(attrs.fds.at(j));
             }
@@ -242,11 +356,34 @@ Aquamarine::CGBMBuffer::CGBMBuffer(const SAllocatorBufferParams& params, Hypruti
 
     attrs.success = true;
 
-    allocator->backend->log(AQ_LOG_DEBUG,
-                            std::format("GBM: Allocated a new buffer with size {} and format {} with modifier 0x{:x} : {}", attrs.size, fourccToName(attrs.format), attrs.modifier,
-                                        drmModifierToName(attrs.modifier)));
+    log(AQ_LOG_DEBUG,
+        std::format("GBM: Allocated a new buffer with size {} and format {} with modifier 0x{:x} : {}", attrs.size, fourccToName(attrs.format), attrs.modifier,
+                    drmModifierToName(attrs.modifier)));
+}
 
-    if (params.scanout && !MULTIGPU && swapchain->backendImpl->type() == AQ_BACKEND_DRM) {
+Aquamarine::CGBMBuffer::CGBMBuffer(const SGBMBufferPlan& plan_, SGBMAllocation& allocation, Hyprutils::Memory::CWeakPointer<CGBMAllocator> allocator_,
+                                   Hyprutils::Memory::CSharedPointer<CSwapchain> swapchain) : allocator(allocator_), plan(plan_) {
+    if (!allocator)
+        return;
+
+    for (auto const& [level, msg] : allocation.logs) {
+        allocator->backend->log(level, msg);
+    }
+
+    attrs = allocation.attrs;
+    size  = plan.size;
+
+    // ours now, with or without fds
+    bo                       = allocation.bo;
+    allocation.bo            = nullptr;
+    allocation.attrs.success = false;
+
+    if (!attrs.success)
+        return;
+
+    bytes = IBuffer::allocatedBytes();
+
+    if (plan.scanout && !plan.multigpu && swapchain->backendImpl->type() == AQ_BACKEND_DRM) {
         // clear the buffer using the DRM renderer to avoid uninitialized mem
         auto impl = (CDRMBackend*)swapchain->backendImpl.get();
         if (impl->rendererState.renderer)
@@ -255,6 +392,9 @@ Aquamarine::CGBMBuffer::CGBMBuffer(const SAllocatorBufferParams& params, Hypruti
 }
 
 Aquamarine::CGBMBuffer::~CGBMBuffer() {
+    if (range.dmabufData)
+        munmap(range.dmabufData, range.dmabufLen);
+
     for (size_t i = 0; i < (size_t)attrs.planes; i++) {
         close(attrs.fds.at(i));
     }
@@ -263,6 +403,8 @@ Aquamarine::CGBMBuffer::~CGBMBuffer() {
     if (bo) {
         if (gboMapping)
             gbm_bo_unmap(bo, gboMapping); // FIXME: is it needed before destroy?
+        if (range.boMapping)
+            gbm_bo_unmap(bo, range.boMapping);
         gbm_bo_destroy(bo);
     }
 }
@@ -309,13 +451,205 @@ void Aquamarine::CGBMBuffer::endDataPtr() {
     }
 }
 
+SBufferDataRange Aquamarine::CGBMBuffer::beginDataRange(const Hyprutils::Math::CRegion& region, uint32_t access) {
+    if (range.access) {
+        allocator->backend->log(AQ_LOG_ERROR, "beginDataRange is called a second time without calling endDataRange first");
+        return {};
+    }
+
+    const auto BOX = dataRangeBox(region);
+    if (!bo || BOX.empty() || !access)
+        return {};
+
+    if (attrs.modifier == DRM_FORMAT_MOD_LINEAR && attrs.planes == 1 && !range.dmabufData && !range.dmabufFailed) {
+        range.dmabufLen  = (size_t)attrs.offsets.at(0) + (size_t)attrs.strides.at(0) * (size_t)attrs.size.y;
+        range.dmabufData = (uint8_t*)mmap(nullptr, range.dmabufLen, PROT_READ | PROT_WRITE, MAP_SHARED, attrs.fds.at(0), 0);
+        if (range.dmabufData == MAP_FAILED) {
+            TRACE(allocator->backend->log(AQ_LOG_TRACE, "GBM: dmabuf can't be mmapped, ranges go through gbm_bo_map"));
+            range.dmabufData   = nullptr;
+            range.dmabufFailed = true;
+        }
+    }
+
+    if (range.dmabufData) {
+        syncDmabuf(attrs.fds.at(0), DMA_BUF_SYNC_START | dmabufSyncAccess(access));
+        range.access = access;
+
+        // scanout bos live in vram / uncached memory on about anything that isn't an igpu
+        return {
+            .data          = range.dmabufData + attrs.offsets.at(0) + (size_t)BOX.y * attrs.strides.at(0) + (size_t)BOX.x * 4,
+            .format        = attrs.format,
+            .stride        = attrs.strides.at(0),
+            .box           = BOX,
+            .writeCombined = plan.scanout,
+        };
+    }
+
+    uint32_t flags = 0;
+    if (access & BUFFER_DATA_READ)
+        flags |= GBM_BO_TRANSFER_READ;
+    if (access & BUFFER_DATA_WRITE)
+        flags |= GBM_BO_TRANSFER_WRITE;
+
+    uint32_t stride = 0;
+    auto     data   = gbm_bo_map(bo, (uint32_t)BOX.x, (uint32_t)BOX.y, (uint32_t)BOX.w, (uint32_t)BOX.h, flags, &stride, &range.boMapping);
+    if (!data) {
+        range.boMapping = nullptr;
+        return {};
+    }
+
+    range.access = access;
+
+    return {.data = (uint8_t*)data, .format = attrs.format, .stride = stride, .box = BOX};
+}
+
+void Aquamarine::CGBMBuffer::endDataRange() {
+    if (!range.access)
+        return;
+
+    if (range.boMapping) {
+        gbm_bo_unmap(bo, range.boMapping);
+        range.boMapping = nullptr;
+    } else if (range.dmabufData)
+        syncDmabuf(attrs.fds.at(0), DMA_BUF_SYNC_END | dmabufSyncAccess(range.access));
+
+    range.access = 0;
+}
+
+size_t Aquamarine::CGBMBuffer::allocatedBytes() {
+    return bytes;
+}
+
 void CGBMAllocator::destroyBuffers() {
+    trimPool(0);
+
     for (auto& buf : buffers) {
         buf.reset();
     }
 }
 
+void Aquamarine::CGBMAllocator::recycle(SP<IBuffer> buffer) {
+    static const auto NO_POOL = envEnabled("AQ_NO_BUFFER_POOL");
+    if (NO_POOL || !buffer || !buffer->good())
+        return;
+
+    // only our own, and only if nobody else is still reading or scanning it out
+    if (buffer->locked() || buffer->lockedByBackend || std::ranges::none_of(buffers, [&buffer](const auto& b) { return b.lock() == buffer; }))
+        return;
+
+    auto gbmBuffer = reinterpretPointerCast<CGBMBuffer>(buffer);
+    if (std::ranges::any_of(pool, [&gbmBuffer](const auto& e) { return e.buffer == gbmBuffer; }))
+        return;
+
+    if (gbmBuffer->bytes > POOL_BUDGET)
+        return;
+
+    pool.emplace_back(SPooledBuffer{.buffer = gbmBuffer, .bytes = gbmBuffer->bytes, .since = std::chrono::steady_clock::now()});
+    poolBytes += gbmBuffer->bytes;
+
+    trimPool(poolLimit());
+
+    // the backend's idle timer only wakes up often enough to age the pool out once it's seen it non-empty
+    if (pool.size() == 1) {
+        if (auto b = backend.lock())
+            b->addIdleEvent(makeShared<std::function<void(void)>>([weak = self] {
+                if (auto a = weak.lock())
+                    a->trim();
+            }));
+    }
+}
+
+SP<CGBMBuffer> Aquamarine::CGBMAllocator::takeFromPool(const SGBMBufferPlan& plan) {
+    trimPool(POOL_BUDGET);
+
+    // newest first, it's the likeliest to still be warm in the consumer's caches
+    for (auto it = pool.rbegin(); it != pool.rend(); ++it) {
+        if (it->buffer->plan != plan)
+            continue;
+
+        auto buf = it->buffer;
+        poolBytes -= it->bytes;
+        pool.erase(std::next(it).base());
+        return buf;
+    }
+
+    return nullptr;
+}
+
+void Aquamarine::CGBMAllocator::trimPool(size_t limit) {
+    const auto NOW = std::chrono::steady_clock::now();
+
+    // oldest go first, either over the limit or just sitting there for too long
+    while (!pool.empty() && (poolBytes > limit || NOW - pool.front().since > POOL_MAX_AGE)) {
+        poolBytes -= pool.front().bytes;
+        pool.erase(pool.begin());
+    }
+}
+
+void Aquamarine::CGBMAllocator::trim() {
+    if (!pool.empty())
+        trimPool(poolLimit());
+}
+
+bool Aquamarine::CGBMAllocator::hasPooled() {
+    return !pool.empty();
+}
+
+size_t Aquamarine::CGBMAllocator::poolLimit() {
+    const auto BUDGET = getBudget();
+    if (!BUDGET)
+        return POOL_BUDGET;
+
+    const auto   STATS = stats();
+    const size_t USED  = STATS.bytes - STATS.pooledBytes + STATS.readbackBytes;
+    return USED >= BUDGET ? 0 : std::min(POOL_BUDGET, BUDGET - USED);
+}
+
+SAllocatorStats Aquamarine::CGBMAllocator::stats() {
+    SAllocatorStats stats;
+    for (auto const& b : buffers) {
+        auto buf = b.lock();
+        if (!buf)
+            continue;
+
+        stats.add(buf);
+
+        // mgpu blits from buffers the secondary can't import go through one of these
+        if (auto attachment = buf->attachments.get<CDRMRendererBufferInputAttachment>())
+            stats.readbackBytes += attachment->intermediateBuf.size();
+    }
+
+    stats.pooledBuffers = pool.size();
+    stats.pooledBytes   = poolBytes;
+
+    return stats;
+}
+
+bool Aquamarine::CGBMAllocator::fitsBudget(size_t bytes, size_t freed) {
+    const auto BUDGET = getBudget();
+    if (!BUDGET)
+        return true;
+
+    // the pool doesn't count, it makes way for buffers someone actually uses (see makeRoom)
+    const auto   STATS = stats();
+    const size_t USED  = STATS.bytes - STATS.pooledBytes + STATS.readbackBytes;
+    return USED + bytes <= BUDGET + freed;
+}
+
+void Aquamarine::CGBMAllocator::makeRoom(size_t bytes, size_t freed) {
+    const auto BUDGET = getBudget();
+    if (!BUDGET || pool.empty() || !fitsBudget(bytes, freed))
+        return;
+
+    const auto   STATS = stats();
+    const size_t USED  = STATS.bytes - STATS.pooledBytes + STATS.readbackBytes;
+    trimPool(BUDGET + freed - USED - bytes);
+}
+
 CGBMAllocator::~CGBMAllocator() {
+    // the pooled bos have to go before the device they're from
+    pool.clear();
+
     if (!gbmDevice)
         return;
 
@@ -367,7 +701,21 @@ SP<IBuffer> Aquamarine::CGBMAllocator::acquire(const SAllocatorBufferParams& par
         return nullptr;
     }
 
-    auto newBuffer = SP<CGBMBuffer>(new CGBMBuffer(params, self, swapchain_));
+    SGBMBufferPlan plan;
+    if (!planBuffer(params, swapchain_, plan)) {
+        backend->log(AQ_LOG_ERROR, std::format("Couldn't allocate a gbm buffer with size {} and format {}", params.size, fourccToName(params.format)));
+        return nullptr;
+    }
+
+    if (auto pooled = takeFromPool(plan)) {
+        TRACE(backend->log(AQ_LOG_TRACE, std::format("GBM: Reusing a pooled buffer with size {} and format {}", plan.size, fourccToName(plan.format))));
+        return pooled;
+    }
+
+    SGBMAllocation allocation;
+    allocateBo(gbmDevice, plan, allocation);
+
+    auto newBuffer = SP<CGBMBuffer>(new CGBMBuffer(plan, allocation, self, swapchain_));
 
     if (!newBuffer->good()) {
         backend->log(AQ_LOG_ERROR, std::format("Couldn't allocate a gbm buffer with size {} and format {}", params.size, fourccToName(params.format)));
@@ -379,6 +727,94 @@ SP<IBuffer> Aquamarine::CGBMAllocator::acquire(const SAllocatorBufferParams& par
     return newBuffer;
 }
 
+SP<IAllocationJob> Aquamarine::CGBMAllocator::prepareAcquire(const SAllocatorBufferParams& params, Hyprutils::Memory::CSharedPointer<CSwapchain> swapchain_) {
+    if (params.size.x < 1 || params.size.y < 1)
+        return nullptr;
+
+    // planning can bring up a secondary's renderer for multigpu, that stays here on the main thread
+    auto job = makeShared<CGBMAllocationJob>();
+    if (!planBuffer(params, swapchain_, job->plan))
+        return nullptr;
+
+    job->device    = gbmDevice;
+    job->allocator = self.lock();
+    job->swapchain = swapchain_;
+    job->pooled    = takeFromPool(job->plan);
+
+    return job;
+}
+
+std::optional<uint64_t> Aquamarine::CGBMAllocator::negotiateMgpuModifier(CDRMBackend* secondary, uint32_t format, const std::vector<uint64_t>& candidates) {
+    if (const auto it = secondary->mgpuModifiers.find(format); it != secondary->mgpuModifiers.end())
+        return it->second == DRM_FORMAT_MOD_LINEAR ? std::nullopt : std::optional<uint64_t>{it->second};
+
+    // the secondary renderer normally comes up with the first blit, we need it a bit earlier
+    if (!secondary->rendererState.renderer && !secondary->rendererState.cpuBlitter && !secondary->initMgpu())
+        return std::nullopt;
+
+    // a cpu blit maps our buffer, linear is what reads fastest there
+    const auto RENDERER = secondary->rendererState.renderer;
+    if (!RENDERER) {
+        secondary->mgpuModifiers[format] = DRM_FORMAT_MOD_LINEAR;
+        return std::nullopt;
+    }
+
+    // linear is what we'd do anyway, implicit ones can't be shared reliably
+    std::vector<uint64_t> mods;
+    for (auto const& m : candidates) {
+        if (m == DRM_FORMAT_MOD_LINEAR || m == DRM_FORMAT_MOD_INVALID)
+            continue;
+
+        if (std::ranges::any_of(RENDERER->formats, [format, m](const auto& f) { return f.drmFormat == format && f.modifier == m; }))
+            mods.emplace_back(m);
+    }
+
+    backend->log(AQ_LOG_DEBUG,
+                 std::format("GBM: Negotiating a multigpu modifier for {} with {}, {} candidates", fourccToName(format), secondary->gpuName, mods.size()));
+
+    // gbm picks the best one out of the list, if the secondary can't take it drop it and let gbm pick again
+    uint64_t winner = DRM_FORMAT_MOD_LINEAR;
+    while (!mods.empty()) {
+        gbm_bo* trial = gbm_bo_create_with_modifiers2(gbmDevice, 256, 256, format, mods.data(), mods.size(), GBM_BO_USE_RENDERING);
+        if (!trial)
+            break;
+
+        SDMABUFAttrs trialAttrs{.success = true, .size = {256, 256}, .format = format, .modifier = gbm_bo_get_modifier(trial), .planes = gbm_bo_get_plane_count(trial)};
+
+        bool         ok = true;
+        for (size_t i = 0; i < (size_t)trialAttrs.planes; ++i) {
+            trialAttrs.strides.at(i) = gbm_bo_get_stride_for_plane(trial, i);
+            trialAttrs.offsets.at(i) = gbm_bo_get_offset(trial, i);
+            trialAttrs.fds.at(i)     = gbm_bo_get_fd_for_plane(trial, i);
+            ok                       = ok && trialAttrs.fds.at(i) >= 0;
+        }
+
+        ok = ok && RENDERER->canImport(trialAttrs);
+
+        for (size_t i = 0; i < (size_t)trialAttrs.planes; ++i) {
+            if (trialAttrs.fds.at(i) >= 0)
+                close(trialAttrs.fds.at(i));
+        }
+        gbm_bo_destroy(trial);
+
+        if (ok) {
+            winner = trialAttrs.modifier;
+            break;
+        }
+
+        TRACE(backend->log(AQ_LOG_TRACE, std::format("GBM: Secondary can't import modifier 0x{:x} : {}", trialAttrs.modifier, drmModifierToName(trialAttrs.modifier))));
+
+        if (std::erase(mods, trialAttrs.modifier) == 0)
+            break;
+    }
+
+    secondary->mgpuModifiers[format] = winner;
+
+    backend->log(AQ_LOG_DEBUG, std::format("GBM: Multigpu modifier for {} with {} is 0x{:x} : {}", fourccToName(format), secondary->gpuName, winner, drmModifierToName(winner)));
+
+    return winner == DRM_FORMAT_MOD_LINEAR ? std::nullopt : std::optional<uint64_t>{winner};
+}
+
 Hyprutils::Memory::CSharedPointer<CBackend> Aquamarine::CGBMAllocator::getBackend() {
     return backend.lock();
 }
@@ -0,0 +1,197 @@
+#include <aquamarine/allocator/SHM.hpp>
+#include <aquamarine/backend/Backend.hpp>
+#include <aquamarine/allocator/Swapchain.hpp>
+#include "FormatUtils.hpp"
+#include "Shared.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace Aquamarine;
+using namespace Hyprutils::Memory;
+#define SP CSharedPointer
+#define WP CWeakPointer
+
+// the default huge page size basically everywhere. If it isn't, hugetlb fails and we fall back.
+constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+Aquamarine::CSHMBuffer::CSHMBuffer(const SAllocatorBufferParams& params, Hyprutils::Memory::CWeakPointer<CSHMAllocator> allocator_,
+                                   Hyprutils::Memory::CSharedPointer<CSwapchain> swapchain) : allocator(allocator_) {
+    attrs.format = params.format;
+    if (attrs.format == DRM_FORMAT_INVALID)
+        attrs.format = params.scanout && !params.cursor ? DRM_FORMAT_XRGB8888 : DRM_FORMAT_ARGB8888;
+
+    if (!CSHMAllocator::supportsFormat(attrs.format)) {
+        allocator->backend->log(AQ_LOG_ERROR, std::format("SHM: Cannot allocate a buffer with format {}", fourccToName(attrs.format)));
+        return;
+    }
+
+    attrs.size   = params.size;
+    attrs.stride = alignUp((size_t)params.size.x * 4, STRIDE_ALIGN);
+    size         = attrs.size;
+
+    const size_t      IMAGE_LEN = (size_t)attrs.stride * (size_t)params.size.y;
+
+    static const auto HUGETLB = envEnabled("AQ_SHM_HUGETLB");
+    static const auto NO_THP  = envEnabled("AQ_SHM_NO_THP");
+    const bool        BIG     = IMAGE_LEN >= HUGE_PAGE_SIZE;
+
+    // hugetlb needs pages reserved by the admin, and can run out of them. mmap is where that shows, the memfd
+    // itself is created fine either way. A normal memfd still works then.
+    if (HUGETLB && BIG) {
+        bufferLen = alignUp(IMAGE_LEN, HUGE_PAGE_SIZE);
+        attrs.fd  = createSealedMemfd("aquamarine-shm", bufferLen, true);
+        if (attrs.fd >= 0) {
+            data = (uint8_t*)mmap(nullptr, bufferLen, PROT_READ | PROT_WRITE, MAP_SHARED, attrs.fd, 0);
+            if (data == MAP_FAILED) {
+                data = nullptr;
+                close(attrs.fd);
+                attrs.fd = -1;
+            }
+        }
+
+        hugetlb = data != nullptr;
+        if (!hugetlb)
+            allocator->backend->log(AQ_LOG_DEBUG, std::format("SHM: hugetlb allocation of {} bytes failed, falling back", bufferLen));
+    }
+
+    if (!hugetlb) {
+        bufferLen = IMAGE_LEN;
+        attrs.fd  = createSealedMemfd("aquamarine-shm", bufferLen, false);
+
+        if (attrs.fd < 0) {
+            allocator->backend->log(AQ_LOG_ERROR, std::format("SHM: Failed to create a memfd: {}", strerror(errno)));
+            return;
+        }
+
+        data = (uint8_t*)mmap(nullptr, bufferLen, PROT_READ | PROT_WRITE, MAP_SHARED, attrs.fd, 0);
+        if (data == MAP_FAILED) {
+            allocator->backend->log(AQ_LOG_ERROR, "SHM: Failed to mmap a memfd");
+            data = nullptr;
+            return;
+        }
+    }
+
+    // only a hint, with shmem_enabled=never this is a no-op
+    if (!hugetlb && BIG && !NO_THP)
+        madvise(data, bufferLen, MADV_HUGEPAGE);
+
+    attrs.success = true;
+
+    allocator->backend->log(AQ_LOG_DEBUG,
+                            std::format("SHM: Allocated a new buffer with fd {}, size {}, format {}{}", attrs.fd, attrs.size, fourccToName(attrs.format), hugetlb ? ", hugetlb" : ""));
+}
+
+Aquamarine::CSHMBuffer::~CSHMBuffer() {
+    events.destroy.emit();
+
+    if (data)
+        munmap(data, bufferLen);
+
+    if (attrs.fd >= 0)
+        close(attrs.fd);
+}
+
+eBufferCapability Aquamarine::CSHMBuffer::caps() {
+    return eBufferCapability::BUFFER_CAPABILITY_DATAPTR;
+}
+
+eBufferType Aquamarine::CSHMBuffer::type() {
+    return eBufferType::BUFFER_TYPE_SHM;
+}
+
+void Aquamarine::CSHMBuffer::update(const Hyprutils::Math::CRegion& damage) {
+    ; // nothing to do
+}
+
+bool Aquamarine::CSHMBuffer::isSynchronous() {
+    return true;
+}
+
+bool Aquamarine::CSHMBuffer::good() {
+    return attrs.success && data;
+}
+
+SSHMAttrs Aquamarine::CSHMBuffer::shm() {
+    return attrs;
+}
+
+std::tuple<uint8_t*, uint32_t, size_t> Aquamarine::CSHMBuffer::beginDataPtr(uint32_t flags) {
+    return {data, attrs.format, (size_t)attrs.stride * (size_t)attrs.size.y};
+}
+
+void Aquamarine::CSHMBuffer::endDataPtr() {
+    ; // nothing to do
+}
+
+size_t Aquamarine::CSHMBuffer::allocatedBytes() {
+    return good() ? bufferLen : 0;
+}
+
+Aquamarine::CSHMAllocator::~CSHMAllocator() {
+    ; // nothing to do
+}
+
+SP<CSHMAllocator> Aquamarine::CSHMAllocator::create(Hyprutils::Memory::CWeakPointer<CBackend> backend_) {
+    auto a  = SP<CSHMAllocator>(new CSHMAllocator(backend_));
+    a->self = a;
+
+    backend_->log(AQ_LOG_DEBUG, "SHM: created a shm allocator");
+
+    return a;
+}
+
+SP<IBuffer> Aquamarine::CSHMAllocator::acquire(const SAllocatorBufferParams& params, SP<CSwapchain> swapchain_) {
+    if (params.size.x < 1 || params.size.y < 1) {
+        backend->log(AQ_LOG_ERROR, std::format("SHM: Couldn't allocate a buffer with invalid size {}", params.size));
+        return nullptr;
+    }
+
+    auto buf = SP<CSHMBuffer>(new CSHMBuffer(params, self, swapchain_));
+    if (!buf->good())
+        return nullptr;
+
+    buffers.emplace_back(buf);
+    std::erase_if(buffers, [](const auto& b) { return b.expired(); });
+    return buf;
+}
+
+SP<CBackend> Aquamarine::CSHMAllocator::getBackend() {
+    return backend.lock();
+}
+
+int Aquamarine::CSHMAllocator::drmFD() {
+    return -1;
+}
+
+eAllocatorType Aquamarine::CSHMAllocator::type() {
+    return eAllocatorType::AQ_ALLOCATOR_TYPE_SHM;
+}
+
+SAllocatorStats Aquamarine::CSHMAllocator::stats() {
+    SAllocatorStats stats;
+    for (auto const& b : buffers) {
+        stats.add(b.lock());
+    }
+    return stats;
+}
+
+bool Aquamarine::CSHMAllocator::supportsFormat(uint32_t format) {
+    switch (format) {
+        case DRM_FORMAT_ARGB8888:
+        case DRM_FORMAT_XRGB8888:
+        case DRM_FORMAT_ABGR8888:
+        case DRM_FORMAT_XBGR8888:
+        case DRM_FORMAT_ARGB2101010:
+        case DRM_FORMAT_XRGB2101010:
+        case DRM_FORMAT_ABGR2101010:
+        case DRM_FORMAT_XBGR2101010: return true;
+        default: return false;
+    }
+}
+
+Aquamarine::CSHMAllocator::CSHMAllocator(Hyprutils::Memory::CWeakPointer<CBackend> backend_) : backend(backend_) {
+    ; // nothing to do
+}
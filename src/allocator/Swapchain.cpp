@@ -2,12 +2,27 @@
 #include <aquamarine/allocator/Swapchain.hpp>
 #include <aquamarine/backend/Backend.hpp>
 #include "FormatUtils.hpp"
+#include "Shared.hpp"
+#include "AllocationThread.hpp"
+#include <hyprutils/utils/ScopeGuard.hpp>
+#include <optional>
+#include <utility>
 
 using namespace Aquamarine;
 using namespace Hyprutils::Memory;
 using namespace Hyprutils::Math;
 #define SP CSharedPointer
 
+// how many buffers past options.length we grow to when all of them are still held
+constexpr size_t MAX_EXTRA_BUFFERS = 2;
+// acquisitions with a buffer to spare before dropping an extra one again
+constexpr size_t SHRINK_AFTER_ACQUISITIONS = 120;
+
+// the consumer still reads or draws it, or it's on screen / not released by the host yet
+static bool isBusy(SP<IBuffer> buffer) {
+    return buffer->locked() || buffer->lockedByBackend;
+}
+
 SP<CSwapchain> Aquamarine::CSwapchain::create(SP<IAllocator> allocator_, SP<IBackendImplementation> backendImpl_) {
     auto p  = SP<CSwapchain>(new CSwapchain(allocator_, backendImpl_));
     p->self = p;
@@ -19,21 +34,40 @@ Aquamarine::CSwapchain::CSwapchain(SP<IAllocator> allocator_, SP<IBackendImpleme
         return;
 }
 
+Aquamarine::CSwapchain::~CSwapchain() {
+    if (!allocator)
+        return;
+
+    for (auto const& b : buffers) {
+        allocator->recycle(b);
+    }
+}
+
 bool Aquamarine::CSwapchain::reconfigure(const SSwapchainOptions& options_) {
     if (!allocator)
         return false;
 
     if (options_.size == Vector2D{} || options_.length == 0) {
         // clear the swapchain
+        cancelPendingReconfigure();
         allocator->getBackend()->log(AQ_LOG_DEBUG, "Swapchain: Clearing");
+        for (auto const& b : buffers) {
+            allocator->recycle(b);
+        }
         buffers.clear();
+        presentedOn.clear();
         options = options_;
         return true;
     }
 
     if ((options_.format == options.format || options_.format == DRM_FORMAT_INVALID) && options_.size == options.size && options_.length == options.length &&
-        buffers.size() == options.length)
-        return true; // no need to reconfigure
+        buffers.size() >= options.length && buffers.size() <= options.length + MAX_EXTRA_BUFFERS) {
+        cancelPendingReconfigure(); // staying with these wins over what's being allocated
+        return true;                // no need to reconfigure, extra buffers from next() are fine
+    }
+
+    // what's being allocated in the background is out of date now
+    cancelPendingReconfigure();
 
     if ((options_.format == options.format || options_.format == DRM_FORMAT_INVALID) && options_.size == options.size) {
         bool ok = resize(options_.length);
@@ -52,21 +86,186 @@ bool Aquamarine::CSwapchain::reconfigure(const SSwapchainOptions& options_) {
 
     options = options_;
     if (options.format == DRM_FORMAT_INVALID)
-        options.format = buffers.at(0)->dmabuf().format;
+        options.format = buffers.at(0)->type() == BUFFER_TYPE_SHM ? buffers.at(0)->shm().format : buffers.at(0)->dmabuf().format;
 
     allocator->getBackend()->log(AQ_LOG_DEBUG,
                                  std::format("Swapchain: Reconfigured a swapchain to {} {} of length {}", options.size, fourccToName(options.format), options.length));
     return true;
 }
 
+void Aquamarine::CSwapchain::reconfigureAsync(const SSwapchainOptions& options_, std::function<void(bool)> done) {
+    const bool CLEAR        = options_.size == Vector2D{} || options_.length == 0;
+    const bool SAME_BUFFERS = (options_.format == options.format || options_.format == DRM_FORMAT_INVALID) && options_.size == options.size;
+
+    // already on the way, e.g. a backend asking again every frame until it's there
+    if (async.pending && !CLEAR && options_.format == async.options.format && options_.size == async.options.size && options_.length == async.options.length) {
+        if (done)
+            async.done = [first = std::move(async.done), done = std::move(done)](bool ok) {
+                if (first)
+                    first(ok);
+                done(ok);
+            };
+        return;
+    }
+
+    // only a new generation is worth a thread, the rest is a couple buffers at most
+    std::vector<SP<IAllocationJob>> jobs;
+    if (allocator && !CLEAR && !SAME_BUFFERS) {
+        for (size_t i = 0; i < options_.length; ++i) {
+            auto job = allocator->prepareAcquire(
+                SAllocatorBufferParams{.size = options_.size, .format = options_.format, .scanout = options_.scanout, .cursor = options_.cursor, .multigpu = options_.multigpu},
+                self.lock());
+            if (!job) {
+                jobs.clear();
+                break;
+            }
+            jobs.emplace_back(job);
+        }
+    }
+
+    const auto THREAD = jobs.empty() ? SP<CAllocationThread>{} : allocator->getBackend()->getAllocationThread();
+    if (!THREAD) {
+        const bool OK = reconfigure(options_);
+        if (done)
+            done(OK);
+        return;
+    }
+
+    cancelPendingReconfigure();
+
+    async.pending = true;
+    async.done    = std::move(done);
+    async.options = options_;
+
+    const auto GENERATION = ++async.generation;
+
+    std::vector<IAllocationJob*> work;
+    for (auto const& j : jobs) {
+        work.emplace_back(j.get());
+    }
+
+    THREAD->submit(std::move(work), [weak = self, jobs, options_, GENERATION] {
+        if (auto swapchain = weak.lock())
+            swapchain->finishReconfigure(jobs, options_, GENERATION);
+    });
+
+    allocator->getBackend()->log(AQ_LOG_DEBUG, std::format("Swapchain: Allocating {} {} of length {} in the background", options_.size, fourccToName(options_.format),
+                                                           options_.length));
+}
+
+bool Aquamarine::CSwapchain::reconfigurePending() {
+    return async.pending;
+}
+
+void Aquamarine::CSwapchain::finishReconfigure(const std::vector<SP<IAllocationJob>>& jobs, const SSwapchainOptions& options_, uint64_t generation) {
+    std::vector<SP<IBuffer>> bfs;
+    bool                     ok = true;
+    for (auto const& j : jobs) {
+        if (auto buf = j->finish())
+            bfs.emplace_back(buf);
+        else
+            ok = false;
+    }
+
+    if (!async.pending || generation != async.generation) {
+        // something else came in the meantime, the allocator may still find a use for these
+        for (auto const& b : bfs) {
+            allocator->recycle(b);
+        }
+        return;
+    }
+
+    async.pending = false;
+    auto done     = std::move(async.done);
+    async.done    = nullptr;
+
+    // the new ones are already counted, the current ones go away in exchange
+    const bool FITS = ok && allocator->fitsBudget(0, stats().bytes);
+    if (FITS)
+        allocator->makeRoom(0, stats().bytes);
+    if (!FITS) {
+        allocator->getBackend()->log(AQ_LOG_ERROR, ok ? "Swapchain: The buffers allocated in the background go over the allocator's budget" :
+                                                        "Swapchain: Failed acquiring a buffer in the background");
+        for (auto const& b : bfs) {
+            allocator->recycle(b);
+        }
+
+        if (done)
+            done(false);
+        return;
+    }
+
+    replaceBuffers(std::move(bfs));
+
+    options = options_;
+    if (options.format == DRM_FORMAT_INVALID)
+        options.format = buffers.at(0)->type() == BUFFER_TYPE_SHM ? buffers.at(0)->shm().format : buffers.at(0)->dmabuf().format;
+
+    allocator->getBackend()->log(AQ_LOG_DEBUG,
+                                 std::format("Swapchain: Reconfigured a swapchain to {} {} of length {}", options.size, fourccToName(options.format), options.length));
+
+    if (done)
+        done(true);
+}
+
+void Aquamarine::CSwapchain::cancelPendingReconfigure() {
+    if (!async.pending)
+        return;
+
+    // whatever it still brings in gets dropped
+    async.pending = false;
+    async.generation++;
+
+    auto done  = std::move(async.done);
+    async.done = nullptr;
+    if (done)
+        done(false);
+}
+
 SP<IBuffer> Aquamarine::CSwapchain::next(int* age) {
-    if (!allocator || options.length <= 0)
+    if (!allocator || options.length <= 0 || buffers.empty())
         return nullptr;
 
-    lastAcquired = (lastAcquired + 1) % options.length;
+    // over the allocator's budget the extra ones go right away, not once it's quiet
+    if (buffers.size() > options.length && (quietAcquisitions >= SHRINK_AFTER_ACQUISITIONS || !allocator->fitsBudget(0)))
+        shrink();
+
+    previousAcquired = lastAcquired;
+
+    // the next one in line that nobody's holding anymore
+    std::optional<size_t> picked;
+    size_t                busy = 0;
+    for (size_t i = 1; i <= buffers.size(); ++i) {
+        const size_t IDX = (lastAcquired + i) % buffers.size();
+        if (isBusy(buffers.at(IDX)))
+            busy++;
+        else if (!picked)
+            picked = IDX;
+    }
+
+    if (!picked) {
+        // everything's still out, the gpu or the host is running behind. Better another buffer than drawing into one in use
+        if (buffers.size() < options.length + MAX_EXTRA_BUFFERS && allocator->fitsBudget(buffers.at(0)->allocatedBytes()) && resize(buffers.size() + 1)) {
+            allocator->getBackend()->log(AQ_LOG_DEBUG, std::format("Swapchain: all buffers busy, grew to {}", buffers.size()));
+            picked = buffers.size() - 1;
+        } else {
+            TRACE(allocator->getBackend()->log(AQ_LOG_TRACE, "Swapchain: all buffers busy, reusing one anyways"));
+            picked = (lastAcquired + 1) % buffers.size();
+        }
+    }
+
+    // quiet as long as there's one to spare besides the one we hand out
+    if (busy + 1 < buffers.size())
+        quietAcquisitions++;
+    else
+        quietAcquisitions = 0;
+
+    lastAcquired = *picked;
 
-    if (age)
-        *age = options.length; // we always just rotate
+    if (age) {
+        const auto ON = presentedOn.at(lastAcquired);
+        *age          = ON == 0 ? 0 : (int)std::min<uint64_t>(presentations - ON + 1, INT32_MAX);
+    }
 
     return buffers.at(lastAcquired);
 }
@@ -83,26 +282,59 @@ bool Aquamarine::CSwapchain::fullReconfigure(const SSwapchainOptions& options_)
             allocator->getBackend()->log(AQ_LOG_ERROR, "Swapchain: Failed acquiring a buffer");
             return false;
         }
+
+        // the rest come out the same size, and the old ones go away in exchange. Don't allocate them all to find out.
+        if (i == 0 && !allocator->fitsBudget(buf->allocatedBytes() * (options_.length - 1), stats().bytes)) {
+            allocator->getBackend()->log(AQ_LOG_ERROR, std::format("Swapchain: {} buffers of {} would go over the allocator's budget", options_.length, options_.size));
+            return false;
+        }
+
+        if (i == 0)
+            allocator->makeRoom(buf->allocatedBytes() * (options_.length - 1), stats().bytes);
+
         allocator->getBackend()->log(AQ_LOG_TRACE,
                                      std::format("Swapchain: Acquired a buffer with format {} and modifier 0x{:x} : {}", fourccToName(buf->dmabuf().format), buf->dmabuf().modifier,
                                                  drmModifierToName(buf->dmabuf().modifier)));
         bfs.emplace_back(buf);
     }
 
-    buffers = std::move(bfs);
+    replaceBuffers(std::move(bfs));
 
     return true;
 }
 
+void Aquamarine::CSwapchain::replaceBuffers(std::vector<SP<IBuffer>>&& bfs) {
+    for (auto const& b : buffers) {
+        allocator->recycle(b);
+    }
+
+    buffers = std::move(bfs);
+    presentedOn.assign(buffers.size(), 0);
+    quietAcquisitions = 0;
+}
+
 bool Aquamarine::CSwapchain::resize(size_t newSize) {
     if (newSize == buffers.size())
         return true;
 
+    // the kept buffers keep their ages, new ones start out unknown
+    Hyprutils::Utils::CScopeGuard x([this] { presentedOn.resize(buffers.size(), 0); });
+
     if (newSize < buffers.size()) {
         while (buffers.size() > newSize) {
+            allocator->recycle(buffers.back());
             buffers.pop_back();
         }
     } else {
+        // they're all the same size
+        const size_t BYTES = buffers.empty() ? 0 : buffers.at(0)->allocatedBytes();
+        if (!allocator->fitsBudget(BYTES * (newSize - buffers.size()))) {
+            allocator->getBackend()->log(AQ_LOG_ERROR, std::format("Swapchain: Growing to {} buffers would go over the allocator's budget", newSize));
+            return false;
+        }
+
+        allocator->makeRoom(BYTES * (newSize - buffers.size()));
+
         while (buffers.size() < newSize) {
             auto buf = allocator->acquire(
                 SAllocatorBufferParams{.size = options.size, .format = options.format, .scanout = options.scanout, .cursor = options.cursor, .multigpu = options.multigpu},
@@ -127,11 +359,60 @@ const SSwapchainOptions& Aquamarine::CSwapchain::currentOptions() {
 }
 
 void Aquamarine::CSwapchain::rollback() {
-    lastAcquired--;
-    if (lastAcquired < 0)
-        lastAcquired = options.length - 1;
+    // whatever was drawn into it never made it out, so what it holds matches no frame anymore
+    if (lastAcquired >= 0 && std::cmp_less(lastAcquired, presentedOn.size()))
+        presentedOn.at(lastAcquired) = 0;
+
+    // next() may have skipped busy ones, so go back to where it started rather than one step
+    lastAcquired = previousAcquired;
+}
+
+void Aquamarine::CSwapchain::shrink() {
+    // drop the free one that's been off screen the longest, never the one just handed out
+    std::optional<size_t> victim;
+    for (size_t i = 0; i < buffers.size(); ++i) {
+        if (std::cmp_equal(i, lastAcquired) || isBusy(buffers.at(i)))
+            continue;
+
+        if (!victim || presentedOn.at(i) < presentedOn.at(*victim))
+            victim = i;
+    }
+
+    quietAcquisitions = 0;
+
+    if (!victim)
+        return;
+
+    allocator->recycle(buffers.at(*victim));
+    buffers.erase(buffers.begin() + *victim);
+    presentedOn.erase(presentedOn.begin() + *victim);
+
+    // keep the rotation where it was
+    if (std::cmp_less(*victim, lastAcquired))
+        lastAcquired--;
+
+    allocator->getBackend()->log(AQ_LOG_DEBUG, std::format("Swapchain: shrank back to {}", buffers.size()));
+}
+
+void Aquamarine::CSwapchain::presented(SP<IBuffer> buffer) {
+    if (!buffer)
+        return;
+
+    const auto IT = std::ranges::find(buffers, buffer);
+    if (IT == buffers.end())
+        return;
+
+    presentedOn.at(IT - buffers.begin()) = ++presentations;
 }
 
 SP<IAllocator> Aquamarine::CSwapchain::getAllocator() {
     return allocator;
 }
+
+SAllocatorStats Aquamarine::CSwapchain::stats() {
+    SAllocatorStats stats;
+    for (auto const& b : buffers) {
+        stats.add(b);
+    }
+    return stats;
+}
@@ -0,0 +1,180 @@
+#include <aquamarine/allocator/Udmabuf.hpp>
+#include <aquamarine/allocator/SHM.hpp>
+#include <aquamarine/backend/Backend.hpp>
+#include <aquamarine/allocator/Swapchain.hpp>
+#include "FormatUtils.hpp"
+#include "Shared.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/dma-buf.h>
+#include <linux/udmabuf.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace Aquamarine;
+using namespace Hyprutils::Memory;
+#define SP CSharedPointer
+#define WP CWeakPointer
+
+Aquamarine::CUdmabufBuffer::CUdmabufBuffer(const SAllocatorBufferParams& params, Hyprutils::Memory::CWeakPointer<CUdmabufAllocator> allocator_,
+                                           Hyprutils::Memory::CSharedPointer<CSwapchain> swapchain) : allocator(allocator_) {
+    attrs.format = params.format;
+    if (attrs.format == DRM_FORMAT_INVALID)
+        attrs.format = params.scanout && !params.cursor ? DRM_FORMAT_XRGB8888 : DRM_FORMAT_ARGB8888;
+
+    // udmabuf doesn't care what's in the pages, but the layout here is one 32bpp plane
+    if (!CSHMAllocator::supportsFormat(attrs.format)) {
+        allocator->backend->log(AQ_LOG_ERROR, std::format("udmabuf: Cannot allocate a buffer with format {}", fourccToName(attrs.format)));
+        return;
+    }
+
+    attrs.size          = params.size;
+    attrs.modifier      = DRM_FORMAT_MOD_LINEAR;
+    attrs.planes        = 1;
+    attrs.strides.at(0) = alignUp((size_t)params.size.x * 4, STRIDE_ALIGN);
+    size                = attrs.size;
+
+    // udmabuf only takes whole pages, and needs the memfd sealed against shrinking
+    bufferLen = alignUp((size_t)attrs.strides.at(0) * (size_t)params.size.y, sysconf(_SC_PAGESIZE));
+    memfd     = createSealedMemfd("aquamarine-udmabuf", bufferLen);
+    if (memfd < 0) {
+        allocator->backend->log(AQ_LOG_ERROR, std::format("udmabuf: Failed to create a memfd: {}", strerror(errno)));
+        return;
+    }
+
+    udmabuf_create create = {.memfd = (uint32_t)memfd, .flags = UDMABUF_FLAGS_CLOEXEC, .offset = 0, .size = bufferLen};
+    attrs.fds.at(0)       = ioctl(allocator->udmabufFD, UDMABUF_CREATE, &create);
+    if (attrs.fds.at(0) < 0) {
+        // most likely over /sys/module/udmabuf/parameters/size_limit_mb
+        allocator->backend->log(AQ_LOG_ERROR, std::format("udmabuf: UDMABUF_CREATE of {} bytes failed: {}", bufferLen, strerror(errno)));
+        return;
+    }
+
+    // map the memfd, not the dmabuf, the exporter doesn't need to be in the loop for every page fault
+    data = (uint8_t*)mmap(nullptr, bufferLen, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    if (data == MAP_FAILED) {
+        allocator->backend->log(AQ_LOG_ERROR, "udmabuf: Failed to mmap a memfd");
+        data = nullptr;
+        return;
+    }
+
+    attrs.success = true;
+
+    allocator->backend->log(AQ_LOG_DEBUG,
+                            std::format("udmabuf: Allocated a new buffer with fd {}, size {} and format {}", attrs.fds.at(0), attrs.size, fourccToName(attrs.format)));
+}
+
+Aquamarine::CUdmabufBuffer::~CUdmabufBuffer() {
+    events.destroy.emit();
+
+    TRACE(allocator->backend->log(AQ_LOG_TRACE, std::format("udmabuf: dropping buffer {}", attrs.fds.at(0))));
+
+    if (data)
+        munmap(data, bufferLen);
+
+    if (attrs.fds.at(0) >= 0)
+        close(attrs.fds.at(0));
+
+    if (memfd >= 0)
+        close(memfd);
+}
+
+eBufferCapability Aquamarine::CUdmabufBuffer::caps() {
+    return eBufferCapability::BUFFER_CAPABILITY_DATAPTR;
+}
+
+eBufferType Aquamarine::CUdmabufBuffer::type() {
+    return eBufferType::BUFFER_TYPE_DMABUF;
+}
+
+void Aquamarine::CUdmabufBuffer::update(const Hyprutils::Math::CRegion& damage) {
+    ; // nothing to do
+}
+
+bool Aquamarine::CUdmabufBuffer::isSynchronous() {
+    return true;
+}
+
+bool Aquamarine::CUdmabufBuffer::good() {
+    return attrs.success && data;
+}
+
+SDMABUFAttrs Aquamarine::CUdmabufBuffer::dmabuf() {
+    return attrs;
+}
+
+std::tuple<uint8_t*, uint32_t, size_t> Aquamarine::CUdmabufBuffer::beginDataPtr(uint32_t flags) {
+    // whoever imported it may have its own mapping, make the cpu side coherent with it
+    syncDmabuf(attrs.fds.at(0), DMA_BUF_SYNC_START | DMA_BUF_SYNC_RW);
+    return {data, attrs.format, (size_t)attrs.strides.at(0) * (size_t)attrs.size.y};
+}
+
+void Aquamarine::CUdmabufBuffer::endDataPtr() {
+    syncDmabuf(attrs.fds.at(0), DMA_BUF_SYNC_END | DMA_BUF_SYNC_RW);
+}
+
+size_t Aquamarine::CUdmabufBuffer::allocatedBytes() {
+    return good() ? bufferLen : 0;
+}
+
+Aquamarine::CUdmabufAllocator::~CUdmabufAllocator() {
+    if (udmabufFD >= 0)
+        close(udmabufFD);
+}
+
+SP<CUdmabufAllocator> Aquamarine::CUdmabufAllocator::create(Hyprutils::Memory::CWeakPointer<CBackend> backend_) {
+    int fd = open("/dev/udmabuf", O_RDWR | O_CLOEXEC);
+    if (fd < 0) {
+        backend_->log(AQ_LOG_DEBUG, std::format("udmabuf: Cannot open /dev/udmabuf: {}", strerror(errno)));
+        return nullptr;
+    }
+
+    auto a  = SP<CUdmabufAllocator>(new CUdmabufAllocator(fd, backend_));
+    a->self = a;
+
+    backend_->log(AQ_LOG_DEBUG, "udmabuf: created a udmabuf allocator");
+
+    return a;
+}
+
+SP<IBuffer> Aquamarine::CUdmabufAllocator::acquire(const SAllocatorBufferParams& params, SP<CSwapchain> swapchain_) {
+    if (params.size.x < 1 || params.size.y < 1) {
+        backend->log(AQ_LOG_ERROR, std::format("udmabuf: Couldn't allocate a buffer with invalid size {}", params.size));
+        return nullptr;
+    }
+
+    auto buf = SP<CUdmabufBuffer>(new CUdmabufBuffer(params, self, swapchain_));
+    if (!buf->good())
+        return nullptr;
+
+    buffers.emplace_back(buf);
+    std::erase_if(buffers, [](const auto& b) { return b.expired(); });
+    return buf;
+}
+
+SP<CBackend> Aquamarine::CUdmabufAllocator::getBackend() {
+    return backend.lock();
+}
+
+int Aquamarine::CUdmabufAllocator::drmFD() {
+    return -1;
+}
+
+eAllocatorType Aquamarine::CUdmabufAllocator::type() {
+    return eAllocatorType::AQ_ALLOCATOR_TYPE_UDMABUF;
+}
+
+SAllocatorStats Aquamarine::CUdmabufAllocator::stats() {
+    SAllocatorStats stats;
+    for (auto const& b : buffers) {
+        stats.add(b.lock());
+    }
+    return stats;
+}
+
+Aquamarine::CUdmabufAllocator::CUdmabufAllocator(int fd_, Hyprutils::Memory::CWeakPointer<CBackend> backend_) : backend(backend_), udmabufFD(fd_) {
+    ; // nothing to do
+}
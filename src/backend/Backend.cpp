@@ -4,6 +4,8 @@
 #include <aquamarine/backend/DRM.hpp>
 #include <aquamarine/backend/Null.hpp>
 #include <aquamarine/allocator/GBM.hpp>
+#include <aquamarine/allocator/SHM.hpp>
+#include <aquamarine/allocator/Udmabuf.hpp>
 #include <hyprutils/os/FileDescriptor.hpp>
 #include <ranges>
 #include <sys/timerfd.h>
@@ -14,6 +16,7 @@
 #include <unistd.h>
 
 #include "Logger.hpp"
+#include "../allocator/AllocationThread.hpp"
 
 using namespace Hyprutils::Memory;
 using namespace Hyprutils::OS;
@@ -113,6 +116,9 @@ Aquamarine::CBackend::~CBackend() {
     if (idle.fd >= 0)
         close(idle.fd);
 
+    // pending allocations hold on to allocators, which hold on to implementations
+    allocationThread.reset();
+
     // Tear down implementations before the logger is destroyed,
     // as backends may log during teardown (e.g. SDRMConnector::disconnect).
     implementations.clear();
@@ -159,7 +165,7 @@ bool Aquamarine::CBackend::start() {
         return failed;
     });
 
-    // TODO: obviously change this when (if) we add different allocators.
+    // gbm off the first implementation with a gpu, without one udmabuf or shm below
     for (auto const& b : implementations) {
         if (b->drmFD() >= 0) {
             auto fd = reopenDRMNode(b->drmFD());
@@ -173,6 +179,20 @@ bool Aquamarine::CBackend::start() {
         }
     }
 
+    // no gpu to allocate from, e.g. headless on a machine without one. udmabuf still gives out dmabufs the wayland host or vkms can import,
+    // plain memory at least gets a consumer with a software renderer going.
+    if (!primaryAllocator && !implementations.empty() && implementations.at(0)->type() != AQ_BACKEND_NULL) {
+        if (!envEnabled("AQ_NO_UDMABUF"))
+            primaryAllocator = CUdmabufAllocator::create(self);
+
+        if (primaryAllocator)
+            log(AQ_LOG_WARNING, "No DRM device to allocate from, falling back to a udmabuf allocator");
+        else {
+            log(AQ_LOG_WARNING, "No DRM device to allocate from, falling back to a shm allocator");
+            primaryAllocator = CSHMAllocator::create(self);
+        }
+    }
+
     if (!primaryAllocator && (implementations.empty() || implementations.at(0)->type() != AQ_BACKEND_NULL)) {
         log(AQ_LOG_CRITICAL, "Cannot open backend: no allocator available");
         return false;
@@ -211,12 +231,32 @@ std::vector<Hyprutils::Memory::CSharedPointer<SPollFD>> Aquamarine::CBackend::ge
         result.emplace_back(sfd);
     }
 
+    if (allocationThread) {
+        log(AQ_LOG_DEBUG, std::format("backend: poll fd {} for allocations", allocationThread->eventFD()));
+        result.emplace_back(makeShared<SPollFD>(allocationThread->eventFD(), [this]() { allocationThread->dispatch(); }));
+    }
+
     log(AQ_LOG_DEBUG, std::format("backend: poll fd {} for idle", idle.fd));
     result.emplace_back(makeShared<SPollFD>(idle.fd, [this]() { dispatchIdle(); }));
 
     return result;
 }
 
+SP<CAllocationThread> Aquamarine::CBackend::getAllocationThread() {
+    if (allocationThread)
+        return allocationThread;
+
+    allocationThread = makeShared<CAllocationThread>();
+    if (!allocationThread->good()) {
+        log(AQ_LOG_ERROR, "backend: Couldn't start the allocation thread");
+        allocationThread.reset();
+        return nullptr;
+    }
+
+    events.pollFDsChanged.emit();
+    return allocationThread;
+}
+
 int Aquamarine::CBackend::drmFD() {
     for (auto const& i : implementations) {
         int fd = i->drmFD();
@@ -262,6 +302,40 @@ const std::vector<SP<IBackendImplementation>>& Aquamarine::CBackend::getImplemen
     return implementations;
 }
 
+bool Aquamarine::CBackend::commitOutputs(const std::vector<SP<IOutput>>& outputs) {
+    bool ok = true;
+
+    for (auto const& impl : implementations) {
+        if (impl->type() != AQ_BACKEND_DRM)
+            continue;
+
+        std::vector<SP<CDRMOutput>> drmOutputs;
+        for (auto const& o : outputs) {
+            if (o->getBackend() == impl)
+                drmOutputs.emplace_back(reinterpretPointerCast<CDRMOutput>(o));
+        }
+
+        if (!drmOutputs.empty())
+            ok = reinterpretPointerCast<CDRMBackend>(impl)->commitOutputs(drmOutputs) && ok;
+    }
+
+    for (auto const& o : outputs) {
+        if (o->getBackend()->type() != AQ_BACKEND_DRM)
+            ok = o->commit() && ok;
+    }
+
+    return ok;
+}
+
+void Aquamarine::CBackend::setAllocatorBudget(size_t bytes) {
+    allocatorBudget = bytes;
+    log(AQ_LOG_DEBUG, std::format("backend: allocator budget set to {} bytes", bytes));
+}
+
+size_t Aquamarine::CBackend::getAllocatorBudget() {
+    return allocatorBudget;
+}
+
 void Aquamarine::CBackend::addIdleEvent(SP<std::function<void(void)>> fn) {
     auto r = idle.pending.emplace_back(fn);
 
@@ -269,7 +343,19 @@ void Aquamarine::CBackend::addIdleEvent(SP<std::function<void(void)>> fn) {
 }
 
 void Aquamarine::CBackend::updateIdleTimer() {
-    uint64_t ADD_NS = idle.pending.empty() ? TIMESPEC_NSEC_PER_SEC * 240ULL /* 240s, 4 mins */ : 0;
+    uint64_t ADD_NS = 0;
+    if (idle.pending.empty()) {
+        // allocators age out what they pool on trim(), which only we call when nothing else is going on
+        bool pooled = false;
+        for (auto const& impl : implementations) {
+            for (auto const& a : impl->getAllocators()) {
+                if (a && a->hasPooled())
+                    pooled = true;
+            }
+        }
+
+        ADD_NS = TIMESPEC_NSEC_PER_SEC * (pooled ? 10ULL : 240ULL /* 240s, 4 mins */);
+    }
 
     timespec now;
     clock_gettime(CLOCK_MONOTONIC, &now);
@@ -301,6 +387,13 @@ void Aquamarine::CBackend::dispatchIdle() {
             (*i)();
     }
 
+    for (auto const& impl : implementations) {
+        for (auto const& a : impl->getAllocators()) {
+            if (a)
+                a->trim();
+        }
+    }
+
     updateIdleTimer();
 }
 
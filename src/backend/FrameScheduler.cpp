@@ -1,9 +1,22 @@
 #include <aquamarine/backend/FrameScheduler.hpp>
+#include <algorithm>
+#include <cstdlib>
 
 using namespace Aquamarine;
+using namespace std::chrono;
 
-void CFrameScheduler::onFrameSubmitted() {
+void CFrameScheduler::onFrameSubmitted(steady_clock::time_point when) {
     m_pending = true;
+
+    if (!m_render.start)
+        return;
+
+    // even a slow frame would have been in by the vblank after its own, this is one that never got committed
+    if (!m_render.target || when <= *m_render.target + m_vblank.interval)
+        addRenderTime(duration_cast<nanoseconds>(when - *m_render.start));
+
+    m_render.start.reset();
+    m_render.target.reset();
 }
 
 void CFrameScheduler::onFrameComplete() {
@@ -15,6 +28,8 @@ void CFrameScheduler::invalidate() {
     m_frameRunning        = false;
     m_frameScheduled      = false;
     m_rescheduleRequested = false;
+    m_render.start.reset();
+    m_render.target.reset();
 }
 
 bool CFrameScheduler::frameInFlight() const {
@@ -45,6 +60,74 @@ void CFrameScheduler::requestReschedule() {
     m_rescheduleRequested = true;
 }
 
+void CFrameScheduler::onVblank(steady_clock::time_point when, uint32_t seq, nanoseconds interval) {
+    if (interval.count() <= 0) {
+        m_vblank = {};
+        return;
+    }
+
+    // a mode change resets the estimate, otherwise nudge it towards what the hw actually does. Clocks drift a
+    // bit off the nominal refresh, and that adds up when extrapolating over a few idle frames.
+    if (m_vblank.interval.count() <= 0 || std::abs(m_vblank.interval.count() - interval.count()) > interval.count() / 10)
+        m_vblank.interval = interval;
+    else if (m_vblank.last && seq > m_vblank.lastSeq && when > *m_vblank.last) {
+        const auto MEASURED = duration_cast<nanoseconds>(when - *m_vblank.last) / (seq - m_vblank.lastSeq);
+        if (std::abs(MEASURED.count() - interval.count()) < interval.count() / 10)
+            m_vblank.interval += (MEASURED - m_vblank.interval) / 8;
+    }
+
+    m_vblank.last    = when;
+    m_vblank.lastSeq = seq;
+}
+
+std::optional<steady_clock::time_point> CFrameScheduler::predictNextVblank(steady_clock::time_point now) const {
+    if (!m_vblank.last || m_vblank.interval.count() <= 0)
+        return std::nullopt;
+
+    if (now < *m_vblank.last)
+        return *m_vblank.last;
+
+    const auto ELAPSED = duration_cast<nanoseconds>(now - *m_vblank.last);
+    return *m_vblank.last + m_vblank.interval * (ELAPSED / m_vblank.interval + 1);
+}
+
+void CFrameScheduler::setRenderDeadline(nanoseconds deadline) {
+    m_render.deadline = std::max(deadline, nanoseconds{0});
+}
+
+nanoseconds CFrameScheduler::renderDeadline() const {
+    return m_render.deadline;
+}
+
+void CFrameScheduler::onRenderStart(steady_clock::time_point when) {
+    m_render.start  = when;
+    m_render.target = predictNextVblank(when);
+}
+
+void CFrameScheduler::addRenderTime(nanoseconds time) {
+    m_render.samples.at(m_render.next) = time;
+    m_render.next                      = (m_render.next + 1) % m_render.samples.size();
+}
+
+nanoseconds CFrameScheduler::renderTimeEstimate() const {
+    return *std::ranges::max_element(m_render.samples);
+}
+
+std::optional<steady_clock::time_point> CFrameScheduler::frameEventTime(steady_clock::time_point now) const {
+    if (m_render.deadline.count() <= 0)
+        return std::nullopt;
+
+    const auto VBLANK = predictNextVblank(now);
+    if (!VBLANK)
+        return std::nullopt;
+
+    const auto WHEN = *VBLANK - m_render.deadline - renderTimeEstimate();
+    if (WHEN <= now)
+        return std::nullopt;
+
+    return WHEN;
+}
+
 CFrameRunningGuard::CFrameRunningGuard(CFrameScheduler& s) : m_s(s) {
     m_s.setFrameRunning(true);
 }
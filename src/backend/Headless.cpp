@@ -25,6 +25,10 @@ Aquamarine::CHeadlessOutput::~CHeadlessOutput() {
 }
 
 bool Aquamarine::CHeadlessOutput::commit() {
+    // nothing to wait on, a committed buffer is as presented as it gets
+    if (swapchain && (state->internalState.committed & COutputState::AQ_OUTPUT_STATE_BUFFER))
+        swapchain->presented(state->internalState.buffer);
+
     events.commit.emit();
     state->onCommit();
     needsFrame = false;
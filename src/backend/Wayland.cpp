@@ -666,6 +666,8 @@ bool Aquamarine::CWaylandOutput::commit() {
         backend->backend->log(AQ_LOG_WARNING, std::format("Output {}: pending state has a non-released buffer??", name));
 
     wlBuffer->pendingRelease = true;
+    // the swapchain won't hand it out again until the host lets go of it
+    state->internalState.buffer->lockedByBackend = true;
 
     waylandState.surface->sendAttach(wlBuffer->waylandState.buffer.get(), 0, 0);
     waylandState.surface->sendDamageBuffer(0, 0, INT32_MAX, INT32_MAX);
@@ -694,6 +696,9 @@ bool Aquamarine::CWaylandOutput::commit() {
     // becomes readable, and the frame loop deadlocks.
     wl_display_flush(backend->waylandState.display);
 
+    // the host shows buffers in the order they're attached, which is all ages need
+    swapchain->presented(state->internalState.buffer);
+
     events.commit.emit();
     state->onCommit();
     needsFrame = false;
@@ -875,7 +880,14 @@ Aquamarine::CWaylandBuffer::CWaylandBuffer(SP<IBuffer> buffer_, Hyprutils::Memor
 
     waylandState.buffer = makeShared<CCWlBuffer>(params->sendCreateImmed(attrs.size.x, attrs.size.y, attrs.format, (zwpLinuxBufferParamsV1Flags)0));
 
-    waylandState.buffer->setRelease([this](CCWlBuffer* r) { pendingRelease = false; });
+    waylandState.buffer->setRelease([this](CCWlBuffer* r) {
+        pendingRelease = false;
+
+        if (auto buf = buffer.lock(); buf && buf->lockedByBackend) {
+            buf->lockedByBackend = false;
+            buf->events.backendRelease.emit();
+        }
+    });
 
     params->sendDestroy();
 }
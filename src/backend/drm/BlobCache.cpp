@@ -0,0 +1,126 @@
+#include "BlobCache.hpp"
+#include "Shared.hpp"
+#include <algorithm>
+#include <cstring>
+#include <xf86drmMode.h>
+
+using namespace Aquamarine;
+using namespace Hyprutils::Memory;
+
+// how many unreferenced blobs we keep around for reuse
+constexpr size_t MAX_IDLE_BLOBS = 16;
+
+Aquamarine::CDRMBlobCache::CDRMBlobCache(CWeakPointer<CDRMBackend> backend_, int drmFD_) : backend(backend_), drmFD(drmFD_) {
+    ;
+}
+
+Aquamarine::CDRMBlobCache::~CDRMBlobCache() {
+    for (auto const& [hash, blob] : blobs) {
+        destroy(blob.id);
+    }
+}
+
+uint32_t Aquamarine::CDRMBlobCache::acquire(eBlobType type, const void* data, size_t len, bool fresh) {
+    const uint64_t HASH = hashCombine(hashBytes(data, len), type);
+
+    auto [begin, end] = blobs.equal_range(HASH);
+    for (auto it = fresh ? end : begin; it != end; ++it) {
+        auto& blob = it->second;
+        if (blob.type != type || blob.contents.size() != len || memcmp(blob.contents.data(), data, len) != 0)
+            continue;
+
+        if (blob.refs++ == 0)
+            std::erase(idle, blob.id);
+
+        TRACE(log(AQ_LOG_TRACE, std::format("drm blobs: reusing blob {}, {} refs", blob.id, blob.refs)));
+        return blob.id;
+    }
+
+    uint32_t id = 0;
+    if (drmModeCreatePropertyBlob(drmFD, data, len, &id)) {
+        log(AQ_LOG_ERROR, "drm blobs: failed to create a blob");
+        return 0;
+    }
+
+    // release() destroys ids it doesn't know
+    if (fresh)
+        return id;
+
+    SBlob blob{.id = id, .refs = 1, .type = type};
+    blob.contents.resize(len);
+    memcpy(blob.contents.data(), data, len);
+
+    blobs.emplace(HASH, std::move(blob));
+    hashByID[id] = HASH;
+
+    TRACE(log(AQ_LOG_TRACE, std::format("drm blobs: created blob {} of type {}", id, (int)type)));
+
+    return id;
+}
+
+void Aquamarine::CDRMBlobCache::release(uint32_t id) {
+    if (!id)
+        return;
+
+    const auto HASHIT = hashByID.find(id);
+    if (HASHIT == hashByID.end()) {
+        destroy(id);
+        return;
+    }
+
+    auto [begin, end] = blobs.equal_range(HASHIT->second);
+    for (auto it = begin; it != end; ++it) {
+        auto& blob = it->second;
+        if (blob.id != id)
+            continue;
+
+        if (blob.refs == 0) {
+            log(AQ_LOG_ERROR, std::format("drm blobs: blob {} released more often than acquired", id));
+            return;
+        }
+
+        if (--blob.refs == 0) {
+            idle.emplace_back(id);
+            trimIdle();
+        }
+
+        return;
+    }
+}
+
+void Aquamarine::CDRMBlobCache::trimIdle() {
+    while (idle.size() > MAX_IDLE_BLOBS) {
+        const uint32_t ID = idle.front();
+        idle.pop_front();
+
+        const auto HASHIT = hashByID.find(ID);
+        if (HASHIT == hashByID.end())
+            continue;
+
+        auto [begin, end] = blobs.equal_range(HASHIT->second);
+        for (auto it = begin; it != end; ++it) {
+            if (it->second.id != ID)
+                continue;
+
+            blobs.erase(it);
+            break;
+        }
+
+        hashByID.erase(HASHIT);
+        destroy(ID);
+    }
+}
+
+void Aquamarine::CDRMBlobCache::destroy(uint32_t id) {
+    if (!id || drmFD < 0)
+        return;
+
+    if (drmModeDestroyPropertyBlob(drmFD, id))
+        log(AQ_LOG_ERROR, std::format("drm blobs: failed to destroy blob {}", id));
+}
+
+// the cache can outlive the backend on teardown
+void Aquamarine::CDRMBlobCache::log(eBackendLogLevel level, const std::string& msg) {
+    if (backend)
+        backend->log(level, msg);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <aquamarine/backend/DRM.hpp>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+namespace Aquamarine {
+
+    /*
+        Property blobs by content. Identical contents of the same type share one blob id, and blobs
+        nobody references anymore are kept around for a bit, so flipping between a few modes, luts or
+        ctms doesn't mint and destroy a blob every time.
+    */
+    class CDRMBlobCache {
+      public:
+        enum eBlobType : uint8_t {
+            AQ_DRM_BLOB_MODE = 0,
+            AQ_DRM_BLOB_GAMMA_LUT,
+            AQ_DRM_BLOB_DEGAMMA_LUT,
+            AQ_DRM_BLOB_CTM,
+            AQ_DRM_BLOB_HDR_METADATA,
+        };
+
+        CDRMBlobCache(Hyprutils::Memory::CWeakPointer<CDRMBackend> backend_, int drmFD_);
+        ~CDRMBlobCache();
+
+        // returns a blob id with one reference taken, 0 on failure. A fresh blob is never shared
+        // with or kept for anyone else, releasing it destroys it.
+        uint32_t acquire(eBlobType type, const void* data, size_t len, bool fresh = false);
+
+        // drops a reference. Ids the cache doesn't know are destroyed right away.
+        void release(uint32_t id);
+
+      private:
+        struct SBlob {
+            uint32_t             id   = 0;
+            size_t               refs = 0;
+            eBlobType            type = AQ_DRM_BLOB_MODE;
+            std::vector<uint8_t> contents;
+        };
+
+        void                                         destroy(uint32_t id);
+        void                                         trimIdle();
+        void                                         log(eBackendLogLevel level, const std::string& msg);
+
+        Hyprutils::Memory::CWeakPointer<CDRMBackend> backend;
+        int                                          drmFD = -1; // outlives the backend pointer on teardown
+
+        // content hash -> blobs with that hash, collisions are told apart by contents
+        std::unordered_multimap<uint64_t, SBlob> blobs;
+        std::unordered_map<uint32_t, uint64_t>   hashByID;
+
+        // unreferenced blob ids, oldest first
+        std::list<uint32_t> idle;
+    };
+};
@@ -0,0 +1,354 @@
+#include <aquamarine/backend/drm/CPUBlit.hpp>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <drm_fourcc.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define AQ_CPUBLIT_AVX2
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define AQ_CPUBLIT_NEON
+#endif
+
+using namespace Aquamarine;
+using namespace Hyprutils::Math;
+
+// how many pixels one task copies, roughly. Small enough to spread a single damaged rect over the workers
+constexpr size_t TASK_PIXELS = 64 * 1024;
+// below this much, waking the workers costs more than it saves
+constexpr size_t INLINE_PIXELS = 128 * 1024;
+
+namespace {
+    struct SFormatInfo {
+        uint32_t fourcc  = 0;
+        bool     depth10 = false; // 2101010
+        bool     bgr     = false; // red in the low bits
+        bool     alpha   = false;
+    };
+
+    constexpr std::array<SFormatInfo, 8> FORMATS = {{
+        {DRM_FORMAT_ARGB8888, false, false, true},
+        {DRM_FORMAT_XRGB8888, false, false, false},
+        {DRM_FORMAT_ABGR8888, false, true, true},
+        {DRM_FORMAT_XBGR8888, false, true, false},
+        {DRM_FORMAT_ARGB2101010, true, false, true},
+        {DRM_FORMAT_XRGB2101010, true, false, false},
+        {DRM_FORMAT_ABGR2101010, true, true, true},
+        {DRM_FORMAT_XBGR2101010, true, true, false},
+    }};
+
+    const SFormatInfo* formatInfo(uint32_t fourcc) {
+        for (auto const& f : FORMATS) {
+            if (f.fourcc == fourcc)
+                return &f;
+        }
+        return nullptr;
+    }
+
+    struct SConversion {
+        bool     copy     = false; // same layout, a plain memcpy
+        bool     depth10  = false; // drop the low 2 bits of each channel
+        bool     swapRB   = false;
+        bool     expandA2 = false; // 2 bit alpha to 8
+        uint32_t orMask   = 0;     // opaque alpha where the source has none
+    };
+
+    bool conversionFor(uint32_t from, uint32_t to, SConversion& conv) {
+        const auto SRC = formatInfo(from);
+        const auto DST = formatInfo(to);
+
+        if (!SRC || !DST)
+            return false;
+
+        conv = {};
+
+        if (from == to) {
+            conv.copy = true;
+            return true;
+        }
+
+        // nothing to fill the 2 extra bits with, and nobody scans out 10 bit dumb buffers
+        if (DST->depth10)
+            return false;
+
+        conv.depth10 = SRC->depth10;
+        conv.swapRB  = SRC->bgr != DST->bgr;
+
+        if (DST->alpha && SRC->alpha)
+            conv.expandA2 = SRC->depth10;
+        else if (DST->alpha || SRC->depth10)
+            conv.orMask = 0xFF000000;
+
+        conv.copy = !conv.depth10 && !conv.swapRB && !conv.orMask;
+        return true;
+    }
+
+    inline uint32_t convertPixel(uint32_t p, const SConversion& c) {
+        uint32_t out = p;
+        if (c.depth10) {
+            // the top 8 of each 10 bit channel, in the same order
+            out = ((p >> 6) & 0x00FF0000) | ((p >> 4) & 0x0000FF00) | ((p >> 2) & 0x000000FF);
+            if (c.expandA2)
+                out |= (p >> 30) * 0x55000000;
+        }
+
+        if (c.swapRB)
+            out = (out & 0xFF00FF00) | ((out >> 16) & 0xFF) | ((out & 0xFF) << 16);
+
+        return out | c.orMask;
+    }
+
+    void convertRowScalar(const uint32_t* src, uint32_t* dst, size_t n, const SConversion& c) {
+        for (size_t i = 0; i < n; ++i) {
+            dst[i] = convertPixel(src[i], c);
+        }
+    }
+
+#ifdef AQ_CPUBLIT_AVX2
+    // STREAM uses non-temporal stores, for write-combined destinations where going through the cache only costs
+    template <bool STREAM>
+    __attribute__((target("avx2"))) void convertRowAVX2(const uint32_t* src, uint32_t* dst, size_t n, const SConversion& c) {
+        const __m256i SWAP  = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15, 2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+        const __m256i OR    = _mm256_set1_epi32(c.orMask);
+        const __m256i RMASK = _mm256_set1_epi32(0x00FF0000), GMASK = _mm256_set1_epi32(0x0000FF00), BMASK = _mm256_set1_epi32(0x000000FF);
+        const __m256i A2MUL = _mm256_set1_epi32(0x55000000);
+
+        size_t        i = 0;
+        if constexpr (STREAM) {
+            // streaming stores need an aligned destination
+            for (; i < n && ((uintptr_t)(dst + i) & 31); ++i) {
+                dst[i] = convertPixel(src[i], c);
+            }
+        }
+
+        for (; i + 8 <= n; i += 8) {
+            __m256i v = _mm256_loadu_si256((const __m256i*)(src + i));
+
+            if (c.depth10) {
+                __m256i out = _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(v, 6), RMASK),
+                                              _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(v, 4), GMASK), _mm256_and_si256(_mm256_srli_epi32(v, 2), BMASK)));
+                if (c.expandA2)
+                    out = _mm256_or_si256(out, _mm256_mullo_epi32(_mm256_srli_epi32(v, 30), A2MUL));
+                v = out;
+            }
+
+            if (c.swapRB)
+                v = _mm256_shuffle_epi8(v, SWAP);
+
+            if constexpr (STREAM)
+                _mm256_stream_si256((__m256i*)(dst + i), _mm256_or_si256(v, OR));
+            else
+                _mm256_storeu_si256((__m256i*)(dst + i), _mm256_or_si256(v, OR));
+        }
+
+        convertRowScalar(src + i, dst + i, n - i, c);
+    }
+#endif
+
+#ifdef AQ_CPUBLIT_NEON
+    void convertRowNEON(const uint32_t* src, uint32_t* dst, size_t n, const SConversion& c) {
+        const uint8x16_t SWAP  = {2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15};
+        const uint32x4_t OR    = vdupq_n_u32(c.orMask);
+        const uint32x4_t RMASK = vdupq_n_u32(0x00FF0000), GMASK = vdupq_n_u32(0x0000FF00), BMASK = vdupq_n_u32(0x000000FF);
+
+        size_t           i = 0;
+        for (; i + 4 <= n; i += 4) {
+            uint32x4_t v = vld1q_u32(src + i);
+
+            if (c.depth10) {
+                uint32x4_t out = vorrq_u32(vandq_u32(vshrq_n_u32(v, 6), RMASK), vorrq_u32(vandq_u32(vshrq_n_u32(v, 4), GMASK), vandq_u32(vshrq_n_u32(v, 2), BMASK)));
+                if (c.expandA2)
+                    out = vorrq_u32(out, vmulq_n_u32(vshrq_n_u32(v, 30), 0x55000000));
+                v = out;
+            }
+
+            if (c.swapRB)
+                v = vreinterpretq_u32_u8(vqtbl1q_u8(vreinterpretq_u8_u32(v), SWAP));
+
+            vst1q_u32(dst + i, vorrq_u32(v, OR));
+        }
+
+        convertRowScalar(src + i, dst + i, n - i, c);
+    }
+#endif
+
+    using FConvertRow = void (*)(const uint32_t*, uint32_t*, size_t, const SConversion&);
+
+    FConvertRow pickKernel(bool streaming) {
+#ifdef AQ_CPUBLIT_AVX2
+        // we run from static init, possibly before libgcc's own constructor filled in the cpu model
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return streaming ? convertRowAVX2<true> : convertRowAVX2<false>;
+#endif
+#ifdef AQ_CPUBLIT_NEON
+        return convertRowNEON;
+#endif
+        return convertRowScalar;
+    }
+
+    const FConvertRow convertRow          = pickKernel(false);
+    // neon has no plain streaming store, there it's the same kernel
+    const FConvertRow convertRowStreaming = pickKernel(true);
+};
+
+Aquamarine::CCPUBlitter::CCPUBlitter(size_t threads) {
+    if (threads == 0) {
+        // a copy is bound by memory bandwidth long before it runs out of cores
+        const size_t HW = std::max(std::thread::hardware_concurrency(), 1U);
+        threads         = std::clamp<size_t>(HW / 2, 1, 4);
+    }
+
+    // the caller is one of them
+    for (size_t i = 1; i < threads; ++i) {
+        workers.emplace_back([this] { work(); });
+    }
+}
+
+Aquamarine::CCPUBlitter::~CCPUBlitter() {
+    {
+        std::lock_guard<std::mutex> lg(mutex);
+        exit = true;
+    }
+    cv.notify_all();
+
+    for (auto& w : workers) {
+        w.join();
+    }
+}
+
+bool Aquamarine::CCPUBlitter::supported(uint32_t from, uint32_t to) {
+    SConversion conv;
+    return conversionFor(from, to, conv);
+}
+
+void Aquamarine::CCPUBlitter::runTask(const STask& task) {
+    SConversion conv;
+    if (!conversionFor(task.srcFormat, task.dstFormat, conv))
+        return;
+
+    for (size_t y = 0; y < task.rows; ++y) {
+        const auto SRC = task.src + y * task.srcStride;
+        const auto DST = task.dst + y * task.dstStride;
+
+        if (task.streaming)
+            convertRowStreaming((const uint32_t*)SRC, (uint32_t*)DST, task.width, conv);
+        else if (conv.copy)
+            memcpy(DST, SRC, task.width * 4);
+        else
+            convertRow((const uint32_t*)SRC, (uint32_t*)DST, task.width, conv);
+    }
+
+#ifdef AQ_CPUBLIT_AVX2
+    // streaming stores aren't ordered with the unlock that tells the caller this task is done
+    if (task.streaming)
+        _mm_sfence();
+#endif
+}
+
+bool Aquamarine::CCPUBlitter::runOne() {
+    STask task;
+    {
+        std::lock_guard<std::mutex> lg(mutex);
+        if (nextTask >= tasks.size())
+            return false;
+
+        task = tasks.at(nextTask++);
+    }
+
+    runTask(task);
+
+    std::lock_guard<std::mutex> lg(mutex);
+    if (--unfinished == 0)
+        doneCV.notify_all();
+
+    return true;
+}
+
+void Aquamarine::CCPUBlitter::work() {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lk(mutex);
+            cv.wait(lk, [this] { return exit || nextTask < tasks.size(); });
+
+            if (exit)
+                return;
+        }
+
+        while (runOne()) {
+            ;
+        }
+    }
+}
+
+bool Aquamarine::CCPUBlitter::blit(const SCPUBlitImage& from, const SCPUBlitImage& to, const CRegion& damage) {
+    if (!from.data || !to.data || from.size != to.size || from.size.x <= 0 || from.size.y <= 0)
+        return false;
+
+    const size_t WIDTH = from.size.x, HEIGHT = from.size.y;
+    if (from.stride < WIDTH * 4 || to.stride < WIDTH * 4 || !supported(from.format, to.format))
+        return false;
+
+    const CBox                  FULL = {{}, from.size};
+    std::vector<pixman_box32_t> rects;
+    if (!damage.empty())
+        rects = damage.copy().intersect(FULL).getRects();
+    else
+        rects.push_back({0, 0, (int32_t)WIDTH, (int32_t)HEIGHT});
+
+    std::vector<STask> list;
+    size_t             pixels = 0;
+    for (auto const& r : rects) {
+        const size_t X = std::clamp<int32_t>(r.x1, 0, WIDTH), Y = std::clamp<int32_t>(r.y1, 0, HEIGHT);
+        const size_t W = std::clamp<int32_t>(r.x2, 0, WIDTH) - X, H = std::clamp<int32_t>(r.y2, 0, HEIGHT) - Y;
+        if (!W || !H)
+            continue;
+
+        const size_t BAND = std::max<size_t>(1, TASK_PIXELS / W);
+        for (size_t y = Y; y < Y + H; y += BAND) {
+            list.emplace_back(STask{
+                .src       = from.data + y * from.stride + X * 4,
+                .dst       = to.data + y * to.stride + X * 4,
+                .srcStride = from.stride,
+                .dstStride = to.stride,
+                .width     = W,
+                .rows      = std::min(BAND, Y + H - y),
+                .srcFormat = from.format,
+                .dstFormat = to.format,
+                .streaming = to.writeCombined,
+            });
+        }
+
+        pixels += W * H;
+    }
+
+    std::lock_guard<std::mutex> blitLock(blitMutex);
+
+    if (workers.empty() || pixels < INLINE_PIXELS || list.size() < 2) {
+        for (auto const& t : list) {
+            runTask(t);
+        }
+        return true;
+    }
+
+    {
+        std::lock_guard<std::mutex> lg(mutex);
+        tasks      = std::move(list);
+        nextTask   = 0;
+        unfinished = tasks.size();
+    }
+    cv.notify_all();
+
+    while (runOne()) {
+        ;
+    }
+
+    std::unique_lock<std::mutex> lk(mutex);
+    doneCV.wait(lk, [this] { return unfinished == 0; });
+    tasks.clear();
+    nextTask = 0;
+
+    return true;
+}
@@ -0,0 +1,119 @@
+#include "CommitThread.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <xf86drmMode.h>
+
+using namespace Aquamarine;
+
+Aquamarine::CDRMCommitThread::CDRMCommitThread(int drmFD_) : drmFD(drmFD_) {
+    event = Hyprutils::OS::CFileDescriptor{eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)};
+    if (!event.isValid())
+        return;
+
+    thread = std::thread([this] { run(); });
+}
+
+Aquamarine::CDRMCommitThread::~CDRMCommitThread() {
+    {
+        std::lock_guard<std::mutex> lg(mutex);
+        exit = true;
+    }
+    cv.notify_all();
+
+    // a commit in the ioctl has to finish first, the request it reads is freed with the queues below
+    if (thread.joinable())
+        thread.join();
+}
+
+bool Aquamarine::CDRMCommitThread::good() const {
+    return event.isValid() && thread.joinable();
+}
+
+int Aquamarine::CDRMCommitThread::eventFD() const {
+    return event.get();
+}
+
+void Aquamarine::CDRMCommitThread::submit(drmModeAtomicReq* req, uint32_t flags, void* userData, std::vector<uint32_t> objects, FCommitDone done) {
+    {
+        std::lock_guard<std::mutex> lg(mutex);
+        queued.emplace_back(SJob{.req = req, .flags = flags, .userData = userData, .objects = std::move(objects), .done = std::move(done)});
+    }
+    cv.notify_one();
+}
+
+void Aquamarine::CDRMCommitThread::dispatch() {
+    // EAGAIN is fine, the completions are what's in finished, not the count
+    uint64_t count = 0;
+    ssize_t  ret   = 0;
+    do {
+        ret = read(event.get(), &count, sizeof(count));
+    } while (ret < 0 && errno == EINTR);
+
+    std::deque<SJob> jobs;
+    {
+        std::lock_guard<std::mutex> lg(mutex);
+        jobs.swap(finished);
+    }
+
+    for (auto& job : jobs) {
+        if (job.done)
+            job.done(job.err);
+    }
+}
+
+void Aquamarine::CDRMCommitThread::flush() {
+    std::unique_lock<std::mutex> lk(mutex);
+    idleCV.wait(lk, [this] { return queued.empty() && !running; });
+}
+
+void Aquamarine::CDRMCommitThread::flush(const std::vector<uint32_t>& objects) {
+    std::unique_lock<std::mutex> lk(mutex);
+    idleCV.wait(lk, [this, &objects] { return !busyWith(objects); });
+}
+
+bool Aquamarine::CDRMCommitThread::busyWith(const std::vector<uint32_t>& objects) {
+    const auto TOUCHES = [&objects](const std::vector<uint32_t>& other) {
+        return std::ranges::any_of(other, [&objects](uint32_t o) { return std::ranges::find(objects, o) != objects.end(); });
+    };
+
+    return (running && TOUCHES(runningObjects)) || std::ranges::any_of(queued, [&TOUCHES](const SJob& job) { return TOUCHES(job.objects); });
+}
+
+void Aquamarine::CDRMCommitThread::run() {
+    while (true) {
+        std::unique_lock<std::mutex> lk(mutex);
+        cv.wait(lk, [this] { return exit || !queued.empty(); });
+
+        if (exit) {
+            running = false;
+            queued.clear();
+            idleCV.notify_all();
+            return;
+        }
+
+        // in order, a later commit may depend on an earlier one having landed
+        SJob job = std::move(queued.front());
+        queued.pop_front();
+        running        = true;
+        runningObjects = job.objects;
+        lk.unlock();
+
+        const int RET = drmModeAtomicCommit(drmFD, job.req, job.flags, job.userData);
+        job.err       = RET == 0 ? 0 : (RET == -1 ? errno : -RET);
+
+        lk.lock();
+        finished.emplace_back(std::move(job));
+        running = false;
+        lk.unlock();
+        idleCV.notify_all();
+
+        // EAGAIN only comes with the counter about to overflow, it's readable either way
+        const uint64_t ONE = 1;
+        ssize_t        ret = 0;
+        do {
+            ret = write(event.get(), &ONE, sizeof(ONE));
+        } while (ret < 0 && errno == EINTR);
+    }
+}
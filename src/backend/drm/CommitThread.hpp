@@ -0,0 +1,70 @@
+#pragma once
+
+#include <aquamarine/backend/DRM.hpp>
+#include <hyprutils/os/FileDescriptor.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Aquamarine {
+
+    /*
+        Runs blocking atomic commits off the main loop. A modeset can sit in the ioctl for 100ms+ while the
+        link trains, and input or the other outputs shouldn't stall for that. The thread only ever does the
+        ioctl itself, all the bookkeeping stays on the main thread: completions are queued and signalled on
+        an eventfd, which the backend polls and hands to dispatch().
+    */
+    class CDRMCommitThread {
+      public:
+        CDRMCommitThread(int drmFD_);
+        ~CDRMCommitThread();
+
+        // err is 0 on success, an errno otherwise. Called from dispatch(), on the main thread.
+        using FCommitDone = std::function<void(int err)>;
+
+        bool good() const;
+        int  eventFD() const;
+
+        // req has to stay valid until done has run, keep its owner alive in done. objects are the kms objects
+        // (crtcs, connectors, planes) req touches.
+        void submit(drmModeAtomicReq* req, uint32_t flags, void* userData, std::vector<uint32_t> objects, FCommitDone done);
+
+        // runs the callbacks of finished commits
+        void dispatch();
+
+        // blocks until every submitted commit went through the ioctl
+        void flush();
+        // same, but only for the commits touching any of objects. A commit made on the main thread must not
+        // overtake one still queued here for the same heads, the other heads can keep going meanwhile.
+        void flush(const std::vector<uint32_t>& objects);
+
+      private:
+        struct SJob {
+            drmModeAtomicReq*     req      = nullptr;
+            uint32_t              flags    = 0;
+            void*                 userData = nullptr;
+            std::vector<uint32_t> objects;
+            FCommitDone           done;
+            int                   err = 0;
+        };
+
+        void                           run();
+        // whether a queued or running commit touches any of objects, mutex has to be held
+        bool                           busyWith(const std::vector<uint32_t>& objects);
+
+        int                            drmFD = -1;
+        Hyprutils::OS::CFileDescriptor event;
+        std::thread                    thread;
+
+        std::mutex                     mutex;
+        std::condition_variable        cv;
+        std::deque<SJob>               queued, finished;
+        std::condition_variable        idleCV;
+        std::vector<uint32_t>          runningObjects;
+        bool                           exit = false, running = false;
+    };
+};
@@ -3,6 +3,7 @@
 #include <aquamarine/backend/DRM.hpp>
 #include <aquamarine/backend/drm/Legacy.hpp>
 #include <aquamarine/backend/drm/Atomic.hpp>
+#include <aquamarine/backend/drm/CPUBlit.hpp>
 #include <aquamarine/allocator/GBM.hpp>
 #include <aquamarine/allocator/DRMDumb.hpp>
 #include <cstdint>
@@ -13,11 +14,15 @@
 #include <thread>
 #include <deque>
 #include <unordered_map>
+#include <utility>
 #include <cstring>
 #include <filesystem>
 #include <system_error>
 #include <sys/mman.h>
+#include <sys/timerfd.h>
+#include <sys/utsname.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <unistd.h>
 extern "C" {
 #include <libseat.h>
@@ -35,6 +40,8 @@ extern "C" {
 #include "Shared.hpp"
 #include "hwdata.hpp"
 #include "Renderer.hpp"
+#include "BlobCache.hpp"
+#include "CommitThread.hpp"
 
 #include <hyprutils/utils/ScopeGuard.hpp>
 using Hyprutils::Utils::CScopeGuard;
@@ -58,6 +65,8 @@ static bool shouldSubmitCTM(SP<SDRMConnector> connector, const COutputState::SIn
 }
 
 Aquamarine::CDRMBackend::CDRMBackend(SP<CBackend> backend_) : backend(backend_) {
+    frameTimerFD = Hyprutils::OS::CFileDescriptor{timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK)};
+
     listeners.sessionActivate = backend->session->events.changeActive.listen([this] {
         if (backend->session->active) {
             // session got activated, we need to restore
@@ -371,6 +380,9 @@ std::vector<SP<CDRMBackend>> Aquamarine::CDRMBackend::attempt(SP<CBackend> backe
 }
 
 Aquamarine::CDRMBackend::~CDRMBackend() {
+    // let a commit in flight land before tearing the heads down under it
+    commitThread.reset();
+
     for (auto& conn : connectors) {
         conn->disconnect();
         conn.reset();
@@ -380,6 +392,7 @@ Aquamarine::CDRMBackend::~CDRMBackend() {
         rendererState.allocator->destroyBuffers();
 
     rendererState.renderer.reset();
+    rendererState.cpuBlitter.reset();
     rendererState.allocator.reset();
 }
 
@@ -394,6 +407,10 @@ bool Aquamarine::CDRMBackend::sessionActive() {
 void Aquamarine::CDRMBackend::restoreAfterVT() {
     backend->log(AQ_LOG_DEBUG, "drm: Restoring after VT switch");
 
+    // whoever had the VT before us could've left anything behind
+    testResults.clear();
+    shadowProps.clear();
+
     // Clear stale page-flip bookkeeping for all connectors.
     // During S3 suspend the display hardware powers off, so any pending
     // page-flip completion events are lost. The handlePF() callback that
@@ -549,14 +566,28 @@ bool Aquamarine::CDRMBackend::checkFeatures() {
     } else {
         backend->log(AQ_LOG_DEBUG, "drm: Atomic supported, using atomic for modesetting");
         impl                         = makeShared<CDRMAtomicImpl>(self.lock());
+        blobs                        = makeShared<CDRMBlobCache>(self, gpu->fd);
         drmProps.supportsAsyncCommit = drmGetCap(gpu->fd, DRM_CAP_ATOMIC_ASYNC_PAGE_FLIP, &cap) == 0 && cap == 1;
         atomic                       = true;
+
+        if (envEnabled("AQ_DRM_COMMIT_THREAD")) {
+            commitThread = makeShared<CDRMCommitThread>(gpu->fd);
+            if (!commitThread->good()) {
+                backend->log(AQ_LOG_ERROR, "drm: failed to start the commit thread, modesets will block");
+                commitThread.reset();
+            } else
+                backend->log(AQ_LOG_DEBUG, "drm: blocking modesets go through the commit thread");
+        }
     }
 
     backend->log(AQ_LOG_DEBUG, std::format("drm: drmProps.supportsAsyncCommit: {}", drmProps.supportsAsyncCommit));
     backend->log(AQ_LOG_DEBUG, std::format("drm: drmProps.supportsAddFb2Modifiers: {}", drmProps.supportsAddFb2Modifiers));
     backend->log(AQ_LOG_DEBUG, std::format("drm: drmProps.supportsTimelines: {}", drmProps.supportsTimelines));
 
+    drmProps.vblankIdleFrames = envEnabled("AQ_DRM_VBLANK_IDLE_FRAMES");
+    if (drmProps.vblankIdleFrames)
+        backend->log(AQ_LOG_DEBUG, "drm: AQ_DRM_VBLANK_IDLE_FRAMES enabled, idle frames wait for the next vblank");
+
     // TODO: allow no-modifiers?
 
     return true;
@@ -653,6 +684,24 @@ bool Aquamarine::CDRMBackend::initMgpu() {
     if (!rendererRequired)
         return true;
 
+    // a secondary without a usable egl can still show frames, copied on the cpu into dumb buffers
+    auto cpuFallback = [this](const std::string& why) {
+        if (!primary || !dumbAllocator) {
+            backend->log(AQ_LOG_ERROR, std::format("drm: initMgpu: {}", why));
+            return false;
+        }
+
+        backend->log(AQ_LOG_WARNING, std::format("drm: initMgpu: {}, blitting on the cpu into dumb buffers", why));
+        rendererState.renderer.reset();
+        rendererState.allocator  = dumbAllocator;
+        rendererState.cpuBlitter = makeShared<CCPUBlitter>();
+        return true;
+    };
+
+    static const auto FORCE_CPU_BLIT = envEnabled("AQ_MGPU_CPU_BLIT");
+    if (primary && FORCE_CPU_BLIT)
+        return cpuFallback("AQ_MGPU_CPU_BLIT set");
+
     SP<CGBMAllocator> newAllocator;
     if (primary || backend->primaryAllocator->type() != AQ_ALLOCATOR_TYPE_GBM) {
         newAllocator            = CGBMAllocator::create(backend->reopenDRMNode(gpu->fd), backend);
@@ -662,22 +711,27 @@ bool Aquamarine::CDRMBackend::initMgpu() {
         rendererState.allocator = newAllocator;
     }
 
-    if (!rendererState.allocator) {
-        backend->log(AQ_LOG_ERROR, "drm: initMgpu: no allocator");
-        return false;
-    }
+    if (!rendererState.allocator)
+        return cpuFallback("no allocator");
 
     rendererState.renderer = CDRMRenderer::attempt(backend.lock(), gpu->renderNodeFd >= 0 ? gpu->renderNodeFd : gpu->fd);
 
-    if (!rendererState.renderer) {
-        backend->log(AQ_LOG_ERROR, "drm: initMgpu: no renderer");
-        return false;
-    }
+    if (!rendererState.renderer)
+        return cpuFallback("no renderer");
 
     rendererState.renderer->self = rendererState.renderer;
 
     buildGlFormats(rendererState.renderer->formats);
 
+    // a real renderer is what revalidates the cache onReady may have used, e.g. after a mesa update
+    if (!primary)
+        saveGlFormatCache(rendererState.renderer->formats);
+
+    // blits into our buffers can then overlap with the rest of the commit
+    static const auto RENDER_THREAD = envEnabled("AQ_MGPU_RENDER_THREAD");
+    if (primary && RENDER_THREAD && !rendererState.renderer->startThread())
+        backend->log(AQ_LOG_WARNING, "drm: initMgpu: failed to start the render thread, blitting on the main thread");
+
     return true;
 }
 
@@ -692,11 +746,13 @@ bool Aquamarine::CDRMBackend::updateSecondaryRendererState() {
         return initMgpu();
     }
 
+    const bool initialized = (rendererState.renderer || rendererState.cpuBlitter) && rendererState.allocator;
+
     const bool hasEnabledOutputs =
         std::ranges::any_of(connectors, [](const auto& c) { return c->status == DRM_MODE_CONNECTED && c->output && c->output->state && c->output->state->state().enabled; });
 
     if (hasEnabledOutputs) {
-        if (rendererState.renderer && rendererState.allocator)
+        if (initialized)
             return true;
 
         backend->log(AQ_LOG_DEBUG, std::format("drm: Initializing secondary renderer on {}, has enabled outputs", gpu->path));
@@ -719,6 +775,7 @@ bool Aquamarine::CDRMBackend::updateSecondaryRendererState() {
         rendererState.allocator->destroyBuffers();
 
     rendererState.renderer.reset();
+    rendererState.cpuBlitter.reset();
     rendererState.allocator.reset();
 
     return true;
@@ -745,6 +802,143 @@ void Aquamarine::CDRMBackend::buildGlFormats(const std::vector<SGLFormat>& fmts)
     glFormats = result;
 }
 
+// what the gl formats of a gpu depend on, bar the userspace driver: a stale cache from that is caught by saveGlFormatCache
+static std::optional<std::string> glFormatCacheKey(int fd) {
+    std::string key = AQUAMARINE_VERSION;
+
+    utsname uts;
+    if (uname(&uts) == 0)
+        key += std::format("\n{} {}", uts.release, uts.version);
+
+    auto ver = drmGetVersion(fd);
+    if (!ver)
+        return std::nullopt;
+
+    key += std::format("\n{} {}.{}.{} {}", ver->name ? ver->name : "", ver->version_major, ver->version_minor, ver->version_patchlevel, ver->date ? ver->date : "");
+    drmFreeVersion(ver);
+
+    drmDevice* dev = nullptr;
+    if (drmGetDevice2(fd, 0, &dev) != 0 || !dev)
+        return std::nullopt;
+
+    if (dev->bustype == DRM_BUS_PCI)
+        key += std::format("\npci {:04x}:{:02x}:{:02x}.{} {:04x}:{:04x}", dev->businfo.pci->domain, dev->businfo.pci->bus, dev->businfo.pci->dev, dev->businfo.pci->func,
+                           dev->deviceinfo.pci->vendor_id, dev->deviceinfo.pci->device_id);
+    else if (dev->available_nodes & (1 << DRM_NODE_PRIMARY))
+        key += std::format("\n{}", dev->nodes[DRM_NODE_PRIMARY]);
+
+    drmFreeDevice(&dev);
+
+    return key;
+}
+
+constexpr uint32_t GL_FORMAT_CACHE_MAGIC   = 0x46475141; // AQGF
+constexpr uint32_t GL_FORMAT_CACHE_VERSION = 1;
+
+static std::vector<uint8_t> serializeGlFormats(const std::string& key, const std::vector<SGLFormat>& fmts) {
+    std::vector<uint8_t> out;
+    auto                 put = [&out](const void* data, size_t len) { out.insert(out.end(), (const uint8_t*)data, (const uint8_t*)data + len); };
+
+    const uint32_t KEYLEN = key.size(), COUNT = fmts.size();
+    put(&GL_FORMAT_CACHE_MAGIC, sizeof(uint32_t));
+    put(&GL_FORMAT_CACHE_VERSION, sizeof(uint32_t));
+    put(&KEYLEN, sizeof(KEYLEN));
+    put(key.data(), key.size());
+    put(&COUNT, sizeof(COUNT));
+
+    for (auto const& fmt : fmts) {
+        const uint8_t EXTERNAL = fmt.external;
+        put(&fmt.drmFormat, sizeof(fmt.drmFormat));
+        put(&fmt.modifier, sizeof(fmt.modifier));
+        put(&EXTERNAL, sizeof(EXTERNAL));
+    }
+
+    return out;
+}
+
+static std::optional<std::filesystem::path> glFormatCachePath(const std::string& key) {
+    static const auto NO_CACHE = envEnabled("AQ_NO_FORMAT_CACHE");
+    if (NO_CACHE)
+        return std::nullopt;
+
+    auto dir = cacheDir("formats");
+    if (!dir)
+        return std::nullopt;
+
+    return *dir / std::format("{:016x}", hashBytes(key.data(), key.size()));
+}
+
+std::optional<std::vector<SGLFormat>> Aquamarine::CDRMBackend::loadGlFormatCache() {
+    const auto KEY = glFormatCacheKey(gpu->fd);
+    if (!KEY)
+        return std::nullopt;
+
+    const auto PATH = glFormatCachePath(*KEY);
+    if (!PATH)
+        return std::nullopt;
+
+    const auto DATA = readCacheFile(*PATH);
+    if (!DATA)
+        return std::nullopt;
+
+    size_t pos  = 0;
+    auto   take = [&DATA, &pos](void* to, size_t len) {
+        if (pos + len > DATA->size())
+            return false;
+        memcpy(to, DATA->data() + pos, len);
+        pos += len;
+        return true;
+    };
+
+    uint32_t magic = 0, version = 0, keyLen = 0, count = 0;
+    if (!take(&magic, sizeof(magic)) || !take(&version, sizeof(version)) || magic != GL_FORMAT_CACHE_MAGIC || version != GL_FORMAT_CACHE_VERSION)
+        return std::nullopt;
+
+    // the name is only a hash, the key itself has to match too
+    if (!take(&keyLen, sizeof(keyLen)) || keyLen != KEY->size() || pos + keyLen > DATA->size() || memcmp(DATA->data() + pos, KEY->data(), keyLen) != 0)
+        return std::nullopt;
+    pos += keyLen;
+
+    if (!take(&count, sizeof(count)) || count == 0)
+        return std::nullopt;
+
+    std::vector<SGLFormat> fmts;
+    fmts.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) {
+        SGLFormat fmt;
+        uint8_t   external = 0;
+        if (!take(&fmt.drmFormat, sizeof(fmt.drmFormat)) || !take(&fmt.modifier, sizeof(fmt.modifier)) || !take(&external, sizeof(external)))
+            return std::nullopt;
+        fmt.external = external;
+        fmts.emplace_back(fmt);
+    }
+
+    return fmts;
+}
+
+void Aquamarine::CDRMBackend::saveGlFormatCache(const std::vector<SGLFormat>& fmts) {
+    if (fmts.empty())
+        return;
+
+    const auto KEY = glFormatCacheKey(gpu->fd);
+    if (!KEY)
+        return;
+
+    const auto PATH = glFormatCachePath(*KEY);
+    if (!PATH)
+        return;
+
+    const auto DATA = serializeGlFormats(*KEY, fmts);
+    if (const auto OLD = readCacheFile(*PATH); OLD && *OLD == DATA)
+        return;
+
+    if (std::filesystem::exists(*PATH))
+        backend->log(AQ_LOG_DEBUG, std::format("drm: gl formats of {} changed since they were cached, updating", gpu->path));
+
+    if (!writeCacheFile(*PATH, DATA))
+        backend->log(AQ_LOG_DEBUG, std::format("drm: couldn't write the gl format cache for {}", gpu->path));
+}
+
 void Aquamarine::CDRMBackend::recheckCRTCs() {
     if (connectors.empty() || crtcs.empty())
         return;
@@ -912,8 +1106,10 @@ bool Aquamarine::CDRMBackend::registerGPU(SP<CSessionDevice> gpu_, SP<CDRMBacken
         drmFreeVersion(drmVer);
     listeners.gpuChange = gpu->events.change.listen([this](const CSessionDevice::SChangeEvent& E) {
         if (E.type == CSessionDevice::AQ_SESSION_EVENT_CHANGE_HOTPLUG) {
-            backend->log(AQ_LOG_DEBUG, std::format("drm: Got a hotplug event for {}", gpuName));
-            recheckOutputs();
+            backend->log(AQ_LOG_DEBUG, std::format("drm: Got a hotplug event for {}, connector {}", gpuName, E.hotplug.connectorID));
+            // the kernel names the connector that changed when it can, so only that one needs a real probe
+            static const auto NO_TARGETED = envEnabled("AQ_NO_TARGETED_HOTPLUG");
+            recheckOutputs(NO_TARGETED ? 0 : E.hotplug.connectorID);
         } else if (E.type == CSessionDevice::AQ_SESSION_EVENT_CHANGE_LEASE) {
             backend->log(AQ_LOG_DEBUG, std::format("drm: Got a lease event for {}", gpuName));
             scanLeases();
@@ -979,8 +1175,10 @@ void Aquamarine::CDRMBackend::markRedundantTiles() {
     }
 }
 
-void Aquamarine::CDRMBackend::recheckOutputs() {
-    scanConnectors();
+void Aquamarine::CDRMBackend::recheckOutputs(uint32_t probeID) {
+    testResults.clear();
+
+    scanConnectors(probeID);
     markRedundantTiles();
 
     // disconnect now to possibly free up crtcs
@@ -1026,8 +1224,11 @@ void Aquamarine::CDRMBackend::recheckOutputs() {
         backend->log(AQ_LOG_ERROR, std::format("drm: Failed to update renderer state for {}", gpu->path));
 }
 
-void Aquamarine::CDRMBackend::scanConnectors() {
-    backend->log(AQ_LOG_DEBUG, std::format("drm: Scanning connectors for {}", gpu->path));
+// A forced probe (drmModeGetConnector) makes the driver re-detect the sink and re-read its EDID over DDC,
+// which can take tens of ms per connector. When a hotplug names its connector, every other connector we
+// already know about only gets its cached state via drmModeGetConnectorCurrent.
+void Aquamarine::CDRMBackend::scanConnectors(uint32_t probeID) {
+    backend->log(AQ_LOG_DEBUG, std::format("drm: Scanning connectors for {}{}", gpu->path, probeID ? std::format(", probing only {}", probeID) : ""));
 
     auto resources = drmModeGetResources(gpu->fd);
     if (!resources) {
@@ -1039,7 +1240,10 @@ void Aquamarine::CDRMBackend::scanConnectors() {
         uint32_t          connectorID = resources->connectors[i];
 
         SP<SDRMConnector> conn;
-        auto              drmConn = drmModeGetConnector(gpu->fd, connectorID);
+        auto              it = std::ranges::find_if(connectors, [connectorID](const auto& e) { return e->id == connectorID; });
+
+        const bool        probe   = !probeID || connectorID == probeID || it == connectors.end();
+        auto              drmConn = probe ? drmModeGetConnector(gpu->fd, connectorID) : drmModeGetConnectorCurrent(gpu->fd, connectorID);
 
         backend->log(AQ_LOG_DEBUG, std::format("drm: Scanning connector id {}", connectorID));
 
@@ -1048,7 +1252,6 @@ void Aquamarine::CDRMBackend::scanConnectors() {
             continue;
         }
 
-        auto it = std::ranges::find_if(connectors, [connectorID](const auto& e) { return e->id == connectorID; });
         if (it == connectors.end()) {
             backend->log(AQ_LOG_DEBUG, std::format("drm: Initializing connector id {}", connectorID));
             conn          = connectors.emplace_back(SP<SDRMConnector>(new SDRMConnector()));
@@ -1096,6 +1299,9 @@ void Aquamarine::CDRMBackend::scanConnectors() {
 }
 
 void Aquamarine::CDRMBackend::scanLeases() {
+    testResults.clear();
+    shadowProps.clear();
+
     auto lessees = drmModeListLessees(gpu->fd);
     if (!lessees) {
         backend->log(AQ_LOG_ERROR, "drmModeListLessees failed");
@@ -1142,7 +1348,66 @@ bool Aquamarine::CDRMBackend::start() {
 }
 
 std::vector<Hyprutils::Memory::CSharedPointer<SPollFD>> Aquamarine::CDRMBackend::pollFDs() {
-    return {makeShared<SPollFD>(gpu->fd, [this]() { dispatchEvents(); })};
+    std::vector<SP<SPollFD>> fds = {makeShared<SPollFD>(gpu->fd, [this]() { dispatchEvents(); })};
+
+    if (frameTimerFD.isValid())
+        fds.emplace_back(makeShared<SPollFD>(frameTimerFD.get(), [this]() { dispatchFrameTimer(); }));
+
+    if (commitThread)
+        fds.emplace_back(makeShared<SPollFD>(commitThread->eventFD(), [this]() { commitThread->dispatch(); }));
+
+    return fds;
+}
+
+void Aquamarine::CDRMBackend::dispatchFrameTimer() {
+    uint64_t expirations = 0;
+    ssize_t  ret         = 0;
+    do {
+        ret = read(frameTimerFD.get(), &expirations, sizeof(expirations));
+    } while (ret < 0 && errno == EINTR);
+
+    // EAGAIN: it got rearmed between waking us and now, whatever was due then isn't anymore. On a real error,
+    // still go through the deadlines below, or held frames would never go out.
+    if (ret < 0 && errno == EAGAIN)
+        return;
+    if (ret < 0)
+        backend->log(AQ_LOG_ERROR, std::format("drm: failed to read the frame timer: {}", strerror(errno)));
+
+    const auto NOW = std::chrono::steady_clock::now();
+
+    // the frame event can end up touching the connector list (disable -> recheckOutputs), iterate a copy
+    auto conns = connectors;
+    for (auto const& c : conns) {
+        if (!c->output || !c->output->frameDeadline || *c->output->frameDeadline > NOW)
+            continue;
+
+        c->output->frameDeadline.reset();
+        c->output->emitHeldFrame();
+    }
+
+    updateFrameTimer();
+}
+
+void Aquamarine::CDRMBackend::updateFrameTimer() {
+    std::optional<std::chrono::steady_clock::time_point> soonest;
+    for (auto const& c : connectors) {
+        if (c->output && c->output->frameDeadline && (!soonest || *c->output->frameDeadline < *soonest))
+            soonest = c->output->frameDeadline;
+    }
+
+    itimerspec ts = {};
+    if (soonest) {
+        auto secs = std::chrono::time_point_cast<std::chrono::seconds>(*soonest);
+        auto ns   = std::chrono::time_point_cast<std::chrono::nanoseconds>(*soonest) - std::chrono::time_point_cast<std::chrono::nanoseconds>(secs);
+        ts        = {.it_value = {secs.time_since_epoch().count(), ns.count()}};
+
+        // an all-zero it_value disarms the timer
+        if (ts.it_value.tv_sec == 0 && ts.it_value.tv_nsec == 0)
+            ts.it_value.tv_nsec = 1;
+    }
+
+    if (timerfd_settime(frameTimerFD.get(), TFD_TIMER_ABSTIME, &ts, nullptr))
+        backend->log(AQ_LOG_ERROR, std::format("drm: failed to arm the frame timer: {}", strerror(errno)));
 }
 
 int Aquamarine::CDRMBackend::drmFD() {
@@ -1166,7 +1431,104 @@ SP<SDRMCRTC> Aquamarine::CDRMBackend::crtcByID(uint32_t id) {
     return it == crtcs.end() ? nullptr : *it;
 }
 
-uintptr_t Aquamarine::SDRMCRTC::armPageFlip(CWeakPointer<SDRMConnector> connector, bool async) {
+void Aquamarine::CDRMBackend::forgetShadowFB(uint32_t fbID) {
+    for (auto const& plane : planes) {
+        const auto it = shadowProps.find(((uint64_t)plane->id << 32) | plane->props.values.fb_id);
+        if (it == shadowProps.end() || it->second != fbID)
+            continue;
+
+        for (auto const& prop : plane->props.props) {
+            shadowProps.erase(((uint64_t)plane->id << 32) | prop);
+        }
+    }
+}
+
+void Aquamarine::CDRMBackend::rememberTestResult(uint64_t key, bool result) {
+    // plenty for a handful of configs tried every frame, and keeps a misbehaving consumer from growing this forever
+    constexpr size_t MAX_TEST_RESULTS = 256;
+
+    if (testResults.size() >= MAX_TEST_RESULTS)
+        testResults.clear();
+
+    testResults[key] = result;
+}
+
+bool Aquamarine::CDRMBackend::commitOutputs(const std::vector<SP<CDRMOutput>>& outputs) {
+    struct SHead {
+        SP<CDRMOutput>          output;
+        SDRMConnectorCommitData data;
+    };
+
+    std::vector<SHead>          group;
+    std::vector<SP<CDRMOutput>> single;
+    bool                        ok = true;
+
+    group.reserve(outputs.size());
+
+    for (auto const& o : outputs) {
+        const auto& STATE = o->state->state();
+
+        // only plain vsync'd flips can share a request: modesets keep their own retry paths, and async flips can't be grouped.
+        if (!atomic || outputs.size() < 2 || o->backend.get() != this || !STATE.enabled || !(STATE.committed & COutputState::AQ_OUTPUT_STATE_BUFFER) ||
+            STATE.presentationMode == AQ_OUTPUT_PRESENTATION_IMMEDIATE || o->state->needsReconfig()) {
+            single.emplace_back(o);
+            continue;
+        }
+
+        uint32_t flags = 0;
+        if (!o->checkState(false, flags)) {
+            ok = false;
+            continue;
+        }
+
+        auto& head = group.emplace_back(SHead{.output = o});
+        if (!o->prepareCommit(head.data, flags, false)) {
+            group.pop_back();
+            ok = false;
+            continue;
+        }
+
+        // prepareCommit can still decide on a modeset (first frame, format mismatch). Those go alone.
+        if (head.data.modeset || !(head.data.flags & DRM_MODE_PAGE_FLIP_EVENT) || (head.data.flags & DRM_MODE_PAGE_FLIP_ASYNC)) {
+            ok = o->finishCommit(head.data, o->commitData(head.data, false), false) && ok;
+            group.pop_back();
+        }
+    }
+
+    if (group.size() > 1) {
+        std::vector<std::pair<SP<SDRMConnector>, SDRMConnectorCommitData*>> heads;
+        heads.reserve(group.size());
+        for (auto& h : group) {
+            heads.emplace_back(h.output->connector, &h.data);
+        }
+
+        if (impl->commitGroup(heads)) {
+            for (auto& h : group) {
+                h.output->connector->applyCommit(h.data);
+                h.output->finishCommit(h.data, true, false);
+            }
+
+            group.clear();
+        } else {
+            log(AQ_LOG_DEBUG, std::format("drm: grouped commit of {} heads failed, committing them one by one", group.size()));
+            for (auto& h : group) {
+                h.data.atomic = {};
+            }
+        }
+    }
+
+    for (auto& h : group) {
+        ok = h.output->finishCommit(h.data, h.output->commitData(h.data, false), false) && ok;
+    }
+
+    for (auto const& o : single) {
+        ok = o->commit() && ok;
+    }
+
+    return ok;
+}
+
+uintptr_t Aquamarine::SDRMCRTC::armPageFlip(CWeakPointer<SDRMConnector> connector, bool async, uintptr_t id_) {
     if (pendingFlip.id && !(pendingFlip.connector == connector)) {
         if (const auto PREV = pendingFlip.connector.lock()) {
             backend->log(AQ_LOG_ERROR, std::format("drm: crtc {} page-flip slot taken from {}, dropping its frame", id, PREV->szName));
@@ -1174,7 +1536,7 @@ uintptr_t Aquamarine::SDRMCRTC::armPageFlip(CWeakPointer<SDRMConnector> connecto
         }
     }
 
-    pendingFlip.id        = backend->nextPageFlipID();
+    pendingFlip.id        = id_ ? id_ : backend->nextPageFlipID();
     pendingFlip.connector = connector;
     pendingFlip.async     = async;
 
@@ -1250,17 +1612,53 @@ static void                      handlePF(int fd, unsigned seq, unsigned tv_sec,
             .refresh   = (int)(CONNECTOR->refresh ? (1000000000000LL / CONNECTOR->refresh) : 0),
             .flags     = flags,
         });
+
+        const auto WHEN     = std::chrono::steady_clock::time_point{std::chrono::seconds{tv_sec} + std::chrono::microseconds{tv_usec}};
+        const auto INTERVAL = std::chrono::nanoseconds{CONNECTOR->refresh ? 1000000000000LL / CONNECTOR->refresh : 0};
+
+        CONNECTOR->onVblank(WHEN, seq, INTERVAL);
     }
 
     // Skip if an idle frame is already queued: it emits events.frame itself, and #325 forbids double-firing.
-    if (BACKEND->sessionActive() && CONNECTOR->output->enabledState && !CONNECTOR->sched.frameScheduled())
+    // With a render deadline the frame event may also be held back until closer to the next vblank.
+    if (BACKEND->sessionActive() && CONNECTOR->output->enabledState && !CONNECTOR->sched.frameScheduled() && !CONNECTOR->output->deferFrame())
         CONNECTOR->sched.frameReady.emit();
 }
 
+static void handleSequence(int fd, uint64_t seq, uint64_t ns, uint64_t data) {
+    const auto BACKEND = gDispatchingBackend.lock();
+
+    if (!BACKEND || BACKEND->drmFD() != fd)
+        return;
+
+    const auto CRTC      = BACKEND->crtcByID((uint32_t)data);
+    const auto CONNECTOR = CRTC ? CRTC->pendingSequence.lock() : nullptr;
+
+    // the frame got invalidated, or something else delivered it already
+    if (!CONNECTOR) {
+        TRACE(BACKEND->log(AQ_LOG_TRACE, std::format("drm: Ignoring a stale crtc sequence event on crtc {}", data)));
+        return;
+    }
+
+    CRTC->pendingSequence.reset();
+
+    TRACE(BACKEND->log(AQ_LOG_TRACE, std::format("drm: crtc sequence event seq {} ns {} crtc {}", seq, ns, data)));
+
+    if (CONNECTOR->status != DRM_MODE_CONNECTED || !CONNECTOR->output)
+        return;
+
+    // a real vblank timestamp, as good as a page flip's for the predictor
+    CONNECTOR->sched.onVblank(std::chrono::steady_clock::time_point{std::chrono::nanoseconds{ns}}, (uint32_t)seq,
+                              std::chrono::nanoseconds{CONNECTOR->refresh ? 1000000000000LL / CONNECTOR->refresh : 0});
+
+    CONNECTOR->output->emitHeldFrame();
+}
+
 bool Aquamarine::CDRMBackend::dispatchEvents() {
     drmEventContext event = {
-        .version            = 3,
+        .version            = 4,
         .page_flip_handler2 = ::handlePF,
+        .sequence_handler   = ::handleSequence,
     };
 
     // drmHandleEvent -> handlePF can dispatch another gpus fd so gDispatchingBackend is the wrong backend.
@@ -1287,21 +1685,27 @@ bool Aquamarine::CDRMBackend::setCursor(SP<IBuffer> buffer, const Hyprutils::Mat
 void Aquamarine::CDRMBackend::onReady() {
     backend->log(AQ_LOG_DEBUG, std::format("drm: Connectors size2 {}", connectors.size()));
 
-    // init a drm renderer to gather gl formats.
+    // init a drm renderer to gather gl formats, unless we know them from last time.
     // if we are secondary, initMgpu will have done that
     if (!primary && rendererRequired) {
-        auto a = CGBMAllocator::create(backend->reopenDRMNode(gpu->fd), backend);
-        if (!a)
-            backend->log(AQ_LOG_ERROR, "drm: onReady: no renderer for gl formats");
-        else {
-            auto r = CDRMRenderer::attempt(backend.lock(), gpu->renderNodeFd >= 0 ? gpu->renderNodeFd : gpu->fd);
-            if (!r)
+        if (auto cached = loadGlFormatCache(); cached) {
+            TRACE(backend->log(AQ_LOG_TRACE, std::format("drm: onReady: {} gl formats from the cache", cached->size())));
+            buildGlFormats(*cached);
+        } else {
+            auto a = CGBMAllocator::create(backend->reopenDRMNode(gpu->fd), backend);
+            if (!a)
                 backend->log(AQ_LOG_ERROR, "drm: onReady: no renderer for gl formats");
             else {
-                TRACE(backend->log(AQ_LOG_TRACE, std::format("drm: onReady: gathered {} gl formats", r->formats.size())));
-                buildGlFormats(r->formats);
-                r.reset();
-                a.reset();
+                auto r = CDRMRenderer::attempt(backend.lock(), gpu->renderNodeFd >= 0 ? gpu->renderNodeFd : gpu->fd);
+                if (!r)
+                    backend->log(AQ_LOG_ERROR, "drm: onReady: no renderer for gl formats");
+                else {
+                    TRACE(backend->log(AQ_LOG_TRACE, std::format("drm: onReady: gathered {} gl formats", r->formats.size())));
+                    buildGlFormats(r->formats);
+                    saveGlFormatCache(r->formats);
+                    r.reset();
+                    a.reset();
+                }
             }
         }
     }
@@ -1393,13 +1797,23 @@ SP<IAllocator> Aquamarine::CDRMBackend::preferredAllocator() {
 }
 
 std::vector<SP<IAllocator>> Aquamarine::CDRMBackend::getAllocators() {
-    return {backend->primaryAllocator, dumbAllocator};
+    // a secondary's own one holds its mgpu swapchains, without a renderer that's the dumb one
+    std::vector<SP<IAllocator>> allocators;
+    for (auto const& a : std::initializer_list<SP<IAllocator>>{backend->primaryAllocator, dumbAllocator, rendererState.allocator}) {
+        if (a && std::ranges::find(allocators, a) == allocators.end())
+            allocators.emplace_back(a);
+    }
+    return allocators;
 }
 
 Hyprutils::Memory::CWeakPointer<IBackendImplementation> Aquamarine::CDRMBackend::getPrimary() {
     return primary;
 }
 
+bool Aquamarine::SDRMPlane::usableBy(uint32_t crtcID) {
+    return owner == 0 || owner == crtcID;
+}
+
 bool Aquamarine::SDRMPlane::init(drmModePlane* plane) {
     id = plane->plane_id;
 
@@ -1414,6 +1828,9 @@ bool Aquamarine::SDRMPlane::init(drmModePlane* plane) {
 
     initialID = id;
 
+    if (props.values.zpos)
+        getDRMProp(backend->gpu->fd, id, props.values.zpos, &zpos);
+
     backend->backend->log(AQ_LOG_DEBUG, std::format("drm: Plane {} has type {}", id, (int)type));
 
     backend->backend->log(AQ_LOG_DEBUG, std::format("drm: Plane {} has {} formats", id, plane->count_formats));
@@ -1474,6 +1891,20 @@ bool Aquamarine::SDRMPlane::init(drmModePlane* plane) {
         }
     }
 
+    // overlays can usually go on more than one crtc. List them on all of them, whoever places a layer on one
+    // first gets to keep it until it's off screen again, see owner.
+    if (type == DRM_PLANE_TYPE_OVERLAY) {
+        for (size_t i = 0; i < backend->crtcs.size(); ++i) {
+            if (!(plane->possible_crtcs & (1 << i)))
+                continue;
+
+            auto CRTC = backend->crtcs.at(i);
+            CRTC->overlays.emplace_back(self.lock());
+            std::ranges::stable_sort(CRTC->overlays, [](const auto& a, const auto& b) { return a->zpos < b->zpos; });
+            backend->backend->log(AQ_LOG_DEBUG, std::format("drm: Plane {} is an overlay for crtc {} at zpos {}", id, CRTC->id, zpos));
+        }
+    }
+
     return true;
 }
 
@@ -1600,6 +2031,16 @@ void Aquamarine::SDRMConnector::releaseFBReferences() {
             releaseFB(crtc->cursor->last);
         }
 
+        for (auto const& overlay : crtc->overlays) {
+            if (!overlay->usableBy(crtc->id))
+                continue;
+
+            releaseFB(overlay->front);
+            releaseFB(overlay->back);
+            releaseFB(overlay->last);
+            overlay->owner = 0;
+        }
+
         releaseFB(crtc->pendingCursor);
     }
 }
@@ -1916,6 +2357,30 @@ void Aquamarine::SDRMConnector::applyCommit(const SDRMConnectorCommitData& data)
             crtc->pendingCursor.reset();
     }
 
+    // overlays that didn't get a layer this commit were disabled by it, so their back goes away too
+    for (auto const& overlay : crtc->overlays) {
+        if (!overlay->usableBy(crtc->id))
+            continue;
+
+        SP<CDRMFB> fb;
+        if (enable) {
+            if (auto it = std::ranges::find_if(data.overlays, [&overlay](const auto& o) { return o.plane == overlay; }); it != data.overlays.end())
+                fb = it->fb;
+        }
+
+        if (fb == overlay->back)
+            continue;
+
+        if (overlay->back != overlay->front)
+            releaseFBBuffer(overlay->back);
+
+        overlay->back = fb;
+        if (fb) {
+            fb->buffer->lockedByBackend = true;
+            overlay->owner              = crtc->id;
+        }
+    }
+
     if (data.committed & COutputState::AQ_OUTPUT_STATE_MODE)
         refresh = calculateRefresh(data.modeInfo);
 
@@ -1947,6 +2412,12 @@ void Aquamarine::SDRMConnector::applyCommit(const SDRMConnectorCommitData& data)
 void Aquamarine::SDRMConnector::invalidateFrame() {
     sched.invalidate();
 
+    if (output)
+        output->frameDeadline.reset();
+
+    if (crtc && crtc->pendingSequence == self)
+        crtc->pendingSequence.reset();
+
     if (crtc && crtc->pendingFlip.connector == self)
         crtc->disarmPageFlip();
 }
@@ -1960,6 +2431,12 @@ void Aquamarine::SDRMConnector::setCRTC(SP<SDRMCRTC> newCRTC) {
     crtc = newCRTC;
 }
 
+void Aquamarine::SDRMConnector::onVblank(std::chrono::steady_clock::time_point when, uint32_t seq, std::chrono::nanoseconds interval) {
+    sched.onVblank(when, seq, interval);
+    if (output)
+        output->stats.onPresent(when, seq, interval);
+}
+
 void Aquamarine::SDRMConnector::onPresent() {
     if (crtc->primary->back && crtc->primary->back != crtc->primary->front) {
         crtc->primary->last  = crtc->primary->front;
@@ -1968,6 +2445,15 @@ void Aquamarine::SDRMConnector::onPresent() {
             crtc->primary->last->buffer->lockedByBackend = false;
             crtc->primary->last->buffer->events.backendRelease.emit();
         }
+
+        // ages count from here, the buffer is on screen now
+        if (output) {
+            if (output->swapchain)
+                output->swapchain->presented(output->pendingPresent.lock());
+            if (output->mgpu.swapchain)
+                output->mgpu.swapchain->presented(crtc->primary->front->buffer.lock());
+            output->pendingPresent.reset();
+        }
     }
 
     if (crtc->cursor && crtc->cursor->back && crtc->cursor->back != crtc->cursor->front) {
@@ -1978,6 +2464,23 @@ void Aquamarine::SDRMConnector::onPresent() {
             crtc->cursor->last->buffer->events.backendRelease.emit();
         }
     }
+
+    // unlike primary, an overlay's back can be null: that means it was disabled and front is off screen now.
+    for (auto const& overlay : crtc->overlays) {
+        if (!overlay->usableBy(crtc->id) || overlay->back == overlay->front)
+            continue;
+
+        overlay->last  = overlay->front;
+        overlay->front = overlay->back;
+        if (overlay->last && overlay->last->buffer) {
+            overlay->last->buffer->lockedByBackend = false;
+            overlay->last->buffer->events.backendRelease.emit();
+        }
+
+        // off screen now, other crtcs can have it
+        if (!overlay->front)
+            overlay->owner = 0;
+    }
 }
 
 Aquamarine::CDRMOutput::~CDRMOutput() {
@@ -1990,6 +2493,7 @@ Aquamarine::CDRMOutput::~CDRMOutput() {
 void Aquamarine::CDRMOutput::releaseMgpuResources() {
     mgpu.swapchain.reset();
     mgpu.cursorSwapchain.reset();
+    mgpu.blitDamage.clear();
 
     if (swapchain) {
         auto options   = swapchain->currentOptions();
@@ -2011,7 +2515,55 @@ void Aquamarine::CDRMOutput::setCursorVisible(bool visible) {
     scheduleFrame(AQ_SCHEDULE_CURSOR_VISIBLE);
 }
 
+// the fallback for secondaries without a renderer: map both sides and copy on the cpu. Blocks, including on waitFD.
+static CDRMRenderer::SBlitResult cpuBlit(SP<CCPUBlitter> blitter, SP<IBuffer> from, SP<IBuffer> to, int waitFD, const CRegion& damage) {
+    if (waitFD >= 0) {
+        // the consumer's render may still be going, nobody else to wait on it for us
+        pollfd pfd = {.fd = waitFD, .events = POLLIN, .revents = 0};
+        if (poll(&pfd, 1, 1000) <= 0)
+            return {};
+    }
+
+    // damage that's all outside of the buffers leaves nothing to copy, which isn't a failed blit
+    if (!damage.empty() && damage.copy().intersect(CBox{{}, from->size}).intersect(CBox{{}, to->size}).empty())
+        return {.success = true};
+
+    // only the damage gets synced / detiled, and mappings that can stay around between frames do
+    const auto  SRC = from->beginDataRange(damage, BUFFER_DATA_READ);
+    const auto  DST = to->beginDataRange(damage, BUFFER_DATA_WRITE);
+    CScopeGuard unmap([&] {
+        from->endDataRange();
+        to->endDataRange();
+    });
+
+    if (!SRC.data || !DST.data || SRC.box != DST.box)
+        return {};
+
+    // both images start at the box now
+    const SCPUBlitImage FROM   = {.data = SRC.data, .stride = SRC.stride, .format = SRC.format, .size = SRC.box.size()};
+    const SCPUBlitImage TO     = {.data = DST.data, .stride = DST.stride, .format = DST.format, .size = DST.box.size(), .writeCombined = DST.writeCombined};
+    const CRegion       DAMAGE = damage.empty() ? CRegion{} : damage.copy().translate({-SRC.box.x, -SRC.box.y});
+
+    return {.success = blitter->blit(FROM, TO, DAMAGE)};
+}
+
 bool Aquamarine::CDRMOutput::commitState(bool onlyTest) {
+    uint32_t flags = 0;
+    if (!checkState(onlyTest, flags))
+        return false;
+
+    // we can't go further without a blit
+    if (backend->primary && onlyTest)
+        return true;
+
+    SDRMConnectorCommitData data;
+    if (!prepareCommit(data, flags, onlyTest))
+        return false;
+
+    return finishCommit(data, commitData(data, onlyTest), onlyTest);
+}
+
+bool Aquamarine::CDRMOutput::checkState(bool onlyTest, uint32_t& flags) {
     if (!backend->backend->session->active) {
         backend->backend->log(AQ_LOG_ERROR, "drm: Session inactive");
         return false;
@@ -2077,15 +2629,11 @@ bool Aquamarine::CDRMOutput::commitState(bool onlyTest) {
     // which may result in some glitches
     const bool NEEDS_RECONFIG = state->needsReconfig();
 
-    const bool BLOCKING = NEEDS_RECONFIG || !(COMMITTED & COutputState::eOutputStateProperties::AQ_OUTPUT_STATE_BUFFER);
-
     const auto MODE = STATE.mode ? STATE.mode : STATE.customMode;
 
     if (!MODE) // modeless commits are invalid
         return false;
 
-    uint32_t flags = 0;
-
     if (!onlyTest) {
         if (NEEDS_RECONFIG) {
             if (STATE.enabled)
@@ -2114,11 +2662,15 @@ bool Aquamarine::CDRMOutput::commitState(bool onlyTest) {
             flags |= DRM_MODE_PAGE_FLIP_ASYNC;
     }
 
-    // we can't go further without a blit
-    if (backend->primary && onlyTest)
-        return true;
+    return true;
+}
 
-    SDRMConnectorCommitData data;
+bool Aquamarine::CDRMOutput::prepareCommit(SDRMConnectorCommitData& data, uint32_t flags, bool onlyTest) {
+    const auto&    STATE          = state->state();
+    const uint32_t COMMITTED      = STATE.committed;
+    const bool     NEEDS_RECONFIG = state->needsReconfig();
+    const bool     BLOCKING       = NEEDS_RECONFIG || !(COMMITTED & COutputState::eOutputStateProperties::AQ_OUTPUT_STATE_BUFFER);
+    const auto     MODE           = STATE.mode ? STATE.mode : STATE.customMode;
 
     // A commit that carries no new buffer has nothing to blit: STATE.buffer is the one we already copied
     SP<CDRMFB> blittedFB;
@@ -2128,6 +2680,13 @@ bool Aquamarine::CDRMOutput::commitState(bool onlyTest) {
             blittedFB = LAST;
     }
 
+    // whatever happens, don't leave the blit unresolved
+    bool        prepared = false;
+    CScopeGuard blitGuard([&] {
+        if (!prepared)
+            data.awaitBlit();
+    });
+
     if (STATE.buffer && STATE.enabled) {
         TRACE(backend->backend->log(AQ_LOG_TRACE, "drm: Committed a buffer, updating state"));
 
@@ -2136,9 +2695,9 @@ bool Aquamarine::CDRMOutput::commitState(bool onlyTest) {
         if (blittedFB)
             drmFB = blittedFB;
         else if (backend->shouldBlit()) {
-            if (!backend->rendererState.renderer) {
+            if (!backend->rendererState.renderer && !backend->rendererState.cpuBlitter) {
                 backend->backend->log(AQ_LOG_DEBUG, "drm: No renderer attached to backend when required for blitting, initializing");
-                if (!backend->initMgpu() || !backend->rendererState.renderer || !backend->rendererState.allocator) {
+                if (!backend->initMgpu() || (!backend->rendererState.renderer && !backend->rendererState.cpuBlitter) || !backend->rendererState.allocator) {
                     backend->backend->log(AQ_LOG_ERROR, "drm: Failed to initialize renderer backend for blitting");
                     return false;
                 }
@@ -2156,6 +2715,9 @@ bool Aquamarine::CDRMOutput::commitState(bool onlyTest) {
             OPTIONS.size = STATE.buffer->size;
             if (OPTIONS.format == DRM_FORMAT_INVALID)
                 OPTIONS.format = bufDma.format;
+            // the cpu copy can only go down to 8 bit, the mismatch with the state format then modesets below
+            if (backend->rendererState.cpuBlitter && !CCPUBlitter::supported(bufDma.format, OPTIONS.format))
+                OPTIONS.format = DRM_FORMAT_XRGB8888;
             OPTIONS.multigpu = false; // this is not a shared swapchain, and additionally, don't make it linear, nvidia would be mad
             OPTIONS.cursor   = false;
             OPTIONS.scanout  = true;
@@ -2166,29 +2728,80 @@ bool Aquamarine::CDRMOutput::commitState(bool onlyTest) {
                 return false;
             }
 
-            auto NEWAQBUF = mgpu.swapchain->next(nullptr);
+            int  age      = 0;
+            auto NEWAQBUF = mgpu.swapchain->next(&age);
             if (!NEWAQBUF) {
                 backend->backend->log(AQ_LOG_ERROR, "drm: Backend requires blit, but the mgpu swapchain has no buffer");
                 return false;
             }
 
+            // NEWAQBUF holds the frame from the last time we blitted into it, so it's enough to copy what changed since.
+            // If we don't know when that was, or the consumer gave no damage, copy it all.
+            static const auto NO_PARTIAL_BLIT = envEnabled("AQ_MGPU_NO_PARTIAL_BLIT");
+            const bool        HAS_DAMAGE      = (COMMITTED & COutputState::eOutputStateProperties::AQ_OUTPUT_STATE_DAMAGE) && !STATE.damage.empty();
+            CRegion           blitDamage;
+            if (HAS_DAMAGE && !NO_PARTIAL_BLIT) {
+                bool found = false;
+                blitDamage = STATE.damage.copy();
+                for (size_t i = 0; i < mgpu.blitDamage.size() && std::cmp_less(i, age); ++i) {
+                    if (mgpu.blitDamage.at(i).buffer.lock() == NEWAQBUF) {
+                        found = true;
+                        break;
+                    }
+
+                    blitDamage.add(mgpu.blitDamage.at(i).damage);
+                }
+
+                if (!found)
+                    blitDamage.clear();
+            }
+
             SP<Aquamarine::CDRMRenderer> primaryRenderer;
             if (backend->primary)
                 primaryRenderer = backend->primary->rendererState.renderer;
-            auto blitResult = backend->rendererState.renderer->blit(
-                STATE.buffer, NEWAQBUF, primaryRenderer, (COMMITTED & COutputState::eOutputStateProperties::AQ_OUTPUT_STATE_EXPLICIT_IN_FENCE) ? STATE.explicitInFence : -1);
-            if (!blitResult.success) {
-                backend->backend->log(AQ_LOG_ERROR, "drm: Backend requires blit, but blit failed");
-                return false;
-            }
+            const bool EXPLICIT   = COMMITTED & COutputState::eOutputStateProperties::AQ_OUTPUT_STATE_EXPLICIT_IN_FENCE;
+            const int  WAIT_FD    = EXPLICIT ? STATE.explicitInFence : -1;
+            const auto BLIT_START = std::chrono::steady_clock::now();
+
+            std::shared_future<CDRMRenderer::SBlitResult> blit;
+            if (backend->rendererState.cpuBlitter) {
+                std::promise<CDRMRenderer::SBlitResult> done;
+                done.set_value(cpuBlit(backend->rendererState.cpuBlitter, STATE.buffer, NEWAQBUF, WAIT_FD, blitDamage));
+                blit = done.get_future().share();
+            } else
+                blit = backend->rendererState.renderer->blitAsync(STATE.buffer, NEWAQBUF, primaryRenderer, WAIT_FD, blitDamage);
+
+            // with a render thread the draw runs while we import the fb, place layers and test, until the commit asks for the fence
+            data.pendingBlit = [this, blit, EXPLICIT, BLIT_START, buffer = WP<IBuffer>{NEWAQBUF}, ringLength = OPTIONS.length,
+                                written = HAS_DAMAGE ? STATE.damage.copy() : CRegion{CBox{{}, STATE.buffer->size}}]() -> bool {
+                const auto RESULT = blit.get();
+                if (backend->rendererState.renderer)
+                    backend->rendererState.renderer->flushLogs();
+                stats.onBlit(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - BLIT_START));
+
+                if (!RESULT.success) {
+                    backend->backend->log(AQ_LOG_ERROR, "drm: Backend requires blit, but blit failed");
+                    mgpu.blitDamage.clear();
+                    return false;
+                }
 
-            // replace the explicit in fence if the blitting backend returned one, otherwise discard old. Passed fence from the client is wrong.
-            // if the commit doesn't have an explicit fence, don't use the one we created, just fallback to implicit
-            static auto NO_EXPLICIT = envEnabled("AQ_MGPU_NO_EXPLICIT");
-            if (blitResult.syncFD.has_value() && !NO_EXPLICIT && (COMMITTED & COutputState::eOutputStateProperties::AQ_OUTPUT_STATE_EXPLICIT_IN_FENCE))
-                state->setExplicitInFence(blitResult.syncFD.value());
-            else
-                state->setExplicitInFence(-1);
+                auto& entry  = *mgpu.blitDamage.emplace(mgpu.blitDamage.begin());
+                entry.buffer = buffer;
+                entry.damage = written;
+                if (mgpu.blitDamage.size() > ringLength)
+                    mgpu.blitDamage.resize(ringLength);
+
+                // replace the explicit in fence if the blitting backend returned one, otherwise discard old. Passed fence from the client is wrong.
+                // if the commit doesn't have an explicit fence, don't use the one we created, just fallback to implicit
+                static auto NO_EXPLICIT = envEnabled("AQ_MGPU_NO_EXPLICIT");
+                if (RESULT.syncFD.has_value() && !NO_EXPLICIT && EXPLICIT) {
+                    mgpu.blitFence = Hyprutils::OS::CFileDescriptor{fcntl(RESULT.syncFD.value(), F_DUPFD_CLOEXEC, 0)};
+                    state->setExplicitInFence(mgpu.blitFence.isValid() ? mgpu.blitFence.get() : -1);
+                } else
+                    state->setExplicitInFence(-1);
+
+                return true;
+            };
 
             drmFB = CDRMFB::create(NEWAQBUF, backend, nullptr); // will return attachment if present
         } else
@@ -2241,6 +2854,30 @@ bool Aquamarine::CDRMOutput::commitState(bool onlyTest) {
     if (COMMITTED & COutputState::eOutputStateProperties::AQ_OUTPUT_STATE_HDR)
         data.hdrMetadata = STATE.hdrMetadata;
 
+    // async flips may only touch the primary fb, so layers go back to the consumer for those
+    if ((COMMITTED & COutputState::eOutputStateProperties::AQ_OUTPUT_STATE_LAYERS) && STATE.enabled && data.mainFB && !(flags & DRM_MODE_PAGE_FLIP_ASYNC) && maxLayers() > 0) {
+        for (size_t i = 0; i < STATE.layers.size(); ++i) {
+            const auto& LAYER = STATE.layers.at(i);
+            if (!LAYER.buffer || LAYER.dst.empty() || LAYER.buffer->attachments.has<CDRMBufferUnimportable>())
+                continue;
+
+            auto fb = CDRMFB::create(LAYER.buffer, backend, nullptr);
+            if (!fb || fb->dead)
+                continue;
+
+            data.overlays.emplace_back(SDRMConnectorCommitData::SOverlay{
+                .fb      = fb,
+                .src     = LAYER.src.empty() ? CBox{{}, LAYER.buffer->size} : LAYER.src,
+                .dst     = LAYER.dst,
+                .inFence = LAYER.inFence,
+                .layer   = i,
+            });
+        }
+
+        // the atomic impl places layers top-down
+        std::ranges::stable_sort(data.overlays, [&STATE](const auto& a, const auto& b) { return STATE.layers.at(a.layer).z > STATE.layers.at(b.layer).z; });
+    }
+
     data.blocking  = BLOCKING || formatMismatch;
     data.modeset   = NEEDS_RECONFIG || lastCommitNoBuffer || formatMismatch;
     data.flags     = flags;
@@ -2259,12 +2896,11 @@ bool Aquamarine::CDRMOutput::commitState(bool onlyTest) {
     // so drivers without plane scaling (e.g. virtio-gpu) reject stale-size buffers,
     // making larger modes unreachable.
     // If the consumer already reconfigured the swapchain to the new size, attach a fresh buffer from it.
-    bool acquiredModesetBuffer = false;
     if (data.modeset && data.mainFB && swapchain && data.mainFB->buffer->size != MODE->pixelSize && swapchain->currentOptions().size == MODE->pixelSize) {
         if (auto newBuf = swapchain->next(nullptr); newBuf) {
             if (auto newFB = CDRMFB::create(newBuf, backend, nullptr); newFB && !newFB->dead) {
-                data.mainFB           = newFB;
-                acquiredModesetBuffer = true;
+                data.mainFB                = newFB;
+                data.acquiredModesetBuffer = true;
             } else
                 swapchain->rollback();
         }
@@ -2276,33 +2912,75 @@ bool Aquamarine::CDRMOutput::commitState(bool onlyTest) {
     if (shouldSubmitCTM(connector, STATE, data.modeset))
         data.ctm = STATE.ctm;
 
-    bool ok = connector->commitState(data);
+    prepared = true;
+    return true;
+}
 
-    // a buffer acquired only to validate/attempt the modeset isn't consumed by the
-    // consumer: rewind the swapchain so the acquire cursor stays in sync with it.
-    if (acquiredModesetBuffer && (onlyTest || !ok))
-        swapchain->rollback();
+bool Aquamarine::CDRMOutput::commitData(SDRMConnectorCommitData& data, bool onlyTest) {
+    bool ok = connector->commitState(data);
 
     if (!ok && !data.modeset && !connector->commitTainted) {
         // attempt to re-modeset, however, flip a tainted flag if the modesetting fails
         // to avoid doing this over and over.
-        data.modeset  = true;
-        data.blocking = true;
-        data.flags    = onlyTest ? 0 : DRM_MODE_PAGE_FLIP_EVENT;
-        ok            = connector->commitState(data);
+        data.modeset       = true;
+        data.forcedModeset = true;
+        data.blocking      = true;
+        data.flags         = onlyTest ? 0 : DRM_MODE_PAGE_FLIP_EVENT;
+        ok                 = connector->commitState(data);
 
         if (!ok)
             connector->commitTainted = true;
     }
 
+    return ok;
+}
+
+bool Aquamarine::CDRMOutput::finishCommit(SDRMConnectorCommitData& data, bool ok, bool onlyTest) {
+    // a commit that failed before it got to the blit still has it in flight
+    data.awaitBlit();
+
+    // a buffer acquired only to validate/attempt the modeset isn't consumed by the
+    // consumer: rewind the swapchain so the acquire cursor stays in sync with it.
+    if (data.acquiredModesetBuffer && (onlyTest || !ok))
+        swapchain->rollback();
+
+    for (auto& l : state->internalState.layers) {
+        l.accepted = false;
+    }
+
+    if (ok) {
+        for (auto const& o : data.overlays) {
+            if (o.plane)
+                state->internalState.layers.at(o.layer).accepted = true;
+        }
+    }
+
+    if (onlyTest)
+        stats.onTestCommit();
+
+    // the consumer's next damage may not account for a frame that never made it, start the blits over
+    if (!ok) {
+        mgpu.blitDamage.clear();
+        stats.onFailedCommit();
+    }
+
     if (onlyTest || !ok)
         return ok;
 
+    if (data.modeset)
+        stats.onModeset();
+    if (data.flags & DRM_MODE_PAGE_FLIP_ASYNC)
+        stats.onAsyncCommit();
+    else if (data.mainFB && (data.flags & DRM_MODE_PAGE_FLIP_EVENT))
+        stats.onCommit(std::chrono::steady_clock::now());
+
     events.commit.emit();
     state->onCommit();
 
     lastCommitNoBuffer = !data.mainFB;
     needsFrame         = false;
+    if (data.mainFB)
+        pendingPresent = data.acquiredModesetBuffer || !backend->shouldBlit() ? data.mainFB->buffer.lock() : state->state().buffer;
 
     if (ok)
         connector->commitTainted = false;
@@ -2365,9 +3043,10 @@ bool Aquamarine::CDRMOutput::setCursor(SP<IBuffer> buffer, const Vector2D& hotsp
         if (backend->primary) {
             TRACE(backend->backend->log(AQ_LOG_TRACE, "drm: Backend requires cursor blit, blitting"));
 
-            if (!backend->rendererState.renderer || !backend->rendererState.allocator) {
+            const auto INITIALIZED = [this] { return (backend->rendererState.renderer || backend->rendererState.cpuBlitter) && backend->rendererState.allocator; };
+            if (!INITIALIZED()) {
                 backend->backend->log(AQ_LOG_DEBUG, "drm: No renderer attached to backend when required for cursor blitting, initializing");
-                if (!backend->initMgpu() || !backend->rendererState.renderer || !backend->rendererState.allocator) {
+                if (!backend->initMgpu() || !INITIALIZED()) {
                     backend->backend->log(AQ_LOG_ERROR, "drm: Failed to initialize renderer backend for cursor blitting");
                     return false;
                 }
@@ -2391,7 +3070,12 @@ bool Aquamarine::CDRMOutput::setCursor(SP<IBuffer> buffer, const Vector2D& hotsp
             OPTIONS.size       = SIZE;
             OPTIONS.length     = 2;
 
-            if (!mgpu.cursorSwapchain->reconfigure(OPTIONS)) {
+            // a new format comes in off the main thread, the cursor keeps being blitted into the current buffers until then.
+            // Not for a new size, the blit would scale the cursor into the old one.
+            const auto& CURRENT = mgpu.cursorSwapchain->currentOptions();
+            if (CURRENT.length > 0 && CURRENT.size == OPTIONS.size)
+                mgpu.cursorSwapchain->reconfigureAsync(OPTIONS);
+            else if (!mgpu.cursorSwapchain->reconfigure(OPTIONS)) {
                 backend->backend->log(AQ_LOG_ERROR, "drm: Backend requires blit, but the mgpu cursorSwapchain failed reconfiguring");
                 return false;
             }
@@ -2405,7 +3089,9 @@ bool Aquamarine::CDRMOutput::setCursor(SP<IBuffer> buffer, const Vector2D& hotsp
             SP<Aquamarine::CDRMRenderer> primaryRenderer;
             if (backend->primary)
                 primaryRenderer = backend->primary->rendererState.renderer;
-            if (!backend->rendererState.renderer->blit(buffer, NEWAQBUF, primaryRenderer).success) {
+            const auto RESULT = backend->rendererState.cpuBlitter ? cpuBlit(backend->rendererState.cpuBlitter, buffer, NEWAQBUF, -1, {}) :
+                                                                    backend->rendererState.renderer->blit(buffer, NEWAQBUF, primaryRenderer);
+            if (!RESULT.success) {
                 backend->backend->log(AQ_LOG_ERROR, "drm: Backend requires blit, but cursor blit failed");
                 return false;
             }
@@ -2459,6 +3145,9 @@ void Aquamarine::CDRMOutput::scheduleFrame(const scheduleFrameReason reason) {
     if (!connector->sched.canSchedule())
         return;
 
+    if (deferFrame() || queueSequenceFrame())
+        return;
+
     connector->sched.setFrameScheduled(true);
 
     if (!frameIdle) {
@@ -2484,6 +3173,64 @@ void Aquamarine::CDRMOutput::scheduleFrame(const scheduleFrameReason reason) {
     backend->backend->addIdleEvent(frameIdle);
 }
 
+bool Aquamarine::CDRMOutput::deferFrame() {
+    // with vrr the next vblank is wherever our commit lands, nothing to wait for
+    if (!backend->frameTimerFD.isValid() || state->state().adaptiveSync)
+        return false;
+
+    const auto WHEN = connector->sched.frameEventTime(std::chrono::steady_clock::now());
+    if (!WHEN)
+        return false;
+
+    TRACE(backend->backend->log(
+        AQ_LOG_TRACE,
+        std::format("drm: holding the frame for {} back by {}us", name,
+                    std::chrono::duration_cast<std::chrono::microseconds>(*WHEN - std::chrono::steady_clock::now()).count())));
+
+    connector->sched.setFrameScheduled(true);
+    frameDeadline = WHEN;
+    backend->updateFrameTimer();
+
+    return true;
+}
+
+bool Aquamarine::CDRMOutput::queueSequenceFrame() {
+    if (!backend->drmProps.vblankIdleFrames || !connector->crtc)
+        return false;
+
+    uint64_t queued = 0;
+    if (drmCrtcQueueSequence(backend->gpu->fd, connector->crtc->id, DRM_CRTC_SEQUENCE_RELATIVE | DRM_CRTC_SEQUENCE_NEXT_ON_MISS, 1, &queued, connector->crtc->id)) {
+        // crtc off, or a driver without vblank interrupts (nvidia without vblank=1). The idle timer it is.
+        TRACE(backend->backend->log(AQ_LOG_TRACE, std::format("drm: couldn't queue a crtc sequence for {}: {}", name, strerror(errno))));
+        return false;
+    }
+
+    TRACE(backend->backend->log(AQ_LOG_TRACE, std::format("drm: idle frame for {} queued on vblank {}", name, queued)));
+
+    connector->sched.setFrameScheduled(true);
+    connector->crtc->pendingSequence = connector;
+
+    return true;
+}
+
+void Aquamarine::CDRMOutput::emitHeldFrame() {
+    connector->sched.setFrameScheduled(false);
+
+    if (!enabledState || !backend->sessionActive() || connector->sched.frameInFlight() || connector->sched.frameRunning())
+        return;
+
+    CFrameRunningGuard frameRunning(connector->sched);
+    connector->sched.frameReady.emit();
+}
+
+void Aquamarine::CDRMOutput::setRenderDeadline(std::chrono::nanoseconds deadline) {
+    connector->sched.setRenderDeadline(deadline);
+}
+
+std::optional<std::chrono::steady_clock::time_point> Aquamarine::CDRMOutput::predictedVblank() {
+    return connector->sched.predictNextVblank(std::chrono::steady_clock::now());
+}
+
 Vector2D Aquamarine::CDRMOutput::cursorPlaneSize() {
     return backend->drmProps.cursorSize;
 }
@@ -2544,6 +3291,13 @@ bool Aquamarine::CDRMOutput::pendingIdleFrame() {
     return connector->sched.frameScheduled();
 }
 
+size_t Aquamarine::CDRMOutput::maxLayers() {
+    // legacy can't do overlays, and mgpu would need every layer blitted, which defeats the point
+    if (!backend->atomic || backend->shouldBlit() || !connector->crtc)
+        return 0;
+    return std::ranges::count_if(connector->crtc->overlays, [this](const auto& p) { return p->usableBy(connector->crtc->id); });
+}
+
 int Aquamarine::CDRMOutput::getConnectorID() {
     return connector->id;
 }
@@ -2553,7 +3307,11 @@ Aquamarine::CDRMOutput::CDRMOutput(const std::string& name_, Hyprutils::Memory::
     name = name_;
 
     // The scheduler's frameReady signal drives the public events.frame on this output.
-    frameReadyListener = connector->sched.frameReady.listen([this]() { events.frame.emit(); });
+    // Rendering starts here as far as the render time estimate is concerned.
+    frameReadyListener = connector->sched.frameReady.listen([this]() {
+        connector->sched.onRenderStart();
+        events.frame.emit();
+    });
 
     // scheduled from inside a running frame, schedule it once the running frame is done.
     rescheduleListener = connector->sched.rescheduleNeeded.listen([this]() { scheduleFrame(AQ_SCHEDULE_NEEDS_FRAME); });
@@ -2692,8 +3450,11 @@ void Aquamarine::CDRMFB::drop() {
     TRACE(backend->backend->log(AQ_LOG_TRACE, std::format("drm: dropping buffer {}", id)));
 
     int ret = drmModeCloseFB(backend->gpu->fd, id);
-    if (ret == -EINVAL)
+    if (ret == -EINVAL) {
         ret = drmModeRmFB(backend->gpu->fd, id);
+        // RmFB turns off any plane still scanning this out behind our back
+        backend->forgetShadowFB(id);
+    }
 
     if (ret)
         backend->backend->log(AQ_LOG_ERROR, std::format("drm: Failed to close a buffer: {}", strerror(-ret)));
@@ -2739,6 +3500,14 @@ uint32_t Aquamarine::CDRMFB::submitBuffer() {
     return newID;
 }
 
+bool Aquamarine::SDRMConnectorCommitData::awaitBlit() {
+    if (!blitResult)
+        blitResult = pendingBlit ? pendingBlit() : true;
+
+    pendingBlit = nullptr;
+    return *blitResult;
+}
+
 void Aquamarine::SDRMConnectorCommitData::calculateMode(Hyprutils::Memory::CSharedPointer<SDRMConnector> connector) {
     if (!connector || !connector->output || !connector->output->state)
         return;
@@ -2844,6 +3613,9 @@ SP<CDRMLease> Aquamarine::CDRMLease::create(std::vector<SP<IOutput>> outputs) {
         o->lease = lease;
     }
 
+    backend->testResults.clear();
+    backend->shadowProps.clear();
+
     lease->leaseFD = leaseFD;
     lease->backend = backend;
 
@@ -2865,6 +3637,9 @@ void Aquamarine::CDRMLease::terminate() {
     if (drmModeRevokeLease(backend->gpu->fd, lesseeID) < 0)
         backend->log(AQ_LOG_ERROR, "drm lease: Failed to revoke lease");
 
+    backend->testResults.clear();
+    backend->shadowProps.clear(); // the lessee's state stays on the objects we get back
+
     destroy();
 }
 
@@ -75,6 +75,7 @@ static const struct prop_info plane_info[] = {
     {.name = "SRC_Y", .index = INDEX(src_y)},
     {.name = "rotation", .index = INDEX(rotation)},
     {.name = "type", .index = INDEX(type)},
+    {.name = "zpos", .index = INDEX(zpos)},
 #undef INDEX
 };
 
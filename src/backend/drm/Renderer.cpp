@@ -26,9 +26,9 @@ using namespace Hyprutils::OS;
         if (Aquamarine::isTrace()) {                                                                                                                                               \
             auto err = glGetError();                                                                                                                                               \
             if (err != GL_NO_ERROR) {                                                                                                                                              \
-                backend->log(AQ_LOG_ERROR,                                                                                                                                         \
-                             std::format("[GLES] Error in call at {}@{}: 0x{:x}", __LINE__,                                                                                        \
-                                         ([]() constexpr -> std::string { return std::string(__FILE__).substr(std::string(__FILE__).find_last_of('/') + 1); })(), err));           \
+                log(AQ_LOG_ERROR,                                                                                                                                                  \
+                    std::format("[GLES] Error in call at {}@{}: 0x{:x}", __LINE__,                                                                                                 \
+                                ([]() constexpr -> std::string { return std::string(__FILE__).substr(std::string(__FILE__).find_last_of('/') + 1); })(), err));                    \
             }                                                                                                                                                                      \
         }                                                                                                                                                                          \
     }
@@ -55,7 +55,7 @@ static GLuint compileShader(const GLuint& type, std::string src) {
     return shader;
 }
 
-static GLuint createProgram(const std::string& vert, const std::string& frag) {
+static GLuint createProgram(const std::string& vert, const std::string& frag, bool retrievable = false) {
     auto vertCompiled = compileShader(GL_VERTEX_SHADER, vert);
     if (vertCompiled == 0)
         return 0;
@@ -67,6 +67,8 @@ static GLuint createProgram(const std::string& vert, const std::string& frag) {
     auto prog = glCreateProgram();
     glAttachShader(prog, vertCompiled);
     glAttachShader(prog, fragCompiled);
+    if (retrievable)
+        glProgramParameteri(prog, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(prog);
 
     glDetachShader(prog, vertCompiled);
@@ -125,6 +127,16 @@ void main() {
     fragColor = texture(texture0, v_texcoord);
 })#";
 
+// ------------------- program binary cache
+
+struct SProgramBinaryHeader {
+    uint32_t magic   = 0x42505141; // AQPB
+    uint32_t version = 1;
+    uint64_t key     = 0;
+    uint32_t format  = 0;
+    uint32_t length  = 0;
+};
+
 // ------------------- egl stuff
 
 static inline void loadGLProc(void* pProc, const char* name) {
@@ -382,6 +394,17 @@ bool CDRMRenderer::initDRMFormats() {
 }
 
 Aquamarine::CDRMRenderer::~CDRMRenderer() {
+    // runs what's still queued and gives the context back
+    stopThread();
+
+    if (egl.display && egl.context && readback.pbos[0] && eglMakeCurrent(egl.display, EGL_NO_SURFACE, EGL_NO_SURFACE, egl.context)) {
+        for (auto& f : readback.fences) {
+            if (f)
+                glDeleteSync(f);
+        }
+        glDeleteBuffers(readback.pbos.size(), readback.pbos.data());
+    }
+
     if (egl.display)
         eglMakeCurrent(egl.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
 
@@ -549,7 +572,7 @@ void CDRMRenderer::initResources() {
     if (!exts.EXT_image_dma_buf_import || !initDRMFormats())
         backend->log(AQ_LOG_ERROR, "CDRMRenderer: initDRMFormats failed, dma-buf won't work");
 
-    shader.program = createProgram(VERT_SRC, FRAG_SRC);
+    shader.program = loadProgram(VERT_SRC, FRAG_SRC);
     if (shader.program == 0)
         backend->log(AQ_LOG_ERROR, "CDRMRenderer: texture shader failed");
 
@@ -559,7 +582,7 @@ void CDRMRenderer::initResources() {
     shader.tex       = glGetUniformLocation(shader.program, "tex");
     shader.createVao();
 
-    shaderExt.program = createProgram(VERT_SRC, FRAG_SRC_EXT);
+    shaderExt.program = loadProgram(VERT_SRC, FRAG_SRC_EXT);
     if (shaderExt.program == 0)
         backend->log(AQ_LOG_ERROR, "CDRMRenderer: external texture shader failed");
 
@@ -570,6 +593,72 @@ void CDRMRenderer::initResources() {
     shaderExt.createVao();
 }
 
+GLuint CDRMRenderer::loadProgram(const std::string& vert, const std::string& frag) {
+    static const auto NO_CACHE = envEnabled("AQ_NO_SHADER_CACHE");
+
+    GLint binaryFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
+
+    const auto DIR = NO_CACHE || binaryFormats <= 0 ? std::nullopt : cacheDir("shaders");
+    if (!DIR)
+        return createProgram(vert, frag);
+
+    // a binary is only good for the exact driver build that made it, GL_VERSION carries the mesa / driver version
+    const auto DRIVER = std::format("{}\n{}\n{}", (const char*)glGetString(GL_VENDOR), (const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION));
+    const auto KEY    = hashCombine(hashCombine(hashBytes(DRIVER.data(), DRIVER.size()), hashBytes(vert.data(), vert.size())), hashBytes(frag.data(), frag.size()));
+    const auto PATH   = *DIR / std::format("{:016x}.bin", KEY);
+
+    if (const auto CACHED = readCacheFile(PATH); CACHED && CACHED->size() > sizeof(SProgramBinaryHeader)) {
+        SProgramBinaryHeader header;
+        memcpy(&header, CACHED->data(), sizeof(header));
+
+        if (header.magic == SProgramBinaryHeader{}.magic && header.version == SProgramBinaryHeader{}.version && header.key == KEY &&
+            header.length == CACHED->size() - sizeof(header)) {
+            auto prog = glCreateProgram();
+            glProgramBinary(prog, header.format, CACHED->data() + sizeof(header), header.length);
+
+            // the driver is free to reject it, e.g. after an update that kept the version string
+            GLint ok = GL_FALSE;
+            glGetProgramiv(prog, GL_LINK_STATUS, &ok);
+            if (ok == GL_TRUE) {
+                TRACE(backend->log(AQ_LOG_TRACE, std::format("CDRMRenderer: loaded program {:016x} from the cache", KEY)));
+                return prog;
+            }
+
+            glDeleteProgram(prog);
+        }
+
+        backend->log(AQ_LOG_DEBUG, std::format("CDRMRenderer: cached program {:016x} is stale, recompiling", KEY));
+    }
+
+    auto prog = createProgram(vert, frag, true);
+    if (!prog)
+        return 0;
+
+    GLint length = 0;
+    glGetProgramiv(prog, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return prog;
+
+    std::vector<uint8_t> file(sizeof(SProgramBinaryHeader) + length);
+    SProgramBinaryHeader header;
+    GLenum               format = 0;
+    glGetProgramBinary(prog, length, &length, &format, file.data() + sizeof(header));
+    if (glGetError() != GL_NO_ERROR || length <= 0)
+        return prog;
+
+    header.key    = KEY;
+    header.format = format;
+    header.length = length;
+    memcpy(file.data(), &header, sizeof(header));
+    file.resize(sizeof(header) + length);
+
+    if (!writeCacheFile(PATH, file))
+        backend->log(AQ_LOG_DEBUG, std::format("CDRMRenderer: couldn't write {} to the program cache", PATH.string()));
+
+    return prog;
+}
+
 SP<CDRMRenderer> CDRMRenderer::attempt(SP<CBackend> backend_, int drmFD) {
     SP<CDRMRenderer> renderer = SP<CDRMRenderer>(new CDRMRenderer());
     renderer->drmFD           = drmFD;
@@ -680,9 +769,9 @@ EGLImageKHR CDRMRenderer::createEGLImage(const SDMABUFAttrs& attrs) {
     attribs[idx++] = EGL_LINUX_DRM_FOURCC_EXT;
     attribs[idx++] = attrs.format;
 
-    TRACE(backend->log(AQ_LOG_TRACE,
-                       std::format("EGL: createEGLImage: size {} with format {} and modifier 0x{:x} : {}", attrs.size, fourccToName(attrs.format), attrs.modifier,
-                                   drmModifierToName(attrs.modifier))));
+    TRACE(log(AQ_LOG_TRACE,
+              std::format("EGL: createEGLImage: size {} with format {} and modifier 0x{:x} : {}", attrs.size, fourccToName(attrs.format), attrs.modifier,
+                          drmModifierToName(attrs.modifier))));
 
     struct {
         EGLint fd;
@@ -734,7 +823,7 @@ EGLImageKHR CDRMRenderer::createEGLImage(const SDMABUFAttrs& attrs) {
 
     EGLImageKHR image = proc.eglCreateImageKHR(egl.display, EGL_NO_CONTEXT, EGL_LINUX_DMA_BUF_EXT, nullptr, attribs.data());
     if (image == EGL_NO_IMAGE_KHR) {
-        backend->log(AQ_LOG_ERROR, std::format("EGL: EGLCreateImageKHR failed: {}", eglGetError()));
+        log(AQ_LOG_ERROR, std::format("EGL: EGLCreateImageKHR failed: {}", eglGetError()));
         return EGL_NO_IMAGE_KHR;
     }
 
@@ -748,7 +837,7 @@ CGLTex CDRMRenderer::glTex(Hyprutils::Memory::CSharedPointer<IBuffer> buffa) {
 
     tex.image = createEGLImage(dma);
     if (tex.image == EGL_NO_IMAGE_KHR) {
-        backend->log(AQ_LOG_ERROR, std::format("EGL (glTex): createEGLImage failed: {}", eglGetError()));
+        log(AQ_LOG_ERROR, std::format("EGL (glTex): createEGLImage failed: {}", eglGetError()));
         return tex;
     }
 
@@ -757,7 +846,7 @@ CGLTex CDRMRenderer::glTex(Hyprutils::Memory::CSharedPointer<IBuffer> buffa) {
         if (fmt.drmFormat != dma.format || fmt.modifier != dma.modifier)
             continue;
 
-        backend->log(AQ_LOG_DEBUG, std::format("CDRMRenderer::glTex: found format+mod, external = {}", fmt.external));
+        log(AQ_LOG_DEBUG, std::format("CDRMRenderer::glTex: found format+mod, external = {}", fmt.external));
         external = fmt.external;
         break;
     }
@@ -777,9 +866,11 @@ CGLTex CDRMRenderer::glTex(Hyprutils::Memory::CSharedPointer<IBuffer> buffa) {
 
 constexpr GLenum PIXEL_BUFFER_FORMAT = GL_RGBA;
 
-void             CDRMRenderer::readBuffer(Hyprutils::Memory::CSharedPointer<IBuffer> buf, std::span<uint8_t> out) {
-    CEglContextGuard eglContext(*this);
-    auto             att = buf->attachments.get<CDRMRendererBufferOutputAttachment>();
+// how many pieces readBufferPipelined splits a buffer into
+constexpr uint32_t READBACK_STRIPES = 4;
+
+GLuint CDRMRenderer::readFramebuffer(SP<IBuffer> buf) {
+    auto att = buf->attachments.get<CDRMRendererBufferOutputAttachment>();
     if (!att || att->renderer != self) {
         att = makeShared<CDRMRendererBufferOutputAttachment>(self, nullptr, 0, 0);
         buf->attachments.add(att);
@@ -789,8 +880,9 @@ void             CDRMRenderer::readBuffer(Hyprutils::Memory::CSharedPointer<IBuf
     if (!att->eglImage) {
         att->eglImage = createEGLImage(dma);
         if (att->eglImage == EGL_NO_IMAGE_KHR) {
-            backend->log(AQ_LOG_ERROR, std::format("EGL (readBuffer): createEGLImage failed: {}", eglGetError()));
-            return;
+            log(AQ_LOG_ERROR, std::format("EGL (readBuffer): createEGLImage failed: {}", eglGetError()));
+            att->eglImage = nullptr;
+            return 0;
         }
 
         GLCALL(glGenRenderbuffers(1, &att->rbo));
@@ -803,24 +895,131 @@ void             CDRMRenderer::readBuffer(Hyprutils::Memory::CSharedPointer<IBuf
         GLCALL(glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, att->rbo));
 
         if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-            backend->log(AQ_LOG_ERROR, std::format("EGL (readBuffer): glCheckFramebufferStatus failed: {}", glGetError()));
-            return;
+            log(AQ_LOG_ERROR, std::format("EGL (readBuffer): glCheckFramebufferStatus failed: {}", glGetError()));
+            GLCALL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+            return 0;
         }
+
+        GLCALL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
     }
 
-    GLCALL(glBindFramebuffer(GL_FRAMEBUFFER, att->fbo));
+    return att->fbo;
+}
+
+void CDRMRenderer::readBuffer(Hyprutils::Memory::CSharedPointer<IBuffer> buf, std::span<uint8_t> out) {
+    CEglContextGuard eglContext(*this);
+
+    const auto FBO = readFramebuffer(buf);
+    if (!FBO)
+        return;
+
+    const auto& dma = buf->dmabuf();
+
+    GLCALL(glBindFramebuffer(GL_FRAMEBUFFER, FBO));
     GLCALL(proc.glReadnPixelsEXT(0, 0, dma.size.x, dma.size.y, GL_RGBA, GL_UNSIGNED_BYTE, out.size(), out.data()));
 
     GLCALL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
 }
 
+bool CDRMRenderer::readBufferPipelined(SP<IBuffer> buf, std::span<uint8_t> out, const std::function<void(uint32_t y, uint32_t rows)>& onRows) {
+    CEglContextGuard eglContext(*this);
+
+    const auto FBO = readFramebuffer(buf);
+    if (!FBO)
+        return false;
+
+    const auto&    dma      = buf->dmabuf();
+    const uint32_t W        = dma.size.x;
+    const uint32_t H        = dma.size.y;
+    const size_t   STRIDE   = W * 4;
+    const uint32_t STRIPE_H = std::max<uint32_t>(1, (H + READBACK_STRIPES - 1) / READBACK_STRIPES);
+    const uint32_t STRIPES  = (H + STRIPE_H - 1) / STRIPE_H;
+
+    if (!W || !H || out.size() < STRIDE * H)
+        return false;
+
+    if (!readback.pbos[0])
+        GLCALL(glGenBuffers(readback.pbos.size(), readback.pbos.data()));
+
+    if (readback.size < STRIDE * STRIPE_H) {
+        readback.size = STRIDE * STRIPE_H;
+        for (auto const& pbo : readback.pbos) {
+            GLCALL(glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo));
+            GLCALL(glBufferData(GL_PIXEL_PACK_BUFFER, readback.size, nullptr, GL_STREAM_READ));
+        }
+    }
+
+    GLCALL(glBindFramebuffer(GL_FRAMEBUFFER, FBO));
+
+    // queues the read of a stripe into its pbo, returns right away
+    auto readStripe = [&](uint32_t stripe) {
+        const uint32_t Y    = stripe * STRIPE_H;
+        const auto     SLOT = stripe % readback.pbos.size();
+        GLCALL(glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbos[SLOT]));
+        GLCALL(glReadPixels(0, Y, W, std::min(STRIPE_H, H - Y), GL_RGBA, GL_UNSIGNED_BYTE, nullptr));
+        readback.fences[SLOT] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    };
+
+    bool ok = true;
+    readStripe(0);
+
+    for (uint32_t stripe = 0; stripe < STRIPES && ok; ++stripe) {
+        if (stripe + 1 < STRIPES)
+            readStripe(stripe + 1);
+
+        const uint32_t Y    = stripe * STRIPE_H;
+        const uint32_t ROWS = std::min(STRIPE_H, H - Y);
+        const auto     SLOT = stripe % readback.pbos.size();
+
+        // the flush bit submits the read of the next stripe too, so the gpu keeps going while we copy this one
+        const auto WAIT = glClientWaitSync(readback.fences[SLOT], GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000'000 /* 1s */);
+        glDeleteSync(readback.fences[SLOT]);
+        readback.fences[SLOT] = nullptr;
+
+        if (WAIT == GL_TIMEOUT_EXPIRED || WAIT == GL_WAIT_FAILED) {
+            log(AQ_LOG_ERROR, "EGL (readBufferPipelined): waiting for a readback failed");
+            ok = false;
+            break;
+        }
+
+        GLCALL(glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbos[SLOT]));
+        const auto DATA = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, STRIDE * ROWS, GL_MAP_READ_BIT);
+        if (!DATA) {
+            log(AQ_LOG_ERROR, "EGL (readBufferPipelined): mapping a pbo failed");
+            ok = false;
+            break;
+        }
+
+        memcpy(out.data() + (Y * STRIDE), DATA, STRIDE * ROWS);
+        GLCALL(glUnmapBuffer(GL_PIXEL_PACK_BUFFER));
+        GLCALL(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+
+        onRows(Y, ROWS);
+    }
+
+    // a failure can leave the read of the next stripe in flight
+    for (auto& f : readback.fences) {
+        if (!f)
+            continue;
+
+        glClientWaitSync(f, GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000'000);
+        glDeleteSync(f);
+        f = nullptr;
+    }
+
+    GLCALL(glBindBuffer(GL_PIXEL_PACK_BUFFER, 0));
+    GLCALL(glBindFramebuffer(GL_FRAMEBUFFER, 0));
+
+    return ok;
+}
+
 void CDRMRenderer::waitOnSync(int fd) {
-    TRACE(backend->log(AQ_LOG_TRACE, std::format("EGL (waitOnSync): attempting to wait on fd {}", fd)));
+    TRACE(log(AQ_LOG_TRACE, std::format("EGL (waitOnSync): attempting to wait on fd {}", fd)));
 
     std::array<EGLint, 3> attribs;
     int                   dupFd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
     if (dupFd < 0) {
-        backend->log(AQ_LOG_TRACE, "EGL (waitOnSync): failed to dup fd for wait");
+        log(AQ_LOG_TRACE, "EGL (waitOnSync): failed to dup fd for wait");
         return;
     }
 
@@ -830,7 +1029,7 @@ void CDRMRenderer::waitOnSync(int fd) {
 
     EGLSyncKHR sync = proc.eglCreateSyncKHR(egl.display, EGL_SYNC_NATIVE_FENCE_ANDROID, attribs.data());
     if (sync == EGL_NO_SYNC_KHR) {
-        TRACE(backend->log(AQ_LOG_TRACE, "EGL (waitOnSync): failed to create an egl sync for explicit"));
+        TRACE(log(AQ_LOG_TRACE, "EGL (waitOnSync): failed to create an egl sync for explicit"));
         if (dupFd >= 0)
             close(dupFd);
         return;
@@ -839,25 +1038,25 @@ void CDRMRenderer::waitOnSync(int fd) {
     // we got a sync, now we just tell egl to wait before sampling
     if (proc.eglWaitSyncKHR(egl.display, sync, 0) != EGL_TRUE) {
         if (proc.eglDestroySyncKHR(egl.display, sync) != EGL_TRUE)
-            TRACE(backend->log(AQ_LOG_TRACE, "EGL (waitOnSync): failed to destroy sync"));
+            TRACE(log(AQ_LOG_TRACE, "EGL (waitOnSync): failed to destroy sync"));
 
-        TRACE(backend->log(AQ_LOG_TRACE, "EGL (waitOnSync): failed to wait on the sync object"));
+        TRACE(log(AQ_LOG_TRACE, "EGL (waitOnSync): failed to wait on the sync object"));
         return;
     }
 
     if (proc.eglDestroySyncKHR(egl.display, sync) != EGL_TRUE)
-        TRACE(backend->log(AQ_LOG_TRACE, "EGL (waitOnSync): failed to destroy sync"));
+        TRACE(log(AQ_LOG_TRACE, "EGL (waitOnSync): failed to destroy sync"));
 }
 
 int CDRMRenderer::recreateBlitSync() {
-    TRACE(backend->log(AQ_LOG_TRACE, "EGL (recreateBlitSync): recreating blit sync"));
+    TRACE(log(AQ_LOG_TRACE, "EGL (recreateBlitSync): recreating blit sync"));
 
     if (egl.lastBlitSync) {
-        TRACE(backend->log(AQ_LOG_TRACE, std::format("EGL (recreateBlitSync): cleaning up old sync (fd {})", egl.lastBlitSyncFD)));
+        TRACE(log(AQ_LOG_TRACE, std::format("EGL (recreateBlitSync): cleaning up old sync (fd {})", egl.lastBlitSyncFD)));
 
         // cleanup last sync
         if (proc.eglDestroySyncKHR(egl.display, egl.lastBlitSync) != EGL_TRUE)
-            TRACE(backend->log(AQ_LOG_TRACE, "EGL (recreateBlitSync): failed to destroy old sync"));
+            TRACE(log(AQ_LOG_TRACE, "EGL (recreateBlitSync): failed to destroy old sync"));
 
         if (egl.lastBlitSyncFD >= 0)
             close(egl.lastBlitSyncFD);
@@ -868,7 +1067,7 @@ int CDRMRenderer::recreateBlitSync() {
 
     EGLSyncKHR sync = proc.eglCreateSyncKHR(egl.display, EGL_SYNC_NATIVE_FENCE_ANDROID, nullptr);
     if (sync == EGL_NO_SYNC_KHR) {
-        TRACE(backend->log(AQ_LOG_TRACE, "EGL (recreateBlitSync): failed to create an egl sync for explicit"));
+        TRACE(log(AQ_LOG_TRACE, "EGL (recreateBlitSync): failed to create an egl sync for explicit"));
         return -1;
     }
 
@@ -877,33 +1076,38 @@ int CDRMRenderer::recreateBlitSync() {
 
     int fd = proc.eglDupNativeFenceFDANDROID(egl.display, sync);
     if (fd == EGL_NO_NATIVE_FENCE_FD_ANDROID) {
-        TRACE(backend->log(AQ_LOG_TRACE, "EGL (recreateBlitSync): failed to dup egl fence fd"));
+        TRACE(log(AQ_LOG_TRACE, "EGL (recreateBlitSync): failed to dup egl fence fd"));
         if (proc.eglDestroySyncKHR(egl.display, sync) != EGL_TRUE)
-            TRACE(backend->log(AQ_LOG_TRACE, "EGL (recreateBlitSync): failed to destroy new sync"));
+            TRACE(log(AQ_LOG_TRACE, "EGL (recreateBlitSync): failed to destroy new sync"));
         return -1;
     }
 
     egl.lastBlitSync   = sync;
     egl.lastBlitSyncFD = fd;
 
-    TRACE(backend->log(AQ_LOG_TRACE, std::format("EGL (recreateBlitSync): success, new fence exported with fd {}", fd)));
+    TRACE(log(AQ_LOG_TRACE, std::format("EGL (recreateBlitSync): success, new fence exported with fd {}", fd)));
 
     return fd;
 }
 
 void CDRMRenderer::clearBuffer(IBuffer* buf) {
+    if (thread.worker.joinable() && std::this_thread::get_id() != thread.worker.get_id()) {
+        runOnThread([this, buf] { clearBuffer(buf); });
+        return;
+    }
+
     CEglContextGuard eglContext(*this);
     const auto&      dmabuf = buf->dmabuf();
     GLuint           rboID = 0, fboID = 0;
 
     if (!dmabuf.success) {
-        backend->log(AQ_LOG_ERROR, "EGL (clear): cannot clear a non-dmabuf");
+        log(AQ_LOG_ERROR, "EGL (clear): cannot clear a non-dmabuf");
         return;
     }
 
     auto rboImage = createEGLImage(dmabuf);
     if (rboImage == EGL_NO_IMAGE_KHR) {
-        backend->log(AQ_LOG_ERROR, std::format("EGL (clear): createEGLImage failed: {}", eglGetError()));
+        log(AQ_LOG_ERROR, std::format("EGL (clear): createEGLImage failed: {}", eglGetError()));
         return;
     }
 
@@ -919,7 +1123,7 @@ void CDRMRenderer::clearBuffer(IBuffer* buf) {
     GLCALL(glBindRenderbuffer(GL_RENDERBUFFER, rboID));
     GLCALL(glBindFramebuffer(GL_FRAMEBUFFER, fboID));
 
-    TRACE(backend->log(AQ_LOG_TRACE, std::format("EGL (clear): fbo {} rbo {}", fboID, rboID)));
+    TRACE(log(AQ_LOG_TRACE, std::format("EGL (clear): fbo {} rbo {}", fboID, rboID)));
 
     glClearColor(0.F, 0.F, 0.F, 1.F);
     glClear(GL_COLOR_BUFFER_BIT);
@@ -933,67 +1137,49 @@ void CDRMRenderer::clearBuffer(IBuffer* buf) {
     proc.eglDestroyImageKHR(egl.display, rboImage);
 }
 
-CDRMRenderer::SBlitResult CDRMRenderer::blit(SP<IBuffer> from, SP<IBuffer> to, SP<CDRMRenderer> primaryRenderer, int waitFD) {
-    if (!from || !to) {
-        backend->log(AQ_LOG_ERROR, "EGL (blit): null source or destination buffer");
-        return {};
-    }
-
+bool CDRMRenderer::prepareBlit(SBlitPlan& plan, SP<IBuffer> from, SP<IBuffer> to, bool canReadBack) {
     CEglContextGuard eglContext(*this);
 
-    if (from->dmabuf().size != to->dmabuf().size) {
-        backend->log(AQ_LOG_ERROR, "EGL (blit): buffer sizes mismatched");
-        return {};
-    }
-
-    if (waitFD >= 0 && !CFileDescriptor::isReadable(waitFD)) {
-        // wait on a provided explicit fence
-        waitOnSync(waitFD);
-    }
-
     // firstly, get a texture from the from buffer
     // if it has an attachment, use that
     // both from and to have the same AQ_ATTACHMENT_DRM_RENDERER_DATA.
     // Those buffers always come from different swapchains, so it's OK.
 
-    WP<CGLTex>         fromTex;
-    const auto&        fromDma = from->dmabuf();
-    std::span<uint8_t> intermediateBuf;
+    WP<CGLTex>  fromTex;
+    const auto& fromDma = from->dmabuf();
+    plan.size           = fromDma.size;
     {
         auto attachment = from->attachments.get<CDRMRendererBufferInputAttachment>();
         if (attachment && attachment->renderer == self) {
-            TRACE(backend->log(AQ_LOG_TRACE, "EGL (blit): From attachment found"));
-            fromTex         = attachment->tex;
-            intermediateBuf = attachment->intermediateBuf;
+            TRACE(log(AQ_LOG_TRACE, "EGL (blit): From attachment found"));
+            fromTex              = attachment->tex;
+            plan.intermediateBuf = attachment->intermediateBuf;
         }
 
-        if ((!fromTex || !fromTex->image) && intermediateBuf.empty()) {
-            backend->log(AQ_LOG_DEBUG, "EGL (blit): No attachment in from, creating a new image");
+        if ((!fromTex || !fromTex->image) && plan.intermediateBuf.empty()) {
+            log(AQ_LOG_DEBUG, "EGL (blit): No attachment in from, creating a new image");
 
             attachment = makeShared<CDRMRendererBufferInputAttachment>(self, glTex(from), std::vector<uint8_t>());
             from->attachments.add(attachment);
 
-            if (!attachment->tex->image && primaryRenderer) {
-                backend->log(AQ_LOG_DEBUG, "EGL (blit): Failed to create image from source buffer directly, allocating intermediate buffer");
+            if (!attachment->tex->image && canReadBack) {
+                log(AQ_LOG_DEBUG, "EGL (blit): Failed to create image from source buffer directly, allocating intermediate buffer");
                 static_assert(PIXEL_BUFFER_FORMAT == GL_RGBA); // If the pixel buffer format changes, the below size calculation probably needs to as well.
                 attachment->intermediateBuf.resize(fromDma.size.x * fromDma.size.y * 4);
-                intermediateBuf         = attachment->intermediateBuf;
+                plan.intermediateBuf    = attachment->intermediateBuf;
                 attachment->tex->target = GL_TEXTURE_2D;
                 GLCALL(glGenTextures(1, &attachment->tex->texid));
             }
 
             fromTex = attachment->tex;
         }
-
-        if (!intermediateBuf.empty() && primaryRenderer) {
-            // Note: this might modify from's output attachment
-            primaryRenderer->readBuffer(from, intermediateBuf);
-        }
     }
 
-    TRACE(backend->log(AQ_LOG_TRACE,
-                       std::format("EGL (blit): fromTex id {}, image 0x{:x}, target {}", fromTex->texid, (uintptr_t)fromTex->image,
-                                   fromTex->target == GL_TEXTURE_2D ? "GL_TEXTURE_2D" : "GL_TEXTURE_EXTERNAL_OES")));
+    plan.fromTex = fromTex.get();
+
+    TRACE(log(AQ_LOG_TRACE,
+              std::format("EGL (blit): fromTex id {}, image 0x{:x}, target {}", fromTex->texid, (uintptr_t)fromTex->image,
+                          fromTex->target == GL_TEXTURE_2D ? "GL_TEXTURE_2D" : "GL_TEXTURE_EXTERNAL_OES")));
 
     // then, get a rbo from our to buffer
     // if it has an attachment, use that
@@ -1003,26 +1189,26 @@ CDRMRenderer::SBlitResult CDRMRenderer::blit(SP<IBuffer> from, SP<IBuffer> to, S
     const auto& toDma = to->dmabuf();
 
     if (!verifyDestinationDMABUF(toDma)) {
-        backend->log(AQ_LOG_ERROR, "EGL (blit): failed to blit: destination dmabuf unsupported");
-        return {};
+        log(AQ_LOG_ERROR, "EGL (blit): failed to blit: destination dmabuf unsupported");
+        return false;
     }
 
     {
         auto attachment = to->attachments.get<CDRMRendererBufferOutputAttachment>();
         if (attachment && attachment->renderer == self) {
-            TRACE(backend->log(AQ_LOG_TRACE, "EGL (blit): To attachment found"));
+            TRACE(log(AQ_LOG_TRACE, "EGL (blit): To attachment found"));
             rboImage = attachment->eglImage;
             fboID    = attachment->fbo;
             rboID    = attachment->rbo;
         }
 
         if (!rboImage) {
-            backend->log(AQ_LOG_DEBUG, "EGL (blit): No attachment in to, creating a new image");
+            log(AQ_LOG_DEBUG, "EGL (blit): No attachment in to, creating a new image");
 
             rboImage = createEGLImage(toDma);
             if (rboImage == EGL_NO_IMAGE_KHR) {
-                backend->log(AQ_LOG_ERROR, std::format("EGL (blit): createEGLImage failed: {}", eglGetError()));
-                return {};
+                log(AQ_LOG_ERROR, std::format("EGL (blit): createEGLImage failed: {}", eglGetError()));
+                return false;
             }
 
             GLCALL(glGenRenderbuffers(1, &rboID));
@@ -1035,28 +1221,53 @@ CDRMRenderer::SBlitResult CDRMRenderer::blit(SP<IBuffer> from, SP<IBuffer> to, S
             GLCALL(glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, rboID));
 
             if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-                backend->log(AQ_LOG_ERROR, std::format("EGL (blit): glCheckFramebufferStatus failed: {}", glGetError()));
-                return {};
+                log(AQ_LOG_ERROR, std::format("EGL (blit): glCheckFramebufferStatus failed: {}", glGetError()));
+                return false;
             }
 
             to->attachments.add(makeShared<CDRMRendererBufferOutputAttachment>(self, rboImage, fboID, rboID));
         }
     }
 
-    TRACE(backend->log(AQ_LOG_TRACE, std::format("EGL (blit): rboImage 0x{:x}", (uintptr_t)rboImage)));
+    TRACE(log(AQ_LOG_TRACE, std::format("EGL (blit): rboImage 0x{:x}", (uintptr_t)rboImage)));
 
-    GLCALL(glBindRenderbuffer(GL_RENDERBUFFER, rboID));
-    GLCALL(glBindFramebuffer(GL_FRAMEBUFFER, fboID));
+    plan.fbo = fboID;
+    plan.rbo = rboID;
 
-    TRACE(backend->log(AQ_LOG_TRACE, std::format("EGL (blit): fbo {} rbo {}", fboID, rboID)));
+    return true;
+}
 
-    glClearColor(0.77F, 0.F, 0.74F, 1.F);
-    glClear(GL_COLOR_BUFFER_BIT);
+CDRMRenderer::SBlitResult CDRMRenderer::drawBlit(const SBlitPlan& plan, int waitFD, const CRegion& damage) {
+    CEglContextGuard eglContext(*this);
+
+    if (waitFD >= 0 && !CFileDescriptor::isReadable(waitFD)) {
+        // wait on a provided explicit fence
+        waitOnSync(waitFD);
+    }
+
+    const auto fromTex = plan.fromTex;
+
+    GLCALL(glBindRenderbuffer(GL_RENDERBUFFER, plan.rbo));
+    GLCALL(glBindFramebuffer(GL_FRAMEBUFFER, plan.fbo));
+
+    TRACE(log(AQ_LOG_TRACE, std::format("EGL (blit): fbo {} rbo {}", plan.fbo, plan.rbo)));
 
     // done, let's render the texture to the rbo
-    CBox renderBox = {{}, toDma.size};
+    CBox renderBox = {{}, plan.size};
 
-    TRACE(backend->log(AQ_LOG_TRACE, std::format("EGL (blit): box size {}", renderBox.size())));
+    // the rest of to still holds a valid older frame, only draw over what changed since
+    std::vector<pixman_box32_t> rects;
+    if (!damage.empty())
+        rects = damage.copy().intersect(renderBox).getRects();
+
+    const bool PARTIAL = !rects.empty();
+
+    if (!PARTIAL) {
+        glClearColor(0.77F, 0.F, 0.74F, 1.F);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+
+    TRACE(log(AQ_LOG_TRACE, std::format("EGL (blit): box size {}", renderBox.size())));
 
     float mtx[9];
     float base[9];
@@ -1066,25 +1277,25 @@ CDRMRenderer::SBlitResult CDRMRenderer::blit(SP<IBuffer> from, SP<IBuffer> to, S
     auto& SHADER = fromTex->target == GL_TEXTURE_2D ? shader : shaderExt;
 
     // KMS uses flipped y, we have to do FLIPPED_180
-    matrixTranslate(base, toDma.size.x / 2.0, toDma.size.y / 2.0);
+    matrixTranslate(base, plan.size.x / 2.0, plan.size.y / 2.0);
     matrixTransform(base, HYPRUTILS_TRANSFORM_FLIPPED_180);
-    matrixTranslate(base, -toDma.size.x / 2.0, -toDma.size.y / 2.0);
+    matrixTranslate(base, -plan.size.x / 2.0, -plan.size.y / 2.0);
 
     projectBox(mtx, renderBox, HYPRUTILS_TRANSFORM_FLIPPED_180, 0, base);
 
-    matrixProjection(monitorProj, toDma.size.x, toDma.size.y, HYPRUTILS_TRANSFORM_FLIPPED_180);
+    matrixProjection(monitorProj, plan.size.x, plan.size.y, HYPRUTILS_TRANSFORM_FLIPPED_180);
 
     float glMtx[9];
     matrixMultiply(glMtx, monitorProj, mtx);
 
-    GLCALL(glViewport(0, 0, toDma.size.x, toDma.size.y));
+    GLCALL(glViewport(0, 0, plan.size.x, plan.size.y));
     GLCALL(glActiveTexture(GL_TEXTURE0));
     GLCALL(fromTex->bind());
     GLCALL(fromTex->setTexParameter(GL_TEXTURE_MAG_FILTER, GL_NEAREST));
     GLCALL(fromTex->setTexParameter(GL_TEXTURE_MIN_FILTER, GL_NEAREST));
 
-    if (!intermediateBuf.empty())
-        GLCALL(glTexImage2D(fromTex->target, 0, PIXEL_BUFFER_FORMAT, fromDma.size.x, fromDma.size.y, 0, PIXEL_BUFFER_FORMAT, GL_UNSIGNED_BYTE, intermediateBuf.data()));
+    if (!plan.intermediateBuf.empty() && !plan.uploaded)
+        GLCALL(glTexImage2D(fromTex->target, 0, PIXEL_BUFFER_FORMAT, plan.size.x, plan.size.y, 0, PIXEL_BUFFER_FORMAT, GL_UNSIGNED_BYTE, plan.intermediateBuf.data()));
 
     useProgram(SHADER.program);
     GLCALL(glDisable(GL_BLEND));
@@ -1096,7 +1307,18 @@ CDRMRenderer::SBlitResult CDRMRenderer::blit(SP<IBuffer> from, SP<IBuffer> to, S
     GLCALL(glUniform1i(SHADER.tex, 0));
     GLCALL(glBindVertexArray(SHADER.shaderVao));
 
-    GLCALL(glDrawArrays(GL_TRIANGLE_STRIP, 0, 4));
+    if (PARTIAL) {
+        // the fb rows are in memory order, same as the damage, so no flipping here
+        GLCALL(glEnable(GL_SCISSOR_TEST));
+        for (auto const& r : rects) {
+            GLCALL(glScissor(r.x1, r.y1, r.x2 - r.x1, r.y2 - r.y1));
+            GLCALL(glDrawArrays(GL_TRIANGLE_STRIP, 0, 4));
+        }
+        GLCALL(glDisable(GL_SCISSOR_TEST));
+    } else
+        GLCALL(glDrawArrays(GL_TRIANGLE_STRIP, 0, 4));
+
+    TRACE(log(AQ_LOG_TRACE, std::format("EGL (blit): drew {}", PARTIAL ? std::format("{} damaged rects", rects.size()) : std::string{"the whole buffer"})));
 
     GLCALL(glBindVertexArray(0));
     GLCALL(fromTex->unbind());
@@ -1112,6 +1334,242 @@ CDRMRenderer::SBlitResult CDRMRenderer::blit(SP<IBuffer> from, SP<IBuffer> to, S
     return {.success = true, .syncFD = explicitFD == -1 ? std::nullopt : std::optional<int>{explicitFD}};
 }
 
+CDRMRenderer::SBlitResult CDRMRenderer::blit(SP<IBuffer> from, SP<IBuffer> to, SP<CDRMRenderer> primaryRenderer, int waitFD, const CRegion& damage) {
+    if (thread.worker.joinable()) {
+        auto result = blitAsync(from, to, primaryRenderer, waitFD, damage).get();
+        flushLogs();
+        return result;
+    }
+
+    if (!from || !to) {
+        backend->log(AQ_LOG_ERROR, "EGL (blit): null source or destination buffer");
+        return {};
+    }
+
+    CEglContextGuard eglContext(*this);
+
+    if (from->dmabuf().size != to->dmabuf().size) {
+        backend->log(AQ_LOG_ERROR, "EGL (blit): buffer sizes mismatched");
+        return {};
+    }
+
+    SBlitPlan plan;
+    if (!prepareBlit(plan, from, to, !!primaryRenderer))
+        return {};
+
+    if (!plan.intermediateBuf.empty() && primaryRenderer) {
+        // upload each stripe while the primary reads the next one, and fall back to one big read + upload if that fails.
+        // Note: this might modify from's output attachment
+        static const auto NO_PIPELINED_READBACK = envEnabled("AQ_MGPU_NO_PIPELINED_READBACK");
+        if (!NO_PIPELINED_READBACK) {
+            plan.uploaded = primaryRenderer->readBufferPipelined(from, plan.intermediateBuf, [&](uint32_t y, uint32_t rows) {
+                CEglContextGuard ourContext(*this);
+                GLCALL(plan.fromTex->bind());
+                if (y == 0)
+                    GLCALL(glTexImage2D(plan.fromTex->target, 0, PIXEL_BUFFER_FORMAT, plan.size.x, plan.size.y, 0, PIXEL_BUFFER_FORMAT, GL_UNSIGNED_BYTE, nullptr));
+                GLCALL(glTexSubImage2D(plan.fromTex->target, 0, 0, y, plan.size.x, rows, PIXEL_BUFFER_FORMAT, GL_UNSIGNED_BYTE,
+                                       plan.intermediateBuf.data() + (size_t)y * plan.size.x * 4));
+                GLCALL(plan.fromTex->unbind());
+            });
+        }
+
+        if (!plan.uploaded)
+            primaryRenderer->readBuffer(from, plan.intermediateBuf);
+    }
+
+    return drawBlit(plan, waitFD, damage);
+}
+
+std::shared_future<CDRMRenderer::SBlitResult> CDRMRenderer::blitAsync(SP<IBuffer> from, SP<IBuffer> to, SP<CDRMRenderer> primaryRenderer, int waitFD, const CRegion& damage) {
+    // std:: pointers, these two get dropped on whichever thread is last
+    auto result = std::make_shared<std::promise<SBlitResult>>();
+    auto future = result->get_future().share();
+
+    if (!thread.worker.joinable()) {
+        result->set_value(blit(from, to, primaryRenderer, waitFD, damage));
+        return future;
+    }
+
+    if (!from || !to || from->dmabuf().size != to->dmabuf().size) {
+        backend->log(AQ_LOG_ERROR, "EGL (blit): null or mismatched buffers");
+        result->set_value({});
+        return future;
+    }
+
+    // attachments are only touched here, while we wait: the consumer can be adding its own to the same buffers right after
+    auto plan = std::make_shared<SBlitPlan>();
+    bool ok   = false;
+    runOnThread([&] { ok = prepareBlit(*plan, from, to, !!primaryRenderer); });
+
+    if (!ok) {
+        result->set_value({});
+        return future;
+    }
+
+    // the primary's context belongs to this thread, so its part of the readback happens here
+    if (!plan->intermediateBuf.empty() && primaryRenderer)
+        primaryRenderer->readBuffer(from, plan->intermediateBuf);
+
+    // the caller is free to close its fence once we return
+    auto fence = std::make_shared<CFileDescriptor>(waitFD >= 0 ? fcntl(waitFD, F_DUPFD_CLOEXEC, 0) : -1);
+
+    queueOnThread([this, plan, result, fence, damage = CRegion{damage}] { result->set_value(drawBlit(*plan, fence->get(), damage)); }, {from, to});
+
+    return future;
+}
+
+bool CDRMRenderer::canImport(const SDMABUFAttrs& attrs) {
+    if (thread.worker.joinable() && std::this_thread::get_id() != thread.worker.get_id()) {
+        bool ok = false;
+        runOnThread([&] { ok = canImport(attrs); });
+        return ok;
+    }
+
+    CEglContextGuard eglContext(*this);
+
+    auto             image = createEGLImage(attrs);
+    if (image == EGL_NO_IMAGE_KHR)
+        return false;
+
+    proc.eglDestroyImageKHR(egl.display, image);
+    return true;
+}
+
+bool CDRMRenderer::startThread() {
+    if (thread.worker.joinable())
+        return true;
+
+    std::promise<bool> started;
+    auto               future = started.get_future();
+
+    // the context can only be current on one thread at a time, let go of it here first
+    if (eglGetCurrentContext() == egl.context)
+        eglMakeCurrent(egl.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+
+    thread.exit   = false;
+    thread.worker = std::thread([this, &started] {
+        if (!eglMakeCurrent(egl.display, EGL_NO_SURFACE, EGL_NO_SURFACE, egl.context)) {
+            eglReleaseThread();
+            started.set_value(false);
+            return;
+        }
+
+        started.set_value(true);
+        threadMain();
+    });
+
+    if (!future.get()) {
+        thread.worker.join();
+        backend->log(AQ_LOG_ERROR, "EGL: couldn't make the context current on the render thread");
+        return false;
+    }
+
+    backend->log(AQ_LOG_DEBUG, "EGL: renderer running on its own thread");
+    return true;
+}
+
+void CDRMRenderer::stopThread() {
+    if (!thread.worker.joinable())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lg(thread.mutex);
+        thread.exit = true;
+    }
+    thread.cv.notify_all();
+    thread.worker.join();
+
+    thread.graveyard.clear();
+    flushLogs();
+}
+
+void CDRMRenderer::threadMain() {
+    while (true) {
+        std::unique_lock<std::mutex> lk(thread.mutex);
+        thread.cv.wait(lk, [this] { return thread.exit || !thread.jobs.empty(); });
+
+        // drain what's queued even when exiting, someone may be waiting on it
+        if (thread.jobs.empty())
+            break;
+
+        SJob job = std::move(thread.jobs.front());
+        thread.jobs.pop_front();
+        lk.unlock();
+
+        job.fn();
+        job.fn = nullptr;
+
+        lk.lock();
+        // moving doesn't touch the refcounts, the queueing thread drops them
+        for (auto& b : job.keepAlive) {
+            thread.graveyard.emplace_back(std::move(b));
+        }
+    }
+
+    eglMakeCurrent(egl.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglReleaseThread();
+}
+
+void CDRMRenderer::runOnThread(const std::function<void()>& job) {
+    if (!thread.worker.joinable() || std::this_thread::get_id() == thread.worker.get_id()) {
+        job();
+        return;
+    }
+
+    std::promise<void> done;
+    auto               future = done.get_future();
+
+    // job and done live on our stack until we return, no need to copy anything
+    queueOnThread([&job, &done] {
+        job();
+        done.set_value();
+    });
+
+    future.wait();
+    flushLogs();
+}
+
+void CDRMRenderer::queueOnThread(std::function<void()> job, std::vector<SP<IBuffer>> keepAlive) {
+    if (!thread.worker.joinable() || std::this_thread::get_id() == thread.worker.get_id()) {
+        job();
+        return;
+    }
+
+    std::vector<SP<IBuffer>> dead;
+    {
+        std::lock_guard<std::mutex> lg(thread.mutex);
+        dead.swap(thread.graveyard);
+        thread.jobs.emplace_back(SJob{.fn = std::move(job), .keepAlive = std::move(keepAlive)});
+    }
+    thread.cv.notify_one();
+
+    flushLogs();
+}
+
+void CDRMRenderer::log(eBackendLogLevel level, const std::string& msg) {
+    if (thread.worker.joinable() && std::this_thread::get_id() == thread.worker.get_id()) {
+        std::lock_guard<std::mutex> lg(thread.mutex);
+        thread.logs.emplace_back(level, msg);
+        return;
+    }
+
+    // keep the order, whatever the thread logged came first
+    flushLogs();
+    backend->log(level, msg);
+}
+
+void CDRMRenderer::flushLogs() {
+    std::vector<std::pair<eBackendLogLevel, std::string>> logs;
+    {
+        std::lock_guard<std::mutex> lg(thread.mutex);
+        logs.swap(thread.logs);
+    }
+
+    for (auto const& [level, msg] : logs) {
+        backend->log(level, msg);
+    }
+}
+
 bool CDRMRenderer::verifyDestinationDMABUF(const SDMABUFAttrs& attrs) {
     for (auto const& fmt : formats) {
         if (fmt.drmFormat != attrs.format)
@@ -1121,14 +1579,14 @@ bool CDRMRenderer::verifyDestinationDMABUF(const SDMABUFAttrs& attrs) {
             continue;
 
         if (fmt.modifier != DRM_FORMAT_INVALID && fmt.external) {
-            backend->log(AQ_LOG_ERROR, "EGL (verifyDestinationDMABUF): FAIL, format is external-only");
+            log(AQ_LOG_ERROR, "EGL (verifyDestinationDMABUF): FAIL, format is external-only");
             return false;
         }
 
         return true;
     }
 
-    backend->log(AQ_LOG_ERROR, "EGL (verifyDestinationDMABUF): FAIL, format is unsupported by EGL");
+    log(AQ_LOG_ERROR, "EGL (verifyDestinationDMABUF): FAIL, format is unsupported by EGL");
     return false;
 }
 
@@ -1172,18 +1630,21 @@ CDRMRendererBufferInputAttachment::CDRMRendererBufferInputAttachment(Hyprutils::
     tex(makeUnique<CGLTex>(std::move(tex_))), intermediateBuf(intermediateBuf_), renderer(renderer_) {}
 
 CDRMRendererBufferInputAttachment::~CDRMRendererBufferInputAttachment() {
-    if (renderer.expired())
+    if (renderer.expired() || !tex)
         return;
 
-    auto&            backend = renderer->backend;
-    CEglContextGuard eglContext(*renderer);
+    // with a render thread, this goes behind any blit still reading from it there
+    renderer->queueOnThread([r = renderer.get(), texid = tex->texid, image = tex->image] {
+        auto             log = [r](eBackendLogLevel level, const std::string& msg) { r->log(level, msg); };
+        CEglContextGuard eglContext(*r);
 
-    TRACE(backend->log(AQ_LOG_TRACE, std::format("EGL (~CDRMRendererBufferInputAttachment): dropping tex {}", tex ? (int)tex->texid : -1)));
+        TRACE(log(AQ_LOG_TRACE, std::format("EGL (~CDRMRendererBufferInputAttachment): dropping tex {}", texid)));
 
-    if (tex && tex->texid)
-        GLCALL(glDeleteTextures(1, &tex->texid));
-    if (tex && tex->image)
-        renderer->proc.eglDestroyImageKHR(renderer->egl.display, tex->image);
+        if (texid)
+            GLCALL(glDeleteTextures(1, &texid));
+        if (image)
+            r->proc.eglDestroyImageKHR(r->egl.display, image);
+    });
 }
 
 CDRMRendererBufferOutputAttachment::CDRMRendererBufferOutputAttachment(Hyprutils::Memory::CWeakPointer<CDRMRenderer> renderer_, EGLImageKHR image, GLuint fbo_, GLuint rbo_) :
@@ -1193,15 +1654,17 @@ CDRMRendererBufferOutputAttachment::~CDRMRendererBufferOutputAttachment() {
     if (renderer.expired())
         return;
 
-    auto&            backend = renderer->backend;
-    CEglContextGuard eglContext(*renderer);
+    renderer->queueOnThread([r = renderer.get(), fbo = fbo, rbo = rbo, eglImage = eglImage] {
+        auto             log = [r](eBackendLogLevel level, const std::string& msg) { r->log(level, msg); };
+        CEglContextGuard eglContext(*r);
 
-    TRACE(backend->log(AQ_LOG_TRACE, std::format("EGL (~CDRMRendererBufferOutputAttachment): dropping fbo {} rbo {} image 0x{:x}", fbo, rbo, (uintptr_t)eglImage)));
+        TRACE(log(AQ_LOG_TRACE, std::format("EGL (~CDRMRendererBufferOutputAttachment): dropping fbo {} rbo {} image 0x{:x}", fbo, rbo, (uintptr_t)eglImage)));
 
-    if (rbo)
-        GLCALL(glDeleteRenderbuffers(1, &rbo));
-    if (fbo)
-        GLCALL(glDeleteFramebuffers(1, &fbo));
-    if (eglImage)
-        renderer->proc.eglDestroyImageKHR(renderer->egl.display, eglImage);
+        if (rbo)
+            GLCALL(glDeleteRenderbuffers(1, &rbo));
+        if (fbo)
+            GLCALL(glDeleteFramebuffers(1, &fbo));
+        if (eglImage)
+            r->proc.eglDestroyImageKHR(r->egl.display, eglImage);
+    });
 }
@@ -9,7 +9,14 @@
 #define __gl2_h_ // define guard for gl2ext.h
 #include <GLES2/gl2ext.h>
 #include <gbm.h>
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
 #include <optional>
+#include <thread>
 #include <tuple>
 #include <vector>
 #include <span>
@@ -101,10 +108,25 @@ namespace Aquamarine {
             std::optional<int> syncFD;
         };
 
+        // damage is in buffer coordinates and limits the copy to what changed in to since it last held a frame.
+        // Empty copies the whole buffer.
         SBlitResult blit(Hyprutils::Memory::CSharedPointer<IBuffer> from, Hyprutils::Memory::CSharedPointer<IBuffer> to,
-                         Hyprutils::Memory::CSharedPointer<CDRMRenderer> primaryRenderer, int waitFD = -1);
+                         Hyprutils::Memory::CSharedPointer<CDRMRenderer> primaryRenderer, int waitFD = -1, const Hyprutils::Math::CRegion& damage = {});
+        // same as blit, but with a thread the draw runs there and this returns before it's done. Without one,
+        // the future is ready on return. The readback from primaryRenderer, if needed, still happens here.
+        std::shared_future<SBlitResult> blitAsync(Hyprutils::Memory::CSharedPointer<IBuffer> from, Hyprutils::Memory::CSharedPointer<IBuffer> to,
+                                                  Hyprutils::Memory::CSharedPointer<CDRMRenderer> primaryRenderer, int waitFD = -1,
+                                                  const Hyprutils::Math::CRegion& damage = {});
         // can't be a SP<> because we call it from buf's ctor...
         void clearBuffer(IBuffer* buf);
+        // whether we can make an EGLImage out of attrs, i.e. sample from it
+        bool canImport(const SDMABUFAttrs& attrs);
+
+        // moves our context to a thread of its own, every gl call goes through it from then on.
+        // Only for renderers that are never anyone's primaryRenderer, readBuffer stays on the caller.
+        bool startThread();
+        // passes on what the render thread logged since the last call, main thread only
+        void flushLogs();
 
         struct SShader {
             ~SShader();
@@ -155,6 +177,9 @@ namespace Aquamarine {
 
         CGLTex                                        glTex(Hyprutils::Memory::CSharedPointer<IBuffer> buf);
         void                                          readBuffer(Hyprutils::Memory::CSharedPointer<IBuffer> buf, std::span<uint8_t> out);
+        // like readBuffer, but in horizontal stripes through a pair of pixel pack buffers. While onRows handles
+        // one stripe, which is already in out, the gpu reads the next. False if it couldn't read it all.
+        bool readBufferPipelined(Hyprutils::Memory::CSharedPointer<IBuffer> buf, std::span<uint8_t> out, const std::function<void(uint32_t y, uint32_t rows)>& onRows);
 
         Hyprutils::Memory::CWeakPointer<CDRMRenderer> self;
         std::vector<SGLFormat>                        formats;
@@ -166,11 +191,56 @@ namespace Aquamarine {
         bool                                                  verifyDestinationDMABUF(const SDMABUFAttrs& attrs);
         void                                                  waitOnSync(int fd);
         int                                                   recreateBlitSync();
+        GLuint                                                readFramebuffer(Hyprutils::Memory::CSharedPointer<IBuffer> buf);
+
+        struct SBlitPlan {
+            CGLTex*                   fromTex = nullptr;
+            std::span<uint8_t>        intermediateBuf;
+            bool                      uploaded = false; // intermediateBuf already made it into fromTex
+            GLuint                    fbo = 0, rbo = 0;
+            Hyprutils::Math::Vector2D size;
+        };
+
+        // looks up or creates the attachments of from and to, the only part of a blit touching the buffers
+        bool        prepareBlit(SBlitPlan& plan, Hyprutils::Memory::CSharedPointer<IBuffer> from, Hyprutils::Memory::CSharedPointer<IBuffer> to, bool canReadBack);
+        SBlitResult drawBlit(const SBlitPlan& plan, int waitFD, const Hyprutils::Math::CRegion& damage);
+
+        // run job on our thread, or right here if there's none / we're on it. runOnThread waits for it.
+        // keepAlive is released back on the thread that queued, hyprutils pointers aren't thread safe.
+        void runOnThread(const std::function<void()>& job);
+        void queueOnThread(std::function<void()> job, std::vector<Hyprutils::Memory::CSharedPointer<IBuffer>> keepAlive = {});
+        void threadMain();
+        void stopThread();
+        // on the render thread this only queues, the consumer's logger isn't ours to call from there
+        void log(eBackendLogLevel level, const std::string& msg);
+
+        struct SJob {
+            std::function<void()>                                   fn;
+            std::vector<Hyprutils::Memory::CSharedPointer<IBuffer>> keepAlive;
+        };
+
+        struct {
+            std::thread                                             worker;
+            std::mutex                                              mutex;
+            std::condition_variable                                 cv;
+            std::deque<SJob>                                        jobs;
+            std::vector<Hyprutils::Memory::CSharedPointer<IBuffer>> graveyard;
+            std::vector<std::pair<eBackendLogLevel, std::string>>   logs;
+            bool                                                    exit = false;
+        } thread;
+
+        struct {
+            std::array<GLuint, 2> pbos   = {0, 0};
+            std::array<GLsync, 2> fences = {nullptr, nullptr};
+            size_t                size   = 0;
+        } readback;
 
         void                                                  loadEGLAPI();
         EGLDeviceEXT                                          eglDeviceFromDRMFD(int drmFD);
         void                                                  initContext();
         void                                                  initResources();
+        // links vert + frag, from the on-disk program binary cache if the driver has it there
+        GLuint                                                loadProgram(const std::string& vert, const std::string& frag);
         bool                                                  initDRMFormats();
         std::optional<std::vector<std::pair<uint64_t, bool>>> getModsForFormat(EGLint format);
         bool                                                  hasModifiers = false;
@@ -1,4 +1,5 @@
 #include <aquamarine/backend/drm/Atomic.hpp>
+#include <algorithm>
 #include <cstdint>
 #include <cstring>
 #include <drm_mode.h>
@@ -8,6 +9,8 @@
 #include <sstream>
 #include <optional>
 #include "Shared.hpp"
+#include "../BlobCache.hpp"
+#include "../CommitThread.hpp"
 #include "aquamarine/output/Output.hpp"
 
 using namespace Aquamarine;
@@ -51,6 +54,18 @@ static uint8_t getMaxBPC(uint64_t min, uint64_t max, uint32_t drmFormat) {
     return std::clamp<uint64_t>(formatBPC, min, max);
 }
 
+// remember which connector_state values the kernel last accepted so the
+// next page-flip can skip emitting unchanged ones (see #265).
+static void cacheConnectorProps(SP<SDRMConnector> connector, const SDRMConnectorCommitData& data) {
+    connector->atomic.maxBpc      = data.atomic.maxBpc;
+    connector->atomic.colorspace  = data.atomic.colorspace;
+    connector->atomic.contentType = data.atomic.contentType;
+    connector->atomic.crtcID      = data.atomic.crtcID;
+    connector->atomic.propsCached = true;
+    if (data.atomic.ctmd)
+        connector->crtc->atomic.ctmStateKnown = true;
+}
+
 Aquamarine::CDRMAtomicRequest::CDRMAtomicRequest(Hyprutils::Memory::CWeakPointer<CDRMBackend> backend_) : backend(backend_), req(drmModeAtomicAlloc()) {
     if (!req)
         failed = true;
@@ -109,9 +124,9 @@ bool Aquamarine::CDRMAtomicRequest::restateConnectors(SP<SDRMConnector> self) {
 
         TRACE(backend->log(AQ_LOG_TRACE, std::format("atomic drm request: restating head {} with blob {}", c->szName, blob)));
 
-        add(c->crtc->id, c->crtc->props.values.mode_id, blob);
+        addKeyed(c->crtc->id, c->crtc->props.values.mode_id, blob, hashBytes(&mode, sizeof(mode)));
         add(c->crtc->id, c->crtc->props.values.active, 1);
-        add(c->id, c->props.values.crtc_id, c->crtc->id);
+        addAssignment(c->id, c->props.values.crtc_id, c->crtc->id);
 
         // A head that has not scanned out yet has no buffer to restate; its
         // existing plane state carries over untouched, which is what we want.
@@ -131,22 +146,54 @@ bool Aquamarine::CDRMAtomicRequest::restateConnectors(SP<SDRMConnector> self) {
 }
 
 void Aquamarine::CDRMAtomicRequest::add(uint32_t id, uint32_t prop, uint64_t val) {
+    addKeyed(id, prop, val, val);
+}
+
+// keyVal is what goes into the test cache key instead of val. Blob ids, fb ids and fds are minted
+// anew all the time, so for those the caller passes something describing the content instead.
+// Values the kernel already has from the last applied commit are left out of the request, unless
+// always is set: that's for props that act on every commit (fences, damage, the fb to flip to).
+void Aquamarine::CDRMAtomicRequest::addKeyed(uint32_t id, uint32_t prop, uint64_t val, uint64_t keyVal, bool always) {
     if (failed)
         return;
 
-    TRACE(backend->log(AQ_LOG_TRACE, std::format("atomic drm request: adding id {} prop {} with value {}", id, prop, val)));
+    testKey = hashCombine(hashCombine(hashCombine(testKey, id), prop), keyVal);
 
     if (id == 0 || prop == 0) {
         backend->log(AQ_LOG_ERROR, "atomic drm request: failed to add prop: id / prop == 0");
         return;
     }
 
+    if (std::ranges::find(objects, id) == objects.end())
+        objects.emplace_back(id);
+
+    static const auto NO_DELTA = envEnabled("AQ_NO_DELTA_COMMITS");
+    const uint64_t    KEY      = ((uint64_t)id << 32) | prop;
+
+    if (!always && !noDelta && !NO_DELTA) {
+        if (const auto it = backend->shadowProps.find(KEY); it != backend->shadowProps.end() && it->second == val)
+            return;
+    }
+
+    staged.emplace_back(KEY, val);
+
+    TRACE(backend->log(AQ_LOG_TRACE, std::format("atomic drm request: adding id {} prop {} with value {}", id, prop, val)));
+
     if (drmModeAtomicAddProperty(req, id, prop, val) < 0) {
         backend->log(AQ_LOG_ERROR, "atomic drm request: failed to add prop");
         failed = true;
     }
 }
 
+// for the crtc_id props: moving a plane or connector between crtcs changes what other heads' tests would get,
+// which their own test keys can't see. Applying such a request bumps the backend's kmsGeneration.
+void Aquamarine::CDRMAtomicRequest::addAssignment(uint32_t id, uint32_t prop, uint64_t val) {
+    if (const auto it = backend->shadowProps.find(((uint64_t)id << 32) | prop); it == backend->shadowProps.end() || it->second != val)
+        reassigns = true;
+
+    add(id, prop, val);
+}
+
 void Aquamarine::CDRMAtomicRequest::planeProps(Hyprutils::Memory::CSharedPointer<SDRMPlane> plane, Hyprutils::Memory::CSharedPointer<CDRMFB> fb, uint32_t crtc,
                                                Hyprutils::Math::Vector2D pos) {
 
@@ -156,27 +203,43 @@ void Aquamarine::CDRMAtomicRequest::planeProps(Hyprutils::Memory::CSharedPointer
     if (!fb || !crtc) {
         // Disable the plane
         TRACE(backend->log(AQ_LOG_TRACE, std::format("atomic planeProps: disabling plane {}", plane->id)));
-        add(plane->id, plane->props.values.fb_id, 0);
-        add(plane->id, plane->props.values.crtc_id, 0);
+        addKeyed(plane->id, plane->props.values.fb_id, 0, 0, true);
+        addAssignment(plane->id, plane->props.values.crtc_id, 0);
         add(plane->id, plane->props.values.crtc_x, (uint64_t)(int64_t)pos.x);
         add(plane->id, plane->props.values.crtc_y, (uint64_t)(int64_t)pos.y);
         return;
     }
 
+    planeProps(plane, fb, crtc, CBox{{}, fb->buffer->size}, CBox{pos, fb->buffer->size});
+}
+
+void Aquamarine::CDRMAtomicRequest::planeProps(Hyprutils::Memory::CSharedPointer<SDRMPlane> plane, Hyprutils::Memory::CSharedPointer<CDRMFB> fb, uint32_t crtc,
+                                               const Hyprutils::Math::CBox& src, const Hyprutils::Math::CBox& dst) {
+
+    if (failed)
+        return;
+
+    if (!fb || !crtc) {
+        planeProps(plane, nullptr, 0, dst.pos());
+        return;
+    }
+
     TRACE(backend->log(AQ_LOG_TRACE,
                        std::format("atomic planeProps: prop blobs: src_x {}, src_y {}, src_w {}, src_h {}, crtc_w {}, crtc_h {}, fb_id {}, crtc_id {}", plane->props.values.src_x,
                                    plane->props.values.src_y, plane->props.values.src_w, plane->props.values.src_h, plane->props.values.crtc_w, plane->props.values.crtc_h,
                                    plane->props.values.fb_id, plane->props.values.crtc_id)));
 
     // src_ are 16.16 fixed point (lol)
-    add(plane->id, plane->props.values.src_x, 0);
-    add(plane->id, plane->props.values.src_y, 0);
-    add(plane->id, plane->props.values.src_w, ((uint64_t)fb->buffer->size.x) << 16);
-    add(plane->id, plane->props.values.src_h, ((uint64_t)fb->buffer->size.y) << 16);
-    add(plane->id, plane->props.values.crtc_w, (uint32_t)fb->buffer->size.x);
-    add(plane->id, plane->props.values.crtc_h, (uint32_t)fb->buffer->size.y);
-    add(plane->id, plane->props.values.fb_id, fb->id);
-    add(plane->id, plane->props.values.crtc_id, crtc);
+    add(plane->id, plane->props.values.src_x, (uint64_t)(src.x * (1 << 16)));
+    add(plane->id, plane->props.values.src_y, (uint64_t)(src.y * (1 << 16)));
+    add(plane->id, plane->props.values.src_w, (uint64_t)(src.w * (1 << 16)));
+    add(plane->id, plane->props.values.src_h, (uint64_t)(src.h * (1 << 16)));
+    add(plane->id, plane->props.values.crtc_w, (uint32_t)dst.w);
+    add(plane->id, plane->props.values.crtc_h, (uint32_t)dst.h);
+    const auto FBATTRS = fb->buffer->dmabuf();
+    addKeyed(plane->id, plane->props.values.fb_id, fb->id,
+             hashCombine(hashCombine(hashCombine(hashCombine(0, FBATTRS.format), FBATTRS.modifier), (uint64_t)fb->buffer->size.x), (uint64_t)fb->buffer->size.y), true);
+    addAssignment(plane->id, plane->props.values.crtc_id, crtc);
 
     if (plane->props.values.color_range) {
         const auto              colorRange = conn && conn->output ? conn->output->state->state().colorRange : AQ_OUTPUT_COLOR_RANGE_AUTO;
@@ -194,7 +257,7 @@ void Aquamarine::CDRMAtomicRequest::planeProps(Hyprutils::Memory::CSharedPointer
             add(plane->id, plane->props.values.color_range, *rangeVal);
     }
 
-    planePropsPos(plane, pos);
+    planePropsPos(plane, dst.pos());
 }
 
 void Aquamarine::CDRMAtomicRequest::planePropsPos(Hyprutils::Memory::CSharedPointer<SDRMPlane> plane, Hyprutils::Math::Vector2D pos) {
@@ -224,6 +287,12 @@ void Aquamarine::CDRMAtomicRequest::addConnector(Hyprutils::Memory::CSharedPoint
     TRACE(backend->log(AQ_LOG_TRACE, std::format("atomic addConnector values: CRTC {}, mode {}", enable ? connector->crtc->id : 0, data.atomic.modeBlob)));
 
     conn = connector;
+    if (enable && std::ranges::find(heads, connector) == heads.end())
+        heads.emplace_back(connector);
+
+    // the last commit failed, so what we think the kernel has may be wrong. Send everything.
+    if (data.forcedModeset)
+        noDelta = true;
 
     // page-flips that don't change connector state must avoid touching connector_state
     // entirely, otherwise the kernel runs drm_atomic_helper_check_modeset every frame and
@@ -263,14 +332,15 @@ void Aquamarine::CDRMAtomicRequest::addConnector(Hyprutils::Memory::CSharedPoint
         }
 
         if (connector->props.values.hdr_output_metadata && data.atomic.hdrd)
-            add(connector->id, connector->props.values.hdr_output_metadata, data.atomic.hdrBlob);
+            addKeyed(connector->id, connector->props.values.hdr_output_metadata, data.atomic.hdrBlob,
+                     data.atomic.hdrBlob && data.hdrMetadata.has_value() ? hashBytes(&data.hdrMetadata.value(), sizeof(hdr_output_metadata)) : 0);
     } else
         addConnectorModeset(connector, data);
 
     addConnectorCursor(connector, data);
 
     if (forceConnProps || connector->atomic.crtcID != newCrtcID)
-        add(connector->id, connector->props.values.crtc_id, newCrtcID);
+        addAssignment(connector->id, connector->props.values.crtc_id, newCrtcID);
 
     if (enable && connector->props.values.content_type) {
         newContentType = STATE.contentType;
@@ -284,20 +354,29 @@ void Aquamarine::CDRMAtomicRequest::addConnector(Hyprutils::Memory::CSharedPoint
     data.atomic.contentType   = newContentType;
     data.atomic.crtcID        = newCrtcID;
 
-    add(connector->crtc->id, connector->crtc->props.values.active, enable);
+    // always there, so the crtc is part of every commit and gets its flip event
+    addKeyed(connector->crtc->id, connector->crtc->props.values.active, enable, enable, true);
 
     if (enable) {
         if (connector->output->supportsExplicit && data.committed & COutputState::AQ_OUTPUT_STATE_EXPLICIT_OUT_FENCE)
-            add(connector->crtc->id, connector->crtc->props.values.out_fence_ptr, (uintptr_t)&STATE.explicitOutFence);
+            addKeyed(connector->crtc->id, connector->crtc->props.values.out_fence_ptr, (uintptr_t)&STATE.explicitOutFence, 1, true);
 
         if (connector->crtc->props.values.gamma_lut && data.atomic.gammad)
-            add(connector->crtc->id, connector->crtc->props.values.gamma_lut, data.atomic.gammaLut);
+            addKeyed(connector->crtc->id, connector->crtc->props.values.gamma_lut, data.atomic.gammaLut,
+                     data.atomic.gammaLut ? hashBytes(STATE.gammaLut.data(), STATE.gammaLut.size() * sizeof(uint16_t)) : 0);
 
         if (connector->crtc->props.values.degamma_lut && data.atomic.degammad)
-            add(connector->crtc->id, connector->crtc->props.values.degamma_lut, data.atomic.degammaLut);
-
-        if (connector->crtc->props.values.ctm && data.atomic.ctmd)
-            add(connector->crtc->id, connector->crtc->props.values.ctm, data.atomic.ctmBlob);
+            addKeyed(connector->crtc->id, connector->crtc->props.values.degamma_lut, data.atomic.degammaLut,
+                     data.atomic.degammaLut ? hashBytes(STATE.degammaLut.data(), STATE.degammaLut.size() * sizeof(uint16_t)) : 0);
+
+        if (connector->crtc->props.values.ctm && data.atomic.ctmd) {
+            uint64_t ctmKey = 0;
+            if (data.ctm.has_value()) {
+                const auto MATRIX = data.ctm->getMatrix();
+                ctmKey            = hashBytes(MATRIX.data(), MATRIX.size() * sizeof(MATRIX[0]));
+            }
+            addKeyed(connector->crtc->id, connector->crtc->props.values.ctm, data.atomic.ctmBlob, ctmKey);
+        }
 
         if (connector->crtc->props.values.vrr_enabled)
             add(connector->crtc->id, connector->crtc->props.values.vrr_enabled, (uint64_t)STATE.adaptiveSync);
@@ -305,12 +384,38 @@ void Aquamarine::CDRMAtomicRequest::addConnector(Hyprutils::Memory::CSharedPoint
         planeProps(connector->crtc->primary, data.mainFB, connector->crtc->id, {});
 
         if (connector->output->supportsExplicit && STATE.explicitInFence >= 0)
-            add(connector->crtc->primary->id, connector->crtc->primary->props.values.in_fence_fd, STATE.explicitInFence);
+            addKeyed(connector->crtc->primary->id, connector->crtc->primary->props.values.in_fence_fd, STATE.explicitInFence, 1, true);
 
+        // damage never decides whether a commit passes
         if (connector->crtc->primary->props.values.fb_damage_clips)
-            add(connector->crtc->primary->id, connector->crtc->primary->props.values.fb_damage_clips, data.atomic.fbDamage);
+            addKeyed(connector->crtc->primary->id, connector->crtc->primary->props.values.fb_damage_clips, data.atomic.fbDamage, 0, true);
+
+        addConnectorOverlays(connector, data);
     } else {
         planeProps(connector->crtc->primary, nullptr, 0, {});
+
+        for (auto const& overlay : connector->crtc->overlays) {
+            if (overlay->usableBy(connector->crtc->id) && (overlay->front || overlay->back))
+                planeProps(overlay, nullptr, 0, {});
+        }
+    }
+}
+
+void Aquamarine::CDRMAtomicRequest::addConnectorOverlays(Hyprutils::Memory::CSharedPointer<SDRMConnector> connector, SDRMConnectorCommitData& data) {
+    for (auto const& overlay : connector->crtc->overlays) {
+        if (!overlay->usableBy(connector->crtc->id))
+            continue;
+
+        auto it = std::ranges::find_if(data.overlays, [&overlay](const auto& o) { return o.plane == overlay; });
+
+        if (it != data.overlays.end()) {
+            planeProps(overlay, it->fb, connector->crtc->id, it->src, it->dst);
+
+            // like the primary's, the layer's buffer may still be rendering
+            if (connector->output->supportsExplicit && it->inFence >= 0 && overlay->props.values.in_fence_fd)
+                addKeyed(overlay->id, overlay->props.values.in_fence_fd, it->inFence, 1, true);
+        } else if (overlay->front || overlay->back) // only touch planes we've actually used
+            planeProps(overlay, nullptr, 0, {});
     }
 }
 
@@ -323,9 +428,9 @@ void Aquamarine::CDRMAtomicRequest::addConnectorModeset(Hyprutils::Memory::CShar
     data.atomic.blobbed = true;
 
     if (enable) {
-        add(connector->crtc->id, connector->crtc->props.values.mode_id, data.atomic.modeBlob);
-        if (connector->props.values.link_status)
-            add(connector->id, connector->props.values.link_status, DRM_MODE_LINK_STATUS_GOOD);
+        addKeyed(connector->crtc->id, connector->crtc->props.values.mode_id, data.atomic.modeBlob, hashBytes(&data.modeInfo, sizeof(drmModeModeInfo)));
+        if (connector->props.values.link_status) // the kernel flips this to BAD on its own
+            addKeyed(connector->id, connector->props.values.link_status, DRM_MODE_LINK_STATUS_GOOD, DRM_MODE_LINK_STATUS_GOOD, true);
     } else
         add(connector->crtc->id, connector->crtc->props.values.mode_id, data.atomic.modeBlob);
 }
@@ -374,22 +479,120 @@ bool Aquamarine::CDRMAtomicRequest::commit(uint32_t flagssss) {
         return false;
     }
 
+    // a test of a property set we've already seen gives the same answer as long as the rest of the
+    // device didn't change under us, see kmsGeneration and the testResults resets in CDRMBackend.
+    static const auto NO_TEST_CACHE = envEnabled("AQ_NO_TEST_CACHE");
+    const bool        TEST          = flagssss & DRM_MODE_ATOMIC_TEST_ONLY;
+    const uint64_t    TESTKEY       = hashCombine(hashCombine(testKey, flagssss), backend->kmsGeneration);
+
+    if (TEST && !NO_TEST_CACHE) {
+        if (const auto it = backend->testResults.find(TESTKEY); it != backend->testResults.end()) {
+            TRACE(backend->log(AQ_LOG_TRACE, std::format("atomic drm request: test result {} from cache", it->second)));
+            return it->second;
+        }
+    }
+
+    // whatever touches heads the commit thread still has in hand goes on top of that, the other heads don't wait
+    if (backend->commitThread)
+        backend->commitThread->flush(objects);
+
     // a test never flips.
     const bool WANTSFLIP = conn && conn->crtc && (flagssss & DRM_MODE_PAGE_FLIP_EVENT) && !(flagssss & DRM_MODE_ATOMIC_TEST_ONLY);
-    const auto FLIPID    = WANTSFLIP ? conn->crtc->armPageFlip(conn, flagssss & DRM_MODE_PAGE_FLIP_ASYNC) : uintptr_t{0};
+
+    // a grouped request flips every head in it, and the kernel sends one event per crtc with the same user data,
+    // so all of them are armed with one id.
+    std::vector<SP<SDRMConnector>> flipping;
+    if (WANTSFLIP) {
+        if (heads.size() > 1)
+            flipping = heads;
+        else
+            flipping.emplace_back(conn);
+    }
+
+    uintptr_t FLIPID = 0;
+    for (auto const& c : flipping) {
+        FLIPID = c->crtc->armPageFlip(c, flagssss & DRM_MODE_PAGE_FLIP_ASYNC, FLIPID);
+    }
 
     if (auto ret = drmModeAtomicCommit(backend->gpu->fd, req, flagssss, rc<void*>(FLIPID)); ret) {
+        const int ERR = ret == -1 ? errno : -ret;
         backend->log((flagssss & DRM_MODE_ATOMIC_TEST_ONLY) ? AQ_LOG_DEBUG : AQ_LOG_ERROR,
-                     std::format("atomic drm request: failed to commit: {}, flags: {}", strerror(ret == -1 ? errno : -ret), flagsToStr(flagssss)));
+                     std::format("atomic drm request: failed to commit: {}, flags: {}", strerror(ERR), flagsToStr(flagssss)));
 
-        if (WANTSFLIP)
-            conn->crtc->disarmPageFlip();
+        // only remember outright rejections of the configuration, not transient errors
+        if (TEST && !NO_TEST_CACHE && (ERR == EINVAL || ERR == ERANGE))
+            backend->rememberTestResult(TESTKEY, false);
+
+        for (auto const& c : flipping) {
+            c->crtc->disarmPageFlip();
+        }
 
         return false;
     }
 
-    if (WANTSFLIP)
-        conn->sched.onFrameSubmitted();
+    for (auto const& c : flipping) {
+        c->sched.onFrameSubmitted();
+    }
+
+    if (TEST && !NO_TEST_CACHE)
+        backend->rememberTestResult(TESTKEY, true);
+    else if (!TEST && (flagssss & DRM_MODE_ATOMIC_ALLOW_MODESET)) // the heads changed, old outcomes may no longer hold
+        backend->testResults.clear();
+
+    if (!TEST) {
+        for (auto const& [key, val] : staged) {
+            backend->shadowProps[key] = val;
+        }
+
+        if (reassigns)
+            backend->kmsGeneration++;
+    }
+
+    return true;
+}
+
+bool Aquamarine::CDRMAtomicRequest::commitAsync(SP<CDRMAtomicRequest> request, uint32_t flags) {
+    const auto BACKEND = request->backend.lock();
+    const auto CONN    = request->conn;
+
+    if (request->failed || !BACKEND || !BACKEND->commitThread || !CONN || !CONN->crtc || !(flags & DRM_MODE_PAGE_FLIP_EVENT))
+        return false;
+
+    // the flip is armed now, like a nonblocking commit would, so frames of this head wait for the event
+    const auto FLIPID = CONN->crtc->armPageFlip(CONN, false);
+
+    TRACE(BACKEND->log(AQ_LOG_TRACE, std::format("atomic drm request: handing commit of {} to the commit thread", CONN->szName)));
+
+    BACKEND->commitThread->submit(request->req, flags, rc<void*>(FLIPID), request->objects, [request, FLIPID](int err) {
+        const auto BACKEND = request->backend.lock();
+        if (!err || !BACKEND)
+            return;
+
+        BACKEND->log(AQ_LOG_ERROR, std::format("atomic drm request: threaded commit of {} failed: {}", request->conn->szName, strerror(err)));
+
+        // the commit was applied as if it went through, so nothing we believe about kms holds anymore
+        BACKEND->shadowProps.clear();
+        BACKEND->testResults.clear();
+
+        if (request->conn->crtc && request->conn->crtc->pendingFlip.id == FLIPID)
+            request->conn->invalidateFrame();
+
+        // no flip is coming, ask the consumer for a new state
+        if (request->conn->output)
+            request->conn->output->events.state.emit(IOutput::SStateEvent{});
+    });
+
+    CONN->sched.onFrameSubmitted();
+
+    if (flags & DRM_MODE_ATOMIC_ALLOW_MODESET)
+        BACKEND->testResults.clear();
+
+    for (auto const& [key, val] : request->staged) {
+        BACKEND->shadowProps[key] = val;
+    }
+
+    if (request->reassigns)
+        BACKEND->kmsGeneration++;
 
     return true;
 }
@@ -402,17 +605,19 @@ void Aquamarine::CDRMAtomicRequest::destroyBlob(uint32_t id) {
         backend->log(AQ_LOG_ERROR, "atomic drm request: failed to destroy a blob");
 }
 
+// blobs from prepareConnector come out of the blob cache with a reference taken, so an unchanged
+// blob still drops the extra one, and the one we held for the old blob goes away on a change.
 void Aquamarine::CDRMAtomicRequest::commitBlob(uint32_t* current, uint32_t next) {
-    if (*current == next)
+    if (*current == next) {
+        backend->blobs->release(next);
         return;
-    destroyBlob(*current);
+    }
+    backend->blobs->release(*current);
     *current = next;
 }
 
 void Aquamarine::CDRMAtomicRequest::rollbackBlob(uint32_t* current, uint32_t next) {
-    if (*current == next)
-        return;
-    destroyBlob(next);
+    backend->blobs->release(next);
 }
 
 void Aquamarine::CDRMAtomicRequest::rollback(SDRMConnectorCommitData& data) {
@@ -420,9 +625,9 @@ void Aquamarine::CDRMAtomicRequest::rollback(SDRMConnectorCommitData& data) {
         return;
 
     conn->crtc->atomic.ownModeID = true;
-    if (data.atomic.blobbed)
-        rollbackBlob(&conn->crtc->atomic.modeID, data.atomic.modeBlob);
+    rollbackBlob(&conn->crtc->atomic.modeID, data.atomic.modeBlob);
     rollbackBlob(&conn->crtc->atomic.gammaLut, data.atomic.gammaLut);
+    rollbackBlob(&conn->crtc->atomic.degammaLut, data.atomic.degammaLut);
     rollbackBlob(&conn->crtc->atomic.ctm, data.atomic.ctmBlob);
     rollbackBlob(&conn->crtc->atomic.hdr, data.atomic.hdrBlob);
     destroyBlob(data.atomic.fbDamage);
@@ -438,9 +643,18 @@ void Aquamarine::CDRMAtomicRequest::apply(SDRMConnectorCommitData& data) {
     conn->crtc->atomic.ownModeID = true;
     if (data.atomic.blobbed)
         commitBlob(&conn->crtc->atomic.modeID, data.atomic.modeBlob);
-    commitBlob(&conn->crtc->atomic.gammaLut, data.atomic.gammaLut);
-    commitBlob(&conn->crtc->atomic.ctm, data.atomic.ctmBlob);
-    commitBlob(&conn->crtc->atomic.hdr, data.atomic.hdrBlob);
+    else
+        rollbackBlob(&conn->crtc->atomic.modeID, data.atomic.modeBlob);
+
+    // only the blobs this commit actually sent replace what the crtc holds
+    if (data.atomic.gammad)
+        commitBlob(&conn->crtc->atomic.gammaLut, data.atomic.gammaLut);
+    if (data.atomic.degammad)
+        commitBlob(&conn->crtc->atomic.degammaLut, data.atomic.degammaLut);
+    if (data.atomic.ctmd)
+        commitBlob(&conn->crtc->atomic.ctm, data.atomic.ctmBlob);
+    if (data.atomic.hdrd)
+        commitBlob(&conn->crtc->atomic.hdr, data.atomic.hdrBlob);
     destroyBlob(data.atomic.fbDamage);
 }
 
@@ -457,7 +671,9 @@ bool Aquamarine::CDRMAtomicImpl::prepareConnector(Hyprutils::Memory::CSharedPoin
         if (!enable)
             data.atomic.modeBlob = 0;
         else {
-            if (drmModeCreatePropertyBlob(connector->backend->gpu->fd, &data.modeInfo, sizeof(drmModeModeInfo), &data.atomic.modeBlob)) {
+            // a forced modeset gets a blob of its own, in case whatever broke the last commit came with the cached one
+            data.atomic.modeBlob = connector->backend->blobs->acquire(CDRMBlobCache::AQ_DRM_BLOB_MODE, &data.modeInfo, sizeof(drmModeModeInfo), data.forcedModeset);
+            if (!data.atomic.modeBlob) {
                 connector->backend->backend->log(AQ_LOG_ERROR, "atomic drm: failed to create a modeset blob");
                 return false;
             }
@@ -468,7 +684,7 @@ bool Aquamarine::CDRMAtomicImpl::prepareConnector(Hyprutils::Memory::CSharedPoin
         }
     }
 
-    auto prepareGammaBlob = [connector](uint32_t prop, const std::vector<uint16_t>& gammaLut, uint32_t* blobId) -> bool {
+    auto prepareGammaBlob = [connector](uint32_t prop, const std::vector<uint16_t>& gammaLut, uint32_t* blobId, CDRMBlobCache::eBlobType type) -> bool {
         if (!prop) // TODO: allow this with legacy gamma, perhaps.
             connector->backend->backend->log(AQ_LOG_ERROR, "atomic drm: failed to commit gamma: no gamma_lut prop");
         else if (gammaLut.empty()) {
@@ -485,10 +701,10 @@ bool Aquamarine::CDRMAtomicImpl::prepareConnector(Hyprutils::Memory::CSharedPoin
                 lut.at(i).reserved = 0;
             }
 
-            if (drmModeCreatePropertyBlob(connector->backend->gpu->fd, lut.data(), lut.size() * sizeof(drm_color_lut), blobId)) {
+            *blobId = connector->backend->blobs->acquire(type, lut.data(), lut.size() * sizeof(drm_color_lut));
+            if (!*blobId)
                 connector->backend->backend->log(AQ_LOG_ERROR, "atomic drm: failed to create a gamma blob");
-                *blobId = 0;
-            } else
+            else
                 return true;
         }
 
@@ -501,10 +717,10 @@ bool Aquamarine::CDRMAtomicImpl::prepareConnector(Hyprutils::Memory::CSharedPoin
     // exists, otherwise we'd log a spurious "no gamma_lut prop" error per modeset.
     // (see #127)
     if ((data.modeset && connector->crtc->props.values.gamma_lut) || (data.committed & COutputState::AQ_OUTPUT_STATE_GAMMA_LUT))
-        data.atomic.gammad = prepareGammaBlob(connector->crtc->props.values.gamma_lut, STATE.gammaLut, &data.atomic.gammaLut);
+        data.atomic.gammad = prepareGammaBlob(connector->crtc->props.values.gamma_lut, STATE.gammaLut, &data.atomic.gammaLut, CDRMBlobCache::AQ_DRM_BLOB_GAMMA_LUT);
 
     if ((data.modeset && connector->crtc->props.values.degamma_lut) || (data.committed & COutputState::AQ_OUTPUT_STATE_DEGAMMA_LUT))
-        data.atomic.degammad = prepareGammaBlob(connector->crtc->props.values.degamma_lut, STATE.degammaLut, &data.atomic.degammaLut);
+        data.atomic.degammad = prepareGammaBlob(connector->crtc->props.values.degamma_lut, STATE.degammaLut, &data.atomic.degammaLut, CDRMBlobCache::AQ_DRM_BLOB_DEGAMMA_LUT);
 
     if (data.ctm.has_value()) {
         if (!connector->crtc->props.values.ctm)
@@ -522,10 +738,10 @@ bool Aquamarine::CDRMAtomicImpl::prepareConnector(Hyprutils::Memory::CSharedPoin
                 ctm.matrix[i] = doubleToS3132Fixed(data.ctm->getMatrix()[i]);
             }
 
-            if (drmModeCreatePropertyBlob(connector->backend->gpu->fd, &ctm, sizeof(drm_color_ctm), &data.atomic.ctmBlob)) {
+            data.atomic.ctmBlob = connector->backend->blobs->acquire(CDRMBlobCache::AQ_DRM_BLOB_CTM, &ctm, sizeof(drm_color_ctm));
+            if (!data.atomic.ctmBlob)
                 connector->backend->backend->log(AQ_LOG_ERROR, "atomic drm: failed to create a ctm blob");
-                data.atomic.ctmBlob = 0;
-            } else
+            else
                 data.atomic.ctmd = true;
         }
     }
@@ -534,10 +750,10 @@ bool Aquamarine::CDRMAtomicImpl::prepareConnector(Hyprutils::Memory::CSharedPoin
         if (!connector->props.values.hdr_output_metadata)
             connector->backend->backend->log(AQ_LOG_ERROR, "atomic drm: failed to commit hdr metadata: no HDR_OUTPUT_METADATA prop support");
         else {
-            if (drmModeCreatePropertyBlob(connector->backend->gpu->fd, &data.hdrMetadata.value(), sizeof(hdr_output_metadata), &data.atomic.hdrBlob)) {
+            data.atomic.hdrBlob = connector->backend->blobs->acquire(CDRMBlobCache::AQ_DRM_BLOB_HDR_METADATA, &data.hdrMetadata.value(), sizeof(hdr_output_metadata));
+            if (!data.atomic.hdrBlob) {
                 connector->backend->backend->log(AQ_LOG_ERROR, "atomic drm: failed to create a hdr metadata blob");
-                data.atomic.hdrBlob = 0;
-                data.atomic.hdrd    = false;
+                data.atomic.hdrd = false;
             } else {
                 data.atomic.hdrd = true;
                 TRACE(connector->backend->backend->log(
@@ -570,13 +786,80 @@ bool Aquamarine::CDRMAtomicImpl::prepareConnector(Hyprutils::Memory::CSharedPoin
     return true;
 }
 
+// Places the candidate layers on overlay planes, topmost first. Overlays stack above the primary plane, so
+// once a layer can't be placed, everything below it has to be composited as well, or it would end up
+// covering it. Each placement is validated with a TEST_ONLY commit of the whole connector state, at most
+// MAX_LAYER_TESTS of them per frame. Planes in taken are spoken for by another head of the same commit.
+void Aquamarine::CDRMAtomicImpl::placeLayers(Hyprutils::Memory::CSharedPointer<SDRMConnector> connector, SDRMConnectorCommitData& data, const std::vector<uint32_t>& taken) {
+    constexpr size_t MAX_LAYER_TESTS = 8;
+
+    for (auto& o : data.overlays) {
+        o.plane.reset();
+    }
+
+    if (data.overlays.empty() || connector->crtc->overlays.empty() || !data.mainFB || !data.enabled)
+        return;
+
+    const uint32_t FLAGS   = DRM_MODE_ATOMIC_TEST_ONLY | (data.modeset ? DRM_MODE_ATOMIC_ALLOW_MODESET : 0);
+    const auto&    PRIMARY = connector->crtc->primary;
+    const auto&    PLANES  = connector->crtc->overlays;
+    size_t         below   = PLANES.size(); // next layer must go on a plane below this index
+    size_t         tests   = 0;
+
+    for (auto& o : data.overlays) {
+        const auto DMABUF = o.fb->buffer->dmabuf();
+
+        for (size_t i = below; i > 0 && tests < MAX_LAYER_TESTS; --i) {
+            const auto& PLANE = PLANES.at(i - 1);
+            if (!PLANE->usableBy(connector->crtc->id) || std::ranges::find(taken, PLANE->id) != taken.end())
+                continue;
+
+            // the list is sorted by zpos, so once we're at or under the primary nothing below will do either.
+            // Without the prop on both, assume the usual overlays-above-primary.
+            if (PLANE->props.values.zpos && PRIMARY->props.values.zpos && PLANE->zpos <= PRIMARY->zpos)
+                break;
+
+            const auto FMT = std::ranges::find_if(PLANE->formats, [&DMABUF](const auto& f) { return f.drmFormat == DMABUF.format; });
+            if (FMT == PLANE->formats.end() || (DMABUF.modifier != DRM_FORMAT_MOD_INVALID && std::ranges::find(FMT->modifiers, DMABUF.modifier) == FMT->modifiers.end()))
+                continue;
+
+            o.plane = PLANE;
+            tests++;
+
+            CDRMAtomicRequest request(backend);
+            request.addConnector(connector, data);
+            if (request.commit(FLAGS)) {
+                TRACE(backend->log(AQ_LOG_TRACE, std::format("atomic drm: layer {} placed on overlay plane {}", o.layer, PLANE->id)));
+                below = i - 1;
+                break;
+            }
+
+            o.plane.reset();
+        }
+
+        if (!o.plane)
+            break;
+    }
+}
+
 bool Aquamarine::CDRMAtomicImpl::commit(Hyprutils::Memory::CSharedPointer<SDRMConnector> connector, SDRMConnectorCommitData& data) {
-    if (!prepareConnector(connector, data))
+    if (!prepareConnector(connector, data)) {
+        // hand back whatever blobs got acquired before it bailed
+        CDRMAtomicRequest request(backend);
+        request.setConnector(connector);
+        request.rollback(data);
         return false;
+    }
 
-    CDRMAtomicRequest request(backend);
+    placeLayers(connector, data);
 
-    request.addConnector(connector, data);
+    // the tests above ran while the blit was still drawing, the real thing needs its fence
+    if (!data.test && !data.awaitBlit()) {
+        CDRMAtomicRequest request(backend);
+        request.setConnector(connector);
+        request.rollback(data);
+        return false;
+    }
 
     uint32_t flags = data.flags;
     if (data.test)
@@ -586,6 +869,24 @@ bool Aquamarine::CDRMAtomicImpl::commit(Hyprutils::Memory::CSharedPointer<SDRMCo
     if (!data.blocking && !data.test)
         flags |= DRM_MODE_ATOMIC_NONBLOCK;
 
+    // A modeset that flips a buffer can sit in the ioctl for as long as the link takes to train. With a commit
+    // thread, check it synchronously, which is quick, and leave the real thing to the thread. Whatever fails the
+    // test takes the usual path below, with its retries.
+    if (backend->commitThread && data.modeset && data.blocking && !data.test && data.enabled && data.mainFB && (flags & DRM_MODE_PAGE_FLIP_EVENT)) {
+        auto threaded = makeShared<CDRMAtomicRequest>(backend);
+        threaded->addConnector(connector, data);
+
+        if (threaded->commit((flags & ~DRM_MODE_PAGE_FLIP_EVENT) | DRM_MODE_ATOMIC_TEST_ONLY) && CDRMAtomicRequest::commitAsync(threaded, flags)) {
+            threaded->apply(data);
+            cacheConnectorProps(connector, data);
+            return true;
+        }
+    }
+
+    CDRMAtomicRequest request(backend);
+
+    request.addConnector(connector, data);
+
     bool ok = request.commit(flags);
 
     // If the commit failed and max_bpc was actually emitted in this request, retry
@@ -616,13 +917,7 @@ bool Aquamarine::CDRMAtomicImpl::commit(Hyprutils::Memory::CSharedPointer<SDRMCo
         if (ok) {
             request2.apply(data);
             if (!data.test) {
-                connector->atomic.maxBpc      = data.atomic.maxBpc;
-                connector->atomic.colorspace  = data.atomic.colorspace;
-                connector->atomic.contentType = data.atomic.contentType;
-                connector->atomic.crtcID      = data.atomic.crtcID;
-                connector->atomic.propsCached = true;
-                if (data.atomic.ctmd)
-                    connector->crtc->atomic.ctmStateKnown = true;
+                cacheConnectorProps(connector, data);
 
                 if (data.mainFB && data.enabled && (flags & DRM_MODE_PAGE_FLIP_EVENT))
                     connector->sched.onFrameSubmitted();
@@ -661,24 +956,70 @@ bool Aquamarine::CDRMAtomicImpl::commit(Hyprutils::Memory::CSharedPointer<SDRMCo
 
     if (ok) {
         applied.apply(data);
-        if (!data.test) {
-            // remember which connector_state values the kernel last accepted so the
-            // next page-flip can skip emitting unchanged ones (see #265).
-            connector->atomic.maxBpc      = data.atomic.maxBpc;
-            connector->atomic.colorspace  = data.atomic.colorspace;
-            connector->atomic.contentType = data.atomic.contentType;
-            connector->atomic.crtcID      = data.atomic.crtcID;
-            connector->atomic.propsCached = true;
-            if (data.atomic.ctmd)
-                connector->crtc->atomic.ctmStateKnown = true;
-        }
+        if (!data.test)
+            cacheConnectorProps(connector, data);
     } else
         applied.rollback(data);
 
     return ok;
 }
 
+bool Aquamarine::CDRMAtomicImpl::commitGroup(std::vector<std::pair<SP<SDRMConnector>, SDRMConnectorCommitData*>>& heads) {
+    size_t prepared = 0;
+    for (; prepared < heads.size(); ++prepared) {
+        if (!prepareConnector(heads.at(prepared).first, *heads.at(prepared).second))
+            break;
+    }
+
+    CDRMAtomicRequest request(backend);
+
+    // callers only group vsync'd flips without a modeset, so one set of flags fits every head
+    bool ok = prepared == heads.size();
+    if (ok) {
+        std::vector<uint32_t> taken;
+        for (auto const& [connector, data] : heads) {
+            placeLayers(connector, *data, taken);
+            for (auto const& o : data->overlays) {
+                if (o.plane)
+                    taken.emplace_back(o.plane->id);
+            }
+
+            if (!data->awaitBlit()) {
+                ok = false;
+                break;
+            }
+
+            request.addConnector(connector, *data);
+        }
+
+        if (ok)
+            ok = request.commit(DRM_MODE_PAGE_FLIP_EVENT | DRM_MODE_ATOMIC_NONBLOCK);
+    }
+
+    // a head that failed to prepare may still hold some of its blobs, so it gets rolled back too
+    for (size_t i = 0; i < std::min(prepared + 1, heads.size()); ++i) {
+        auto& [connector, data] = heads.at(i);
+
+        request.setConnector(connector);
+        if (ok) {
+            request.apply(*data);
+            cacheConnectorProps(connector, *data);
+        } else
+            request.rollback(*data);
+    }
+
+    TRACE(backend->log(AQ_LOG_TRACE, std::format("atomic drm: group commit of {} heads {}", heads.size(), ok ? "succeeded" : "failed")));
+
+    return ok;
+}
+
 bool Aquamarine::CDRMAtomicImpl::reset() {
+    // the point is to put everything into a known state, so don't trust what we think the kernel has
+    backend->shadowProps.clear();
+
+    if (backend->commitThread)
+        backend->commitThread->flush();
+
     CDRMAtomicRequest request(backend);
 
     for (auto const& crtc : backend->crtcs) {
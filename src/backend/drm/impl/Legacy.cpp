@@ -150,12 +150,17 @@ bool Aquamarine::CDRMLegacyImpl::testInternal(Hyprutils::Memory::CSharedPointer<
 }
 
 bool Aquamarine::CDRMLegacyImpl::commit(Hyprutils::Memory::CSharedPointer<SDRMConnector> connector, SDRMConnectorCommitData& data) {
-    if (!testInternal(connector, data))
+    if (!testInternal(connector, data) || (!data.test && !data.awaitBlit()))
         return false;
 
     return commitInternal(connector, data);
 }
 
+bool Aquamarine::CDRMLegacyImpl::commitGroup(std::vector<std::pair<SP<SDRMConnector>, SDRMConnectorCommitData*>>& heads) {
+    // legacy has no way to flip several crtcs at once
+    return false;
+}
+
 bool Aquamarine::CDRMLegacyImpl::reset() {
     bool ok = true;
     for (auto const& connector : backend->connectors) {
@@ -1,5 +1,8 @@
 #include <aquamarine/buffer/Buffer.hpp>
 #include "Shared.hpp"
+#include <algorithm>
+#include <sys/stat.h>
+#include <unistd.h>
 
 using namespace Aquamarine;
 
@@ -19,6 +22,63 @@ void Aquamarine::IBuffer::endDataPtr() {
     ; // empty
 }
 
+SBufferDataRange Aquamarine::IBuffer::beginDataRange(const Hyprutils::Math::CRegion& region, uint32_t access) {
+    auto [data, format, len] = beginDataPtr(0);
+    if (!data || size.y < 1)
+        return {};
+
+    const auto BOX = dataRangeBox(region);
+    if (BOX.empty())
+        return {};
+
+    const size_t STRIDE = len / (size_t)size.y;
+    return {.data = data + (size_t)BOX.y * STRIDE + (size_t)BOX.x * 4, .format = format, .stride = STRIDE, .box = BOX};
+}
+
+void Aquamarine::IBuffer::endDataRange() {
+    endDataPtr();
+}
+
+size_t Aquamarine::IBuffer::allocatedBytes() {
+    if (type() == BUFFER_TYPE_SHM) {
+        const auto ATTRS = shm();
+        return ATTRS.success ? (size_t)ATTRS.stride * (size_t)ATTRS.size.y : 0;
+    }
+
+    const auto ATTRS = dmabuf();
+    if (!ATTRS.success)
+        return 0;
+
+    // a dmabuf's size is what the exporter allocated. Planes usually share one, under a different fd each
+    std::vector<ino_t> seen;
+    size_t             bytes = 0;
+    for (size_t i = 0; i < (size_t)ATTRS.planes; ++i) {
+        struct stat st;
+        if (ATTRS.fds.at(i) >= 0 && fstat(ATTRS.fds.at(i), &st) == 0) {
+            if (std::ranges::find(seen, st.st_ino) != seen.end())
+                continue;
+            seen.emplace_back(st.st_ino);
+
+            if (const auto END = lseek(ATTRS.fds.at(i), 0, SEEK_END); END > 0) {
+                bytes += END;
+                continue;
+            }
+        }
+
+        bytes += (size_t)ATTRS.strides.at(i) * (size_t)ATTRS.size.y;
+    }
+
+    return bytes;
+}
+
+Hyprutils::Math::CBox Aquamarine::IBuffer::dataRangeBox(const Hyprutils::Math::CRegion& region) {
+    const Hyprutils::Math::CBox FULL = {{}, size};
+    if (region.empty())
+        return FULL;
+
+    return region.copy().intersect(FULL).getExtents();
+}
+
 void Aquamarine::IBuffer::sendRelease() {
     ;
 }
@@ -2,12 +2,40 @@
 
 #include <iostream>
 #include <format>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <vector>
 #include <signal.h>
 
 namespace Aquamarine {
-    bool envEnabled(const std::string& env);
-    bool envExplicitlyDisabled(const std::string& env);
-    bool isTrace();
+    bool     envEnabled(const std::string& env);
+    bool     envExplicitlyDisabled(const std::string& env);
+    bool     isTrace();
+
+    // FNV-1a, good enough for cache keys. Don't use it for anything that needs to resist collisions on purpose.
+    uint64_t hashBytes(const void* data, size_t len, uint64_t seed = 0xcbf29ce484222325ULL);
+    uint64_t hashCombine(uint64_t seed, uint64_t value);
+
+    // $XDG_CACHE_HOME/aquamarine/sub (or ~/.cache), created if missing. Empty if there's nowhere to put it.
+    std::optional<std::filesystem::path> cacheDir(const std::string& sub);
+    std::optional<std::vector<uint8_t>>  readCacheFile(const std::filesystem::path& path);
+    // written to a temporary and renamed over path, so other processes never see half a file
+    bool writeCacheFile(const std::filesystem::path& path, std::span<const uint8_t> data);
+
+    // a memfd of len bytes sealed against resizing, so whoever it's shared with won't get a SIGBUS from under them. -1 on failure.
+    int createSealedMemfd(const char* name, size_t len, bool hugetlb = false);
+
+    // rows of the buffers we lay out ourselves (shm, udmabuf) start on a cache line, simd loops over them don't split loads
+    constexpr size_t STRIDE_ALIGN = 64;
+
+    constexpr size_t alignUp(size_t v, size_t align) {
+        return (v + align - 1) / align * align;
+    }
+
+    // DMA_BUF_IOCTL_SYNC with flags (DMA_BUF_SYNC_*), retried while the kernel says to
+    void syncDmabuf(int fd, uint64_t flags);
 };
 
 #define RASSERT(expr, reason, ...)                                                                                                                                                 \
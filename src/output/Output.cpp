@@ -1,4 +1,5 @@
 #include <aquamarine/output/Output.hpp>
+#include <algorithm>
 
 using namespace Aquamarine;
 
@@ -47,6 +48,105 @@ bool Aquamarine::IOutput::destroy() {
     return false;
 }
 
+size_t Aquamarine::IOutput::maxLayers() {
+    return 0;
+}
+
+void Aquamarine::IOutput::setRenderDeadline(std::chrono::nanoseconds deadline) {
+    ;
+}
+
+std::optional<std::chrono::steady_clock::time_point> Aquamarine::IOutput::predictedVblank() {
+    return std::nullopt;
+}
+
+const Aquamarine::COutputStats& Aquamarine::IOutput::getStats() {
+    return stats;
+}
+
+void Aquamarine::IOutput::resetStats() {
+    stats.reset();
+}
+
+size_t Aquamarine::COutputStats::historySize() const {
+    return count;
+}
+
+const Aquamarine::COutputStats::SFrame& Aquamarine::COutputStats::historyAt(size_t i) const {
+    return history.at((head + HISTORY_SIZE - count + i) % HISTORY_SIZE);
+}
+
+void Aquamarine::COutputStats::reset() {
+    *this = {};
+}
+
+void Aquamarine::COutputStats::onCommit(std::chrono::steady_clock::time_point when) {
+    commits++;
+    pendingCommit = when;
+    pendingBlit   = stagedBlit;
+    stagedBlit    = {};
+}
+
+void Aquamarine::COutputStats::onFailedCommit() {
+    stagedBlit = {};
+}
+
+void Aquamarine::COutputStats::onTestCommit() {
+    testCommits++;
+    stagedBlit = {}; // whatever got blitted for the test isn't the next frame
+}
+
+void Aquamarine::COutputStats::onModeset() {
+    modesets++;
+}
+
+void Aquamarine::COutputStats::onAsyncCommit() {
+    asyncCommits++;
+    stagedBlit = {};
+}
+
+void Aquamarine::COutputStats::onBlit(std::chrono::nanoseconds duration) {
+    blits++;
+    blitTime += duration;
+    maxBlitTime = std::max(maxBlitTime, duration);
+    stagedBlit  = duration;
+}
+
+void Aquamarine::COutputStats::onPresent(std::chrono::steady_clock::time_point when, uint32_t seq, std::chrono::nanoseconds refreshInterval) {
+    presents++;
+
+    SFrame frame;
+    frame.presented = when;
+    frame.seq       = seq;
+
+    if (pendingCommit) {
+        frame.committed = *pendingCommit;
+        frame.blit      = pendingBlit;
+
+        const auto MS = std::chrono::duration_cast<std::chrono::milliseconds>(when - *pendingCommit).count();
+        latency.at(std::clamp<int64_t>(MS, 0, LATENCY_BUCKETS - 1))++;
+
+        // a commit aims for the first vblank after it went out, anything later is a miss. Needs a vblank counter,
+        // drivers without one report 0.
+        if (lastPresent && lastSeq && seq && refreshInterval.count() > 0 && *pendingCommit >= *lastPresent) {
+            const uint32_t EXPECTED = lastSeq + (uint32_t)((*pendingCommit - *lastPresent) / refreshInterval) + 1;
+            if (seq > EXPECTED) {
+                frame.missed = seq - EXPECTED;
+                missedVblanks += frame.missed;
+            }
+        }
+    }
+
+    pendingCommit.reset();
+    pendingBlit = {};
+    lastPresent = when;
+    lastSeq     = seq;
+
+    history.at(head) = frame;
+    head             = (head + 1) % HISTORY_SIZE;
+    count            = std::min(count + 1, HISTORY_SIZE);
+}
+
 const Aquamarine::COutputState::SInternalState& Aquamarine::COutputState::state() {
     return internalState;
 }
@@ -150,7 +250,16 @@ void Aquamarine::COutputState::setColorRange(eOutputColorRange range) {
     internalState.colorRange = range;
 }
 
+void Aquamarine::COutputState::setLayers(const std::vector<SOutputLayer>& layers) {
+    internalState.layers = layers;
+    for (auto& l : internalState.layers) {
+        l.accepted = false;
+    }
+    internalState.committed |= AQ_OUTPUT_STATE_LAYERS;
+}
+
 void Aquamarine::COutputState::onCommit() {
     internalState.committed = 0;
     internalState.damage.clear();
+    internalState.layers.clear(); // layers are per frame, holding on to them would keep their buffers alive
 }
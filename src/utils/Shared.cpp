@@ -1,5 +1,12 @@
 #include "Shared.hpp"
+#include <cerrno>
 #include <cstdlib>
+#include <fstream>
+#include <fcntl.h>
+#include <linux/dma-buf.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 bool Aquamarine::envEnabled(const std::string& env) {
     auto e = getenv(env.c_str());
@@ -16,3 +23,106 @@ static bool trace = []() -> bool { return Aquamarine::envEnabled("AQ_TRACE"); }(
 bool        Aquamarine::isTrace() {
     return trace;
 }
+
+uint64_t Aquamarine::hashBytes(const void* data, size_t len, uint64_t seed) {
+    const auto* bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < len; ++i) {
+        seed ^= bytes[i];
+        seed *= 0x100000001b3ULL;
+    }
+    return seed;
+}
+
+uint64_t Aquamarine::hashCombine(uint64_t seed, uint64_t value) {
+    return hashBytes(&value, sizeof(value), seed);
+}
+
+std::optional<std::filesystem::path> Aquamarine::cacheDir(const std::string& sub) {
+    std::filesystem::path base;
+    if (auto e = getenv("XDG_CACHE_HOME"); e && *e)
+        base = e;
+    else if (auto e = getenv("HOME"); e && *e)
+        base = std::filesystem::path{e} / ".cache";
+    else
+        return std::nullopt;
+
+    const auto      DIR = base / "aquamarine" / sub;
+    std::error_code ec;
+    std::filesystem::create_directories(DIR, ec);
+    if (ec)
+        return std::nullopt;
+
+    return DIR;
+}
+
+std::optional<std::vector<uint8_t>> Aquamarine::readCacheFile(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.good())
+        return std::nullopt;
+
+    const auto SIZE = file.tellg();
+    if (SIZE <= 0)
+        return std::nullopt;
+
+    std::vector<uint8_t> data(SIZE);
+    file.seekg(0);
+    if (!file.read((char*)data.data(), SIZE))
+        return std::nullopt;
+
+    return data;
+}
+
+bool Aquamarine::writeCacheFile(const std::filesystem::path& path, std::span<const uint8_t> data) {
+    auto tmp = path;
+    tmp += std::format(".{}.tmp", getpid());
+
+    {
+        std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+        if (!file.good())
+            return false;
+
+        file.write((const char*)data.data(), data.size());
+        if (!file.good()) {
+            file.close();
+            std::error_code ec;
+            std::filesystem::remove(tmp, ec);
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        std::filesystem::remove(tmp, ec);
+        return false;
+    }
+
+    return true;
+}
+
+int Aquamarine::createSealedMemfd(const char* name, size_t len, bool hugetlb) {
+    const unsigned FLAGS = MFD_CLOEXEC | MFD_ALLOW_SEALING | (hugetlb ? MFD_HUGETLB : 0);
+    int            fd    = memfd_create(name, FLAGS);
+    if (fd < 0)
+        return -1;
+
+    int ret;
+    do {
+        ret = ftruncate(fd, len);
+    } while (ret < 0 && errno == EINTR);
+
+    if (ret < 0 || fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+void Aquamarine::syncDmabuf(int fd, uint64_t flags) {
+    dma_buf_sync sync = {.flags = flags};
+    int          ret;
+    do {
+        ret = ioctl(fd, DMA_BUF_IOCTL_SYNC, &sync);
+    } while (ret < 0 && (errno == EINTR || errno == EAGAIN));
+}
@@ -0,0 +1,132 @@
+#include <aquamarine/backend/drm/CPUBlit.hpp>
+#include <drm_fourcc.h>
+#include <cstring>
+#include "shared.hpp"
+
+using namespace Aquamarine;
+
+struct SImage {
+    SImage(int w, int h, uint32_t format, uint32_t fill, size_t padding = 0) : stride(w * 4 + padding) {
+        pixels.resize(stride * h / 4, fill);
+        image = {.data = (uint8_t*)pixels.data(), .stride = stride, .format = format, .size = {(double)w, (double)h}};
+    }
+
+    uint32_t& at(int x, int y) {
+        return pixels.at(y * stride / 4 + x);
+    }
+
+    size_t                stride = 0;
+    std::vector<uint32_t> pixels;
+    SCPUBlitImage         image;
+};
+
+static uint32_t argb2101010(uint32_t a, uint32_t r, uint32_t g, uint32_t b) {
+    return (a << 30) | (r << 20) | (g << 10) | b;
+}
+
+int main() {
+    int ret = 0;
+
+    EXPECT(CCPUBlitter::supported(DRM_FORMAT_ARGB8888, DRM_FORMAT_ABGR8888), true);
+    EXPECT(CCPUBlitter::supported(DRM_FORMAT_XRGB2101010, DRM_FORMAT_XRGB8888), true);
+    EXPECT(CCPUBlitter::supported(DRM_FORMAT_XRGB8888, DRM_FORMAT_XRGB2101010), false);
+    EXPECT(CCPUBlitter::supported(DRM_FORMAT_RGB565, DRM_FORMAT_RGB565), false);
+
+    CCPUBlitter blitter(4);
+
+    // odd sizes and padded rows, so the simd kernels run into their scalar tails
+    {
+        SImage from(67, 33, DRM_FORMAT_ARGB8888, 0, 12), to(67, 33, DRM_FORMAT_ABGR8888, 0, 4);
+        for (int y = 0; y < 33; ++y) {
+            for (int x = 0; x < 67; ++x) {
+                from.at(x, y) = 0x80000000 | (x << 16) | (y << 8) | 0x42;
+            }
+        }
+
+        EXPECT(blitter.blit(from.image, to.image), true);
+
+        bool ok = true;
+        for (int y = 0; y < 33; ++y) {
+            for (int x = 0; x < 67; ++x) {
+                ok = ok && to.at(x, y) == (0x80000000 | (0x42 << 16) | (y << 8) | x);
+            }
+        }
+        EXPECT(ok, true);
+    }
+
+    // an X source going into an A destination comes out opaque
+    {
+        SImage from(9, 1, DRM_FORMAT_XRGB8888, 0x00123456), to(9, 1, DRM_FORMAT_ARGB8888, 0);
+        EXPECT(blitter.blit(from.image, to.image), true);
+        EXPECT(to.at(8, 0), 0xFF123456);
+    }
+
+    // 10 bit keeps the top 8 bits of each channel
+    {
+        SImage from(11, 1, DRM_FORMAT_XRGB2101010, argb2101010(0, 1023, 512, 3)), to(11, 1, DRM_FORMAT_XRGB8888, 0);
+        EXPECT(blitter.blit(from.image, to.image), true);
+        EXPECT(to.at(10, 0), 0xFFFF8000);
+
+        SImage alpha(11, 1, DRM_FORMAT_ARGB2101010, argb2101010(2, 4, 1023, 0)), swapped(11, 1, DRM_FORMAT_ABGR8888, 0);
+        EXPECT(blitter.blit(alpha.image, swapped.image), true);
+        EXPECT(swapped.at(10, 0), 0xAA00FF01);
+    }
+
+    // only the damage is touched
+    {
+        SImage from(64, 64, DRM_FORMAT_XRGB8888, 0x00FFFFFF), to(64, 64, DRM_FORMAT_XRGB8888, 0);
+        EXPECT(blitter.blit(from.image, to.image, Hyprutils::Math::CRegion{4, 4, 8, 8}), true);
+        EXPECT(to.at(4, 4), 0x00FFFFFF);
+        EXPECT(to.at(11, 11), 0x00FFFFFF);
+        EXPECT(to.at(12, 11), 0u);
+        EXPECT(to.at(3, 4), 0u);
+    }
+
+    // big enough to go over the workers
+    {
+        SImage from(1920, 1080, DRM_FORMAT_XBGR8888, 0), to(1920, 1080, DRM_FORMAT_XRGB8888, 0);
+        for (size_t i = 0; i < from.pixels.size(); ++i) {
+            from.pixels.at(i) = i * 2654435761U;
+        }
+
+        EXPECT(blitter.blit(from.image, to.image), true);
+
+        bool ok = true;
+        for (size_t i = 0; i < to.pixels.size(); ++i) {
+            const uint32_t P = from.pixels.at(i);
+            ok               = ok && to.pixels.at(i) == ((P & 0xFF00FF00) | ((P >> 16) & 0xFF) | ((P & 0xFF) << 16));
+        }
+        EXPECT(ok, true);
+    }
+
+    // streaming stores into a write-combined destination, unaligned damage so they have a head and a tail to do
+    {
+        SImage from(300, 200, DRM_FORMAT_ARGB8888, 0), to(300, 200, DRM_FORMAT_XBGR8888, 0), copy(300, 200, DRM_FORMAT_ARGB8888, 0);
+        for (size_t i = 0; i < from.pixels.size(); ++i) {
+            from.pixels.at(i) = i * 2654435761U;
+        }
+
+        to.image.writeCombined   = true;
+        copy.image.writeCombined = true;
+        EXPECT(blitter.blit(from.image, to.image, Hyprutils::Math::CRegion{3, 5, 291, 190}), true);
+        EXPECT(blitter.blit(from.image, copy.image, Hyprutils::Math::CRegion{3, 5, 291, 190}), true);
+
+        bool ok = true;
+        for (int y = 0; y < 200; ++y) {
+            for (int x = 0; x < 300; ++x) {
+                const bool     IN = x >= 3 && x < 294 && y >= 5 && y < 195;
+                const uint32_t P  = from.at(x, y);
+                ok = ok && to.at(x, y) == (IN ? ((P & 0xFF00FF00) | ((P >> 16) & 0xFF) | ((P & 0xFF) << 16)) : 0u);
+                ok = ok && copy.at(x, y) == (IN ? P : 0u);
+            }
+        }
+        EXPECT(ok, true);
+    }
+
+    {
+        SImage a(4, 4, DRM_FORMAT_XRGB8888, 0), b(4, 5, DRM_FORMAT_XRGB8888, 0);
+        EXPECT(blitter.blit(a.image, b.image), false);
+    }
+
+    return ret;
+}
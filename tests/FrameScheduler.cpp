@@ -0,0 +1,57 @@
+#include <aquamarine/backend/FrameScheduler.hpp>
+#include "shared.hpp"
+
+using namespace std::chrono;
+
+int main() {
+    Aquamarine::CFrameScheduler sched;
+    int                         ret = 0;
+
+    const auto                  START    = steady_clock::time_point{seconds{100}};
+    const auto                  INTERVAL = nanoseconds{16'666'666};
+
+    // nothing to predict from yet
+    EXPECT(sched.predictNextVblank(START).has_value(), false);
+    EXPECT(sched.frameEventTime(START).has_value(), false);
+
+    sched.onVblank(START, 1, INTERVAL);
+    EXPECT((sched.predictNextVblank(START + milliseconds{1}).value() - START).count(), INTERVAL.count());
+
+    // a few idle frames later, still lands on the vblank grid
+    EXPECT((sched.predictNextVblank(START + INTERVAL * 3 + milliseconds{1}).value() - START).count(), (INTERVAL * 4).count());
+
+    // no deadline, no holding back
+    EXPECT(sched.frameEventTime(START + milliseconds{1}).has_value(), false);
+
+    sched.setRenderDeadline(milliseconds{2});
+    sched.addRenderTime(milliseconds{4});
+    sched.addRenderTime(milliseconds{3});
+    EXPECT(sched.renderTimeEstimate() == milliseconds{4}, true);
+    EXPECT((sched.frameEventTime(START + milliseconds{1}).value() - START).count(), (INTERVAL - milliseconds{6}).count());
+
+    // too late to wait for that vblank, go now
+    EXPECT(sched.frameEventTime(START + milliseconds{12}).has_value(), false);
+
+    // the measured refresh pulls the estimate in, but only slowly
+    sched.onVblank(START + INTERVAL + microseconds{80}, 2, INTERVAL);
+    const auto NEXT = sched.predictNextVblank(START + INTERVAL + milliseconds{1}).value() - (START + INTERVAL + microseconds{80});
+    EXPECT(NEXT > INTERVAL && NEXT < INTERVAL + microseconds{80}, true);
+
+    // a frame that got committed in time counts
+    Aquamarine::CFrameScheduler timed;
+    timed.onVblank(START, 1, INTERVAL);
+    timed.onRenderStart(START + milliseconds{1});
+    timed.onFrameSubmitted(START + milliseconds{6});
+    EXPECT(timed.renderTimeEstimate() == milliseconds{5}, true);
+
+    // one the consumer never committed doesn't, whatever got submitted much later wasn't rendered for it
+    timed.onRenderStart(START + milliseconds{1});
+    timed.onFrameSubmitted(START + seconds{1});
+    EXPECT(timed.renderTimeEstimate() == milliseconds{5}, true);
+
+    // a different mode starts over at its nominal interval
+    sched.onVblank(START + seconds{1}, 100, INTERVAL / 2);
+    EXPECT((sched.predictNextVblank(START + seconds{1} + milliseconds{1}).value() - (START + seconds{1})).count(), (INTERVAL / 2).count());
+
+    return ret;
+}
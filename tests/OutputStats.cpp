@@ -0,0 +1,69 @@
+#include <aquamarine/output/Output.hpp>
+#include "shared.hpp"
+
+using namespace std::chrono;
+
+// what the backends get to call, as a friend
+class CTestStats : public Aquamarine::COutputStats {
+  public:
+    using COutputStats::onBlit;
+    using COutputStats::onCommit;
+    using COutputStats::onFailedCommit;
+    using COutputStats::onPresent;
+    using COutputStats::onTestCommit;
+};
+
+int main() {
+    CTestStats stats;
+    int        ret = 0;
+
+    const auto START    = steady_clock::time_point{seconds{100}};
+    const auto INTERVAL = nanoseconds{16'666'666};
+
+    // a plain commit -> flip
+    stats.onCommit(START);
+    stats.onPresent(START + milliseconds{5}, 10, INTERVAL);
+    EXPECT(stats.commits, 1);
+    EXPECT(stats.presents, 1);
+    EXPECT(stats.latency.at(5), 1);
+    EXPECT(stats.historySize(), 1);
+    EXPECT(stats.historyAt(0).seq, 10);
+    EXPECT(stats.historyAt(0).blit.count(), 0);
+    EXPECT(stats.historyAt(0).missed, 0);
+
+    // a blit for a commit that failed isn't the next frame's
+    stats.onBlit(milliseconds{2});
+    stats.onFailedCommit();
+    stats.onCommit(START + INTERVAL);
+    stats.onPresent(START + INTERVAL + milliseconds{5}, 11, INTERVAL);
+    EXPECT(stats.blits, 1);
+    EXPECT(stats.historyAt(1).blit.count(), 0);
+
+    // neither is one for a test
+    stats.onBlit(milliseconds{2});
+    stats.onTestCommit();
+    stats.onCommit(START + INTERVAL * 2);
+    stats.onPresent(START + INTERVAL * 2 + milliseconds{5}, 12, INTERVAL);
+    EXPECT(stats.testCommits, 1);
+    EXPECT(stats.historyAt(2).blit.count(), 0);
+
+    // a blit that went out with its commit lands on that frame, even with the next one blitted before the flip
+    stats.onBlit(milliseconds{3});
+    stats.onCommit(START + INTERVAL * 3);
+    stats.onBlit(milliseconds{1});
+    stats.onPresent(START + INTERVAL * 3 + milliseconds{5}, 13, INTERVAL);
+    EXPECT(duration_cast<milliseconds>(stats.historyAt(3).blit).count(), 3);
+    EXPECT(duration_cast<milliseconds>(stats.maxBlitTime).count(), 3);
+
+    // flipped two vblanks after the one it was aiming for
+    stats.onCommit(START + INTERVAL * 4);
+    stats.onPresent(START + INTERVAL * 6 + milliseconds{5}, 16, INTERVAL);
+    EXPECT(stats.historyAt(4).missed, 2);
+    EXPECT(stats.missedVblanks, 2);
+
+    stats.reset();
+    EXPECT(stats.commits, 0);
+    EXPECT(stats.historySize(), 0);
+
+    return ret;
+}
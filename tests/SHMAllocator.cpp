@@ -0,0 +1,71 @@
+#include <aquamarine/allocator/SHM.hpp>
+#include <aquamarine/allocator/Swapchain.hpp>
+#include <aquamarine/backend/Backend.hpp>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "shared.hpp"
+
+using namespace Aquamarine;
+using namespace Hyprutils::Memory;
+
+int main() {
+    int                           ret = 0;
+
+    SBackendImplementationOptions nullOptions;
+    nullOptions.backendType        = AQ_BACKEND_NULL;
+    nullOptions.backendRequestMode = AQ_BACKEND_REQUEST_MANDATORY;
+
+    auto backend   = CBackend::create({nullOptions}, SBackendOptions{});
+    auto allocator = CSHMAllocator::create(backend);
+    auto swapchain = CSwapchain::create(allocator, backend->getImplementations().at(0));
+
+    EXPECT(allocator->type(), AQ_ALLOCATOR_TYPE_SHM);
+
+    // big enough for huge pages, and a width that doesn't line up by itself
+    EXPECT(swapchain->reconfigure(SSwapchainOptions{.length = 2, .size = {1921, 1080}, .scanout = true}), true);
+    EXPECT(swapchain->currentOptions().format, DRM_FORMAT_XRGB8888);
+
+    auto buf   = swapchain->next(nullptr);
+    auto attrs = buf->shm();
+    EXPECT(buf->type(), BUFFER_TYPE_SHM);
+    EXPECT(buf->caps() & BUFFER_CAPABILITY_DATAPTR, BUFFER_CAPABILITY_DATAPTR);
+    EXPECT(attrs.success, true);
+    EXPECT(attrs.stride % 64, 0);
+    EXPECT(attrs.stride >= 1921 * 4, true);
+
+    // sealed, nobody can shrink it from under whoever maps it
+    const int SEALS = fcntl(attrs.fd, F_GET_SEALS);
+    EXPECT(SEALS & (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL), F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+    EXPECT(ftruncate(attrs.fd, 4096), -1);
+
+    // what goes in through the data ptr is what someone mapping the fd sees
+    auto [data, format, len] = buf->beginDataPtr(0);
+    EXPECT(format, DRM_FORMAT_XRGB8888);
+    EXPECT(len, (size_t)attrs.stride * 1080);
+    memset(data + attrs.stride * 1079, 0x42, 1921 * 4);
+    buf->endDataPtr();
+
+    auto mapped = (uint8_t*)mmap(nullptr, len, PROT_READ, MAP_SHARED, attrs.fd, 0);
+    EXPECT(mapped != MAP_FAILED, true);
+    if (mapped != MAP_FAILED) {
+        EXPECT(mapped[attrs.stride * 1079 + 1921 * 4 - 1], 0x42);
+        munmap(mapped, len);
+    }
+
+    // both buffers counted with their whole mapping, rounded up for huge pages or not
+    auto stats = allocator->stats();
+    EXPECT(stats.buffers, 2);
+    EXPECT(buf->allocatedBytes() >= len, true);
+    EXPECT(stats.bytes, 2 * buf->allocatedBytes());
+    EXPECT(stats.formats.size(), 1);
+    EXPECT(stats.formats.at(0).format, DRM_FORMAT_XRGB8888);
+    EXPECT(swapchain->stats().bytes, stats.bytes);
+
+    // only 32bpp
+    EXPECT(CSHMAllocator::supportsFormat(DRM_FORMAT_RGB565), false);
+    EXPECT(swapchain->reconfigure(SSwapchainOptions{.length = 2, .size = {64, 64}, .format = DRM_FORMAT_RGB565}), false);
+
+    return ret;
+}
@@ -0,0 +1,370 @@
+#include <aquamarine/allocator/Swapchain.hpp>
+#include <aquamarine/backend/Backend.hpp>
+#include <hyprutils/memory/WeakPtr.hpp>
+#include <atomic>
+#include <poll.h>
+#include <thread>
+#include "shared.hpp"
+
+using namespace Aquamarine;
+using namespace Hyprutils::Memory;
+#define SP CSharedPointer
+#define WP CWeakPointer
+
+class CTestBuffer : public IBuffer {
+  public:
+    eBufferCapability caps() override {
+        return BUFFER_CAPABILITY_NONE;
+    }
+
+    eBufferType type() override {
+        return BUFFER_TYPE_SHM;
+    }
+
+    void update(const Hyprutils::Math::CRegion& damage) override {
+        ;
+    }
+
+    bool isSynchronous() override {
+        return true;
+    }
+
+    bool good() override {
+        return true;
+    }
+
+    SSHMAttrs shm() override {
+        return {.success = true, .format = DRM_FORMAT_XRGB8888, .size = size, .stride = (int)size.x * 4};
+    }
+};
+
+class CTestJob : public IAllocationJob {
+  public:
+    void run() override {
+        ranOn = std::this_thread::get_id();
+    }
+
+    SP<IBuffer> finish() override {
+        auto buf  = makeShared<CTestBuffer>();
+        buf->size = size;
+        return buf;
+    }
+
+    Hyprutils::Math::Vector2D size;
+    std::thread::id           ranOn;
+};
+
+class CTestAllocator : public IAllocator {
+  public:
+    CTestAllocator(SP<CBackend> backend_) : backend(backend_) {
+        ;
+    }
+
+    SP<IBuffer> acquire(const SAllocatorBufferParams& params, SP<CSwapchain> swapchain) override {
+        auto buf  = makeShared<CTestBuffer>();
+        buf->size = params.size;
+        buffers.emplace_back(buf);
+        return buf;
+    }
+
+    SP<CBackend> getBackend() override {
+        return backend.lock();
+    }
+
+    int drmFD() override {
+        return -1;
+    }
+
+    eAllocatorType type() override {
+        return AQ_ALLOCATOR_TYPE_DRM_DUMB;
+    }
+
+    SP<IAllocationJob> prepareAcquire(const SAllocatorBufferParams& params, SP<CSwapchain> swapchain) override {
+        auto job  = makeShared<CTestJob>();
+        job->size = params.size;
+        jobs.emplace_back(job);
+        return job;
+    }
+
+    SAllocatorStats stats() override {
+        SAllocatorStats stats;
+        for (auto const& b : buffers) {
+            stats.add(b.lock());
+        }
+        stats.readbackBytes = readback;
+        return stats;
+    }
+
+    WP<CBackend>              backend;
+    std::vector<SP<CTestJob>> jobs;
+    std::vector<WP<IBuffer>>  buffers;
+    size_t                    readback = 0;
+};
+
+// runs the backend's poll fds until done, or for a second at most
+static void dispatchUntil(SP<CBackend> backend, const std::function<bool()>& done) {
+    for (int i = 0; i < 100 && !done(); ++i) {
+        for (auto const& fd : backend->getPollFDs()) {
+            pollfd pfd = {.fd = fd->fd, .events = POLLIN, .revents = 0};
+            if (fd->fd >= 0 && poll(&pfd, 1, 10) > 0)
+                fd->onSignal();
+        }
+    }
+}
+
+int main() {
+    int                           ret = 0;
+
+    SBackendImplementationOptions nullOptions;
+    nullOptions.backendType        = AQ_BACKEND_NULL;
+    nullOptions.backendRequestMode = AQ_BACKEND_REQUEST_MANDATORY;
+
+    auto backend = CBackend::create({nullOptions}, SBackendOptions{});
+
+    // buffer ages. Every case gets an allocator and a swapchain of its own
+    {
+        auto allocator = makeShared<CTestAllocator>(backend);
+        auto swapchain = CSwapchain::create(allocator, backend->getImplementations().at(0));
+
+        EXPECT(swapchain->reconfigure(SSwapchainOptions{.length = 3, .size = {64, 64}, .format = DRM_FORMAT_XRGB8888}), true);
+
+        int age = -1;
+
+        // nothing was ever on screen
+        auto a = swapchain->next(&age);
+        EXPECT(age, 0);
+        swapchain->presented(a);
+        auto b = swapchain->next(&age);
+        EXPECT(age, 0);
+        swapchain->presented(b);
+        auto c = swapchain->next(&age);
+        EXPECT(age, 0);
+        swapchain->presented(c);
+
+        // a went out three presentations ago
+        EXPECT(swapchain->next(&age) == a, true);
+        EXPECT(age, 3);
+        swapchain->presented(a);
+
+        // a buffer that's not ours changes nothing
+        swapchain->presented(makeShared<CTestBuffer>());
+
+        EXPECT(swapchain->next(&age) == b, true);
+        EXPECT(age, 3);
+
+        // b got drawn into but the commit failed, it holds no known frame anymore
+        swapchain->rollback();
+        EXPECT(swapchain->next(&age) == b, true);
+        EXPECT(age, 0);
+        swapchain->presented(b);
+
+        // growing keeps the ages of what's there
+        EXPECT(swapchain->reconfigure(SSwapchainOptions{.length = 4, .size = {64, 64}, .format = DRM_FORMAT_XRGB8888}), true);
+        auto d = swapchain->next(&age);
+        EXPECT(age, 0);
+        swapchain->presented(d);
+        EXPECT(swapchain->next(&age) == c, true);
+        EXPECT(age, 4);
+
+        // new buffers, nothing known
+        EXPECT(swapchain->reconfigure(SSwapchainOptions{.length = 4, .size = {128, 128}, .format = DRM_FORMAT_XRGB8888}), true);
+        for (int i = 0; i < 4; ++i) {
+            swapchain->next(&age);
+            EXPECT(age, 0);
+        }
+    }
+
+    // held buffers
+    {
+        auto allocator = makeShared<CTestAllocator>(backend);
+        auto swapchain = CSwapchain::create(allocator, backend->getImplementations().at(0));
+        int  age       = -1;
+
+        // buffers still held aren't handed out, and when all of them are it grows
+        const SSwapchainOptions DOUBLE = {.length = 2, .size = {64, 64}, .format = DRM_FORMAT_XRGB8888};
+        EXPECT(swapchain->reconfigure(DOUBLE), true);
+
+        auto onScreen             = swapchain->next(nullptr);
+        onScreen->lockedByBackend = true;
+        auto drawing              = swapchain->next(nullptr);
+        drawing->lock();
+        EXPECT(drawing != onScreen, true);
+
+        auto extra = swapchain->next(&age);
+        EXPECT(extra != onScreen && extra != drawing, true);
+        EXPECT(age, 0);
+
+        extra->lockedByBackend  = true;
+        auto extra2             = swapchain->next(nullptr);
+        extra2->lockedByBackend = true;
+        EXPECT(extra2 != onScreen && extra2 != drawing && extra2 != extra, true);
+
+        // at the cap, it has to reuse one
+        EXPECT(swapchain->contains(swapchain->next(nullptr)), true);
+
+        // reconfiguring with the same options keeps the extra ones
+        EXPECT(swapchain->reconfigure(DOUBLE), true);
+        EXPECT(swapchain->contains(extra2), true);
+
+        onScreen->lockedByBackend = false;
+        drawing->unlock();
+        extra->lockedByBackend  = false;
+        extra2->lockedByBackend = false;
+
+        // calms down, back to the length asked for
+        for (int i = 0; i < 1000; ++i) {
+            swapchain->next(nullptr);
+        }
+
+        int left = 0;
+        for (auto const& b : {onScreen, drawing, extra, extra2}) {
+            left += swapchain->contains(b);
+        }
+        EXPECT(left, 2);
+    }
+
+    // background reconfigures
+    {
+        auto allocator = makeShared<CTestAllocator>(backend);
+        auto swapchain = CSwapchain::create(allocator, backend->getImplementations().at(0));
+        int  age       = -1;
+
+        // a new generation comes in off the main thread, the current one keeps being handed out until then
+        const Hyprutils::Math::Vector2D SMALL = {64, 64}, MEDIUM = {256, 256}, LARGE = {512, 512};
+        EXPECT(swapchain->reconfigure(SSwapchainOptions{.length = 2, .size = SMALL, .format = DRM_FORMAT_XRGB8888}), true);
+
+        int result = -1;
+        swapchain->reconfigureAsync(SSwapchainOptions{.length = 3, .size = MEDIUM, .format = DRM_FORMAT_XRGB8888}, [&result](bool ok) { result = ok; });
+        EXPECT(swapchain->reconfigurePending(), true);
+        EXPECT(swapchain->next(nullptr)->size == SMALL, true);
+
+        dispatchUntil(backend, [&result] { return result != -1; });
+        EXPECT(result, 1);
+        EXPECT(swapchain->reconfigurePending(), false);
+        EXPECT(swapchain->currentOptions().size == MEDIUM, true);
+        EXPECT(swapchain->next(&age)->size == MEDIUM, true);
+        EXPECT(age, 0);
+
+        bool offThread = !allocator->jobs.empty();
+        for (auto const& j : allocator->jobs) {
+            offThread = offThread && j->ranOn != std::thread::id{} && j->ranOn != std::this_thread::get_id();
+        }
+        EXPECT(offThread, true);
+
+        // the later one wins
+        int first = -1, second = -1;
+        swapchain->reconfigureAsync(SSwapchainOptions{.length = 2, .size = SMALL, .format = DRM_FORMAT_XRGB8888}, [&first](bool ok) { first = ok; });
+        swapchain->reconfigureAsync(SSwapchainOptions{.length = 2, .size = LARGE, .format = DRM_FORMAT_XRGB8888}, [&second](bool ok) { second = ok; });
+        EXPECT(first, 0);
+
+        dispatchUntil(backend, [&second] { return second != -1; });
+        EXPECT(second, 1);
+        EXPECT(swapchain->next(nullptr)->size == LARGE, true);
+
+        // a plain reconfigure does too, and what was still being allocated doesn't make it in afterwards
+        int third = -1;
+        swapchain->reconfigureAsync(SSwapchainOptions{.length = 2, .size = MEDIUM, .format = DRM_FORMAT_XRGB8888}, [&third](bool ok) { third = ok; });
+        EXPECT(swapchain->reconfigure(SSwapchainOptions{.length = 2, .size = SMALL, .format = DRM_FORMAT_XRGB8888}), true);
+        EXPECT(third, 0);
+
+        dispatchUntil(backend, [] { return false; });
+        EXPECT(swapchain->next(nullptr)->size == SMALL, true);
+
+        // nothing new to allocate, done right away
+        int same = -1;
+        swapchain->reconfigureAsync(SSwapchainOptions{.length = 3, .size = SMALL, .format = DRM_FORMAT_XRGB8888}, [&same](bool ok) { same = ok; });
+        EXPECT(same, 1);
+        EXPECT(swapchain->reconfigurePending(), false);
+
+        // asking for the pending one again keeps it going
+        const SSwapchainOptions NEXT  = {.length = 3, .size = MEDIUM, .format = DRM_FORMAT_XRGB8888};
+        int                     asked = -1, askedAgain = -1;
+        swapchain->reconfigureAsync(NEXT, [&asked](bool ok) { asked = ok; });
+        swapchain->reconfigureAsync(NEXT, [&askedAgain](bool ok) { askedAgain = ok; });
+        EXPECT(asked, -1);
+
+        dispatchUntil(backend, [&askedAgain] { return askedAgain != -1; });
+        EXPECT(asked, 1);
+        EXPECT(askedAgain, 1);
+        EXPECT(swapchain->next(nullptr)->size == MEDIUM, true);
+
+        // staying with the current ones wins too
+        int stay = -1;
+        swapchain->reconfigureAsync(SSwapchainOptions{.length = 3, .size = LARGE, .format = DRM_FORMAT_XRGB8888}, [&stay](bool ok) { stay = ok; });
+        EXPECT(swapchain->reconfigure(NEXT), true);
+        EXPECT(stay, 0);
+
+        dispatchUntil(backend, [] { return false; });
+        EXPECT(swapchain->next(nullptr)->size == MEDIUM, true);
+    }
+
+    // stats and budgets
+    {
+        auto                            allocator = makeShared<CTestAllocator>(backend);
+        auto                            swapchain = CSwapchain::create(allocator, backend->getImplementations().at(0));
+
+        const Hyprutils::Math::Vector2D SMALL = {64, 64}, MEDIUM = {256, 256};
+        EXPECT(swapchain->reconfigure(SSwapchainOptions{.length = 3, .size = SMALL, .format = DRM_FORMAT_XRGB8888}), true);
+
+        // what's held gets counted, per swapchain and for the whole allocator
+        const size_t SMALL_BYTES = 64 * 64 * 4, TINY_BYTES = 32 * 32 * 4;
+        auto         stats       = swapchain->stats();
+        EXPECT(stats.buffers, 3);
+        EXPECT(stats.bytes, 3 * SMALL_BYTES);
+        EXPECT(stats.formats.size(), 1);
+        EXPECT(stats.formats.at(0).format, DRM_FORMAT_XRGB8888);
+        EXPECT(stats.formats.at(0).modifier, DRM_FORMAT_MOD_LINEAR);
+        EXPECT(allocator->stats().bytes >= stats.bytes, true);
+
+        // without a budget of its own the backend's applies
+        backend->setAllocatorBudget(1234);
+        EXPECT(allocator->getBudget(), 1234);
+        backend->setAllocatorBudget(0);
+
+        // no room for another one
+        allocator->setBudget(allocator->stats().bytes);
+        EXPECT(swapchain->reconfigure(SSwapchainOptions{.length = 4, .size = SMALL, .format = DRM_FORMAT_XRGB8888}), false);
+        EXPECT(swapchain->stats().buffers, 3);
+
+        // nor for bigger ones, even with the current ones going away
+        EXPECT(swapchain->reconfigure(SSwapchainOptions{.length = 3, .size = MEDIUM, .format = DRM_FORMAT_XRGB8888}), false);
+        EXPECT(swapchain->currentOptions().size == SMALL, true);
+
+        // smaller ones fit into what they leave
+        EXPECT(swapchain->reconfigure(SSwapchainOptions{.length = 3, .size = {32, 32}, .format = DRM_FORMAT_XRGB8888}), true);
+        EXPECT(swapchain->stats().bytes, 3 * TINY_BYTES);
+
+        // all of them held, but it can't grow
+        allocator->setBudget(allocator->stats().bytes);
+        std::vector<SP<IBuffer>> held;
+        for (int i = 0; i < 3; ++i) {
+            held.emplace_back(swapchain->next(nullptr));
+            held.back()->lockedByBackend = true;
+        }
+        EXPECT(swapchain->contains(swapchain->next(nullptr)), true);
+        EXPECT(swapchain->stats().buffers, 3);
+
+        // it can without the budget, and gives that one back right away once it's over it again
+        allocator->setBudget(0);
+        held.emplace_back(swapchain->next(nullptr));
+        EXPECT(swapchain->stats().buffers, 4);
+        for (auto const& h : held) {
+            h->lockedByBackend = false;
+        }
+
+        allocator->setBudget(allocator->stats().bytes - 1);
+        swapchain->next(nullptr);
+        EXPECT(swapchain->stats().buffers, 3);
+        allocator->setBudget(0);
+
+        // copies for another gpu count against it too
+        allocator->setBudget(allocator->stats().bytes);
+        EXPECT(allocator->fitsBudget(0), true);
+        allocator->readback = 1;
+        EXPECT(allocator->fitsBudget(0), false);
+        allocator->readback = 0;
+        allocator->setBudget(0);
+    }
+
+    return ret;
+}
@@ -0,0 +1,69 @@
+#include <aquamarine/allocator/Udmabuf.hpp>
+#include <aquamarine/allocator/Swapchain.hpp>
+#include <aquamarine/backend/Backend.hpp>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "shared.hpp"
+
+using namespace Aquamarine;
+using namespace Hyprutils::Memory;
+
+int main() {
+    int                           ret = 0;
+
+    SBackendImplementationOptions nullOptions;
+    nullOptions.backendType        = AQ_BACKEND_NULL;
+    nullOptions.backendRequestMode = AQ_BACKEND_REQUEST_MANDATORY;
+
+    auto backend   = CBackend::create({nullOptions}, SBackendOptions{});
+    auto allocator = CUdmabufAllocator::create(backend);
+
+    // no udmabuf module here, nothing to test
+    if (!allocator) {
+        std::cout << "/dev/udmabuf isn't available, skipping\n";
+        return 0;
+    }
+
+    auto swapchain = CSwapchain::create(allocator, backend->getImplementations().at(0));
+
+    EXPECT(allocator->type(), AQ_ALLOCATOR_TYPE_UDMABUF);
+    EXPECT(allocator->drmFD(), -1);
+
+    EXPECT(swapchain->reconfigure(SSwapchainOptions{.length = 2, .size = {333, 77}, .scanout = true}), true);
+    EXPECT(swapchain->currentOptions().format, DRM_FORMAT_XRGB8888);
+
+    auto buf   = swapchain->next(nullptr);
+    auto attrs = buf->dmabuf();
+    EXPECT(buf->type(), BUFFER_TYPE_DMABUF);
+    EXPECT(buf->caps() & BUFFER_CAPABILITY_DATAPTR, BUFFER_CAPABILITY_DATAPTR);
+    EXPECT(attrs.success, true);
+    EXPECT(attrs.planes, 1);
+    EXPECT(attrs.modifier, DRM_FORMAT_MOD_LINEAR);
+    EXPECT(attrs.strides.at(0) % 64, 0u);
+    EXPECT(attrs.fds.at(0) >= 0, true);
+
+    // the cpu writes land in what an importer of the dmabuf sees
+    auto [data, format, len] = buf->beginDataPtr(0);
+    EXPECT(format, DRM_FORMAT_XRGB8888);
+    EXPECT(len, (size_t)attrs.strides.at(0) * 77);
+    memset(data + attrs.strides.at(0) * 76, 0x42, 333 * 4);
+    buf->endDataPtr();
+
+    auto mapped = (uint8_t*)mmap(nullptr, len, PROT_READ, MAP_SHARED, attrs.fds.at(0), 0);
+    EXPECT(mapped != MAP_FAILED, true);
+    if (mapped != MAP_FAILED) {
+        EXPECT(mapped[attrs.strides.at(0) * 76 + 333 * 4 - 1], 0x42);
+        munmap(mapped, len);
+    }
+
+    const auto STATS = allocator->stats();
+    EXPECT(STATS.buffers, 2);
+    EXPECT(STATS.formats.size(), 1);
+    EXPECT(STATS.formats.at(0).format, DRM_FORMAT_XRGB8888);
+    EXPECT(swapchain->stats().bytes, STATS.bytes);
+
+    EXPECT(swapchain->reconfigure(SSwapchainOptions{.length = 2, .size = {64, 64}, .format = DRM_FORMAT_RGB565}), false);
+
+    return ret;
+}